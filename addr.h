@@ -29,6 +29,20 @@
 #define PHY_PAGE_NUM    20
 #define PHY_ADDR        32 // = PHY_PAGE_NUM + PAGE_OFFSET
 
+/*
+ * Huge pages: a PMD entry (resp. a PUD entry) with PTE_PAGE_SIZE_FLAG set maps a 2 MiB
+ * (resp. 1 GiB) page, aligned on its size, instead of pointing to the next page table.
+ * The page walk then stops there (see page_walk_sized()).
+ */
+#define PTE_PAGE_SIZE_FLAG 0x80 // the PS bit
+#define HUGE_PAGE_2M_SIZE  (1u << (PAGE_OFFSET + PTE_ENTRY))             // 2 MiB
+#define HUGE_PAGE_1G_SIZE  (1u << (PAGE_OFFSET + PTE_ENTRY + PMD_ENTRY)) // 1 GiB
+
+typedef enum {PAGE_4K, PAGE_2M, PAGE_1G, NB_PAGE_SIZES} page_size_t;
+
+// log2 of the number of 4 kiB pages in a page of the given size
+#define page_size_shift(SIZE) ((unsigned int) (SIZE) * PTE_ENTRY)
+
 //===============================OUR PART====================================================
 
 /*
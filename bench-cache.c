@@ -0,0 +1,317 @@
+/**
+ * @file bench-cache.c
+ * @brief throughput and memory-footprint benchmark of the cache hierarchy
+ *
+ * Replays a synthetic trace of word/byte reads and writes on physical
+ * addresses and reports accesses per second together with the resident
+ * set size of the process, so that per-access allocations show up as
+ * a growing RSS.
+ *
+ * The same trace is then replayed from pre-built blocks of accesses, once
+ * with one call per access and once with one cache_access_batch() call per
+ * block, to measure the per-call overhead.
+ *
+ * A phase then probes the (then populated) L2 alone with random
+ * addresses, to compare the probe throughput of the storage layouts.
+ *
+ * A phase then stores bytes one after the other, as string processing
+ * does, to measure the byte-store path.
+ *
+ * A last phase flushes the whole hierarchy every FLUSH_EVERY random reads,
+ * as a context switch on a core without address-space tags would, to
+ * measure the cost of the flushes and of refilling the emptied sets.
+ *
+ * usage: bench-cache [nb_accesses] [memory size in kiB] [aos|soa] [replacement policy] [scan|predict]
+ * ("predict" gives all levels a way predictor, see cache_config_set_way_prediction())
+ */
+
+#define _DEFAULT_SOURCE // for getrusage() and clock_gettime()
+
+#include "error.h"
+#include "cache_mng.h"
+#include "addr_mng.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <time.h>
+#include <sys/resource.h>
+
+#define DEFAULT_ACCESSES 10000000UL
+#define DEFAULT_MEM_KIB  1024UL
+#define NB_REPORTS       4
+#define BATCH_SIZE       1024
+#define FLUSH_EVERY      64
+
+// ======================================================================
+// xorshift: cheap and reproducible, so that all runs replay the same trace
+static uint32_t next_random(uint32_t * state)
+{
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+// ======================================================================
+static double now_in_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec + (double) ts.tv_nsec * 1e-9;
+}
+
+// ======================================================================
+// Same accesses as the first phase, as cache_access_batch() takes them
+static void make_block(uint32_t * seed, size_t mem_size, size_t n,
+                       phy_addr_t * paddrs, uint8_t * ops, word_t * data)
+{
+    static const uint8_t op_of[8] = {
+        CACHE_OP_READ_INSTR, CACHE_OP_READ_INSTR, CACHE_OP_READ_WORD, CACHE_OP_READ_WORD,
+        CACHE_OP_READ_WORD, CACHE_OP_READ_BYTE, CACHE_OP_WRITE_WORD, CACHE_OP_WRITE_BYTE
+    };
+    for (size_t i = 0; i < n; ++i) {
+        uint32_t r = next_random(seed);
+        uint32_t addr = (r >> 4) % (uint32_t) (mem_size - sizeof(word_t));
+        ops[i] = op_of[r & 0x7];
+        if (ops[i] == CACHE_OP_READ_WORD || ops[i] == CACHE_OP_WRITE_WORD) {
+            addr &= ~(uint32_t) (sizeof(word_t) - 1);
+        }
+        init_phy_addr(&paddrs[i], addr & ~(uint32_t) (PAGE_SIZE - 1), addr & (PAGE_SIZE - 1));
+        data[i] = r;
+    }
+}
+
+// ======================================================================
+// One call per access of the block
+static int run_block_one_by_one(const cache_sim_t * s, phy_addr_t * paddrs,
+                                const uint8_t * ops, size_t n, word_t * data)
+{
+    for (size_t i = 0; i < n; ++i) {
+        uint8_t byte = 0;
+        int err = ERR_NONE;
+        switch (ops[i]) {
+        case CACHE_OP_READ_INSTR:
+            err = cache_read(s->mem_space, &paddrs[i], INSTRUCTION, s->l1_icache, s->l1_icfg, s->l2_cache, s->l2_cfg, &data[i]);
+            break;
+        case CACHE_OP_READ_WORD:
+            err = cache_read(s->mem_space, &paddrs[i], DATA, s->l1_dcache, s->l1_dcfg, s->l2_cache, s->l2_cfg, &data[i]);
+            break;
+        case CACHE_OP_READ_BYTE:
+            err = cache_read_byte(s->mem_space, &paddrs[i], DATA, s->l1_dcache, s->l1_dcfg, s->l2_cache, s->l2_cfg, &byte);
+            data[i] = byte;
+            break;
+        case CACHE_OP_WRITE_WORD:
+            err = cache_write(s->mem_space, &paddrs[i], s->l1_dcache, s->l1_dcfg, s->l2_cache, s->l2_cfg, &data[i]);
+            break;
+        default:
+            err = cache_write_byte(s->mem_space, &paddrs[i], s->l1_dcache, s->l1_dcfg, s->l2_cache, s->l2_cfg, (uint8_t) data[i]);
+            break;
+        }
+        if (err != ERR_NONE) return err;
+    }
+    return ERR_NONE;
+}
+
+// ======================================================================
+// Replays nb_accesses accesses block by block, batched or not; returns the time spent
+// in the accesses only (building the blocks is not counted)
+static double replay(const cache_sim_t * s, size_t mem_size, unsigned long nb_accesses, int batched)
+{
+    static phy_addr_t paddrs[BATCH_SIZE];
+    static uint8_t ops[BATCH_SIZE];
+    static word_t data[BATCH_SIZE];
+
+    cache_flush(s->l1_icache, s->l1_icfg);
+    cache_flush(s->l1_dcache, s->l1_dcfg);
+    cache_flush(s->l2_cache, s->l2_cfg);
+
+    uint32_t seed = 0x2545F491u;
+    double elapsed = 0;
+    for (unsigned long done = 0; done < nb_accesses; done += BATCH_SIZE) {
+        const size_t n = nb_accesses - done < BATCH_SIZE ? nb_accesses - done : BATCH_SIZE;
+        make_block(&seed, mem_size, n, paddrs, ops, data);
+        const double start = now_in_seconds();
+        const int err = batched ? cache_access_batch(s, paddrs, ops, n, data)
+                                : run_block_one_by_one(s, paddrs, ops, n, data);
+        elapsed += now_in_seconds() - start;
+        if (err != ERR_NONE) {
+            fprintf(stderr, "replay failed: %s\n", ERR_MESSAGES[err - ERR_NONE]);
+            return -1;
+        }
+    }
+    return elapsed;
+}
+
+
+// ======================================================================
+static long max_rss_kib(void)
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+// ======================================================================
+int main(int argc, char *argv[])
+{
+    unsigned long nb_accesses = argc > 1 ? strtoul(argv[1], NULL, 0) : DEFAULT_ACCESSES;
+    unsigned long mem_kib     = argc > 2 ? strtoul(argv[2], NULL, 0) : DEFAULT_MEM_KIB;
+    const char * layout_name  = argc > 3 ? argv[3] : "aos";
+    const char * lookup_name  = argc > 5 ? argv[5] : "scan";
+    cache_replace_t policy = LRU;
+    if (nb_accesses == 0 || mem_kib == 0 || (strcmp(layout_name, "aos") && strcmp(layout_name, "soa"))
+        || (argc > 4 && cache_policy_parse(argv[4], &policy) != ERR_NONE)
+        || (strcmp(lookup_name, "scan") && strcmp(lookup_name, "predict"))) {
+        fprintf(stderr, "usage: %s [nb_accesses] [memory size in kiB] [aos|soa] [LRU|PLRU|SRRIP|BRRIP|FIFO|RANDOM] [scan|predict]\n", argv[0]);
+        return 1;
+    }
+    const int way_prediction = !strcmp(lookup_name, "predict");
+    const cache_layout_t layout = strcmp(layout_name, "soa") ? CACHE_LAYOUT_AOS : CACHE_LAYOUT_SOA;
+
+    size_t mem_size = mem_kib * 1024;
+    void * mem_space = calloc(mem_size, 1);
+    cache_config_t l1_icfg, l1_dcfg, l2_cfg;
+    if (cache_config_init(&l1_icfg, L1_ICACHE, L1_ICACHE_LINES, L1_ICACHE_WAYS, L1_ICACHE_LINE, policy) != ERR_NONE
+        || cache_config_init(&l1_dcfg, L1_DCACHE, L1_DCACHE_LINES, L1_DCACHE_WAYS, L1_DCACHE_LINE, policy) != ERR_NONE
+        || cache_config_init(&l2_cfg, L2_CACHE, L2_CACHE_LINES, L2_CACHE_WAYS, L2_CACHE_LINE, policy) != ERR_NONE
+        || cache_config_set_layout(&l1_icfg, layout) != ERR_NONE
+        || cache_config_set_layout(&l1_dcfg, layout) != ERR_NONE
+        || cache_config_set_layout(&l2_cfg, layout) != ERR_NONE
+        || cache_config_set_way_prediction(&l1_icfg, way_prediction) != ERR_NONE
+        || cache_config_set_way_prediction(&l1_dcfg, way_prediction) != ERR_NONE
+        || cache_config_set_way_prediction(&l2_cfg, way_prediction) != ERR_NONE) {
+        fputs("bad cache configuration\n", stderr);
+        return 2;
+    }
+    void * l1_icache = calloc(1, cache_size(&l1_icfg));
+    void * l1_dcache = calloc(1, cache_size(&l1_dcfg));
+    void * l2_cache  = calloc(1, cache_size(&l2_cfg));
+    if (mem_space == NULL || l1_icache == NULL || l1_dcache == NULL || l2_cache == NULL) {
+        fputs("cannot allocate memory\n", stderr);
+        return 2;
+    }
+
+    cache_flush(l1_icache, &l1_icfg);
+    cache_flush(l1_dcache, &l1_dcfg);
+    cache_flush(l2_cache, &l2_cfg);
+
+    printf("kernels: L1I %s, L1D %s, L2 %s\n", l1_icfg.kernels.name,
+           l1_dcfg.kernels.name, l2_cfg.kernels.name);
+
+    uint32_t seed = 0x2545F491u;
+    const unsigned long report_every = nb_accesses / NB_REPORTS ? nb_accesses / NB_REPORTS : 1;
+    long rss_start = max_rss_kib();
+    double start = now_in_seconds();
+
+    for (unsigned long i = 0; i < nb_accesses; ++i) {
+        uint32_t r = next_random(&seed);
+        uint32_t addr = (r >> 4) % (uint32_t) (mem_size - sizeof(word_t));
+        phy_addr_t paddr;
+        init_phy_addr(&paddr, addr & ~(uint32_t) (PAGE_SIZE - 1), addr & (PAGE_SIZE - 1));
+
+        word_t word = r;
+        uint8_t byte = 0;
+        int err = ERR_NONE;
+        switch (r & 0x7) {
+        case 0:
+        case 1:
+            err = cache_read(mem_space, &paddr, INSTRUCTION, l1_icache, &l1_icfg, l2_cache, &l2_cfg, &word);
+            break;
+        case 2:
+        case 3:
+        case 4:
+            paddr.page_offset &= ~(uint16_t) (sizeof(word_t) - 1);
+            err = cache_read(mem_space, &paddr, DATA, l1_dcache, &l1_dcfg, l2_cache, &l2_cfg, &word);
+            break;
+        case 5:
+            err = cache_read_byte(mem_space, &paddr, DATA, l1_dcache, &l1_dcfg, l2_cache, &l2_cfg, &byte);
+            break;
+        case 6:
+            paddr.page_offset &= ~(uint16_t) (sizeof(word_t) - 1);
+            err = cache_write(mem_space, &paddr, l1_dcache, &l1_dcfg, l2_cache, &l2_cfg, &word);
+            break;
+        default:
+            err = cache_write_byte(mem_space, &paddr, l1_dcache, &l1_dcfg, l2_cache, &l2_cfg, (uint8_t) r);
+            break;
+        }
+        if (err != ERR_NONE) {
+            fprintf(stderr, "access %lu failed: %s\n", i, ERR_MESSAGES[err - ERR_NONE]);
+            return 3;
+        }
+
+        if ((i + 1) % report_every == 0) {
+            printf("%10lu accesses: max RSS %ld kiB (+%ld kiB)\n",
+                   i + 1, max_rss_kib(), max_rss_kib() - rss_start);
+        }
+    }
+
+    double elapsed = now_in_seconds() - start;
+    printf("%lu accesses in %.3f s: %.0f accesses/s\n",
+           nb_accesses, elapsed, (double) nb_accesses / elapsed);
+
+    const cache_sim_t sim = { mem_space, l1_icache, &l1_icfg, l1_dcache, &l1_dcfg, l2_cache, &l2_cfg };
+    for (int batched = 0; batched <= 1; ++batched) {
+        elapsed = replay(&sim, mem_size, nb_accesses, batched);
+        if (elapsed < 0) return 3;
+        printf("%lu accesses in blocks of %d, %s: %.3f s, %.0f accesses/s\n", nb_accesses, BATCH_SIZE,
+               batched ? "one cache_access_batch() per block" : "one call per access",
+               elapsed, (double) nb_accesses / elapsed);
+    }
+
+    unsigned long nb_hits = 0;
+    start = now_in_seconds();
+    for (unsigned long i = 0; i < nb_accesses; ++i) {
+        uint32_t addr = (next_random(&seed) >> 4) % (uint32_t) mem_size;
+        nb_hits += l2_cfg.kernels.probe(l2_cache, &l2_cfg, addr) != HIT_WAY_MISS;
+    }
+    elapsed = now_in_seconds() - start;
+    printf("%lu L2 probes (%lu hits) in %.3f s: %.0f probes/s\n",
+           nb_accesses, nb_hits, elapsed, (double) nb_accesses / elapsed);
+
+    start = now_in_seconds();
+    for (unsigned long i = 0; i < nb_accesses; ++i) {
+        const uint32_t addr = (uint32_t) (i % mem_size);
+        phy_addr_t paddr;
+        init_phy_addr(&paddr, addr & ~(uint32_t) (PAGE_SIZE - 1), addr & (PAGE_SIZE - 1));
+        const int err = cache_write_byte(mem_space, &paddr, l1_dcache, &l1_dcfg, l2_cache, &l2_cfg, (uint8_t) i);
+        if (err != ERR_NONE) {
+            fprintf(stderr, "byte store %lu failed: %s\n", i, ERR_MESSAGES[err - ERR_NONE]);
+            return 3;
+        }
+    }
+    elapsed = now_in_seconds() - start;
+    printf("%lu sequential byte stores in %.3f s: %.0f stores/s\n",
+           nb_accesses, elapsed, (double) nb_accesses / elapsed);
+
+    start = now_in_seconds();
+    for (unsigned long i = 0; i < nb_accesses; ++i) {
+        uint32_t addr = (next_random(&seed) >> 4) % (uint32_t) (mem_size - sizeof(word_t));
+        phy_addr_t paddr;
+        init_phy_addr(&paddr, addr & ~(uint32_t) (PAGE_SIZE - 1), addr & (PAGE_SIZE - 4));
+        word_t word;
+        const int err = cache_read(mem_space, &paddr, DATA, l1_dcache, &l1_dcfg, l2_cache, &l2_cfg, &word);
+        if (err != ERR_NONE) {
+            fprintf(stderr, "read %lu failed: %s\n", i, ERR_MESSAGES[err - ERR_NONE]);
+            return 3;
+        }
+        if ((i + 1) % FLUSH_EVERY == 0) {
+            cache_sim_writeback(&sim);
+            cache_flush(l1_icache, &l1_icfg);
+            cache_flush(l1_dcache, &l1_dcfg);
+            cache_flush(l2_cache, &l2_cfg);
+        }
+    }
+    elapsed = now_in_seconds() - start;
+    printf("%lu random reads, flushing every %d, in %.3f s: %.0f reads/s\n",
+           nb_accesses, FLUSH_EVERY, elapsed, (double) nb_accesses / elapsed);
+
+    free(l2_cache);
+    free(l1_dcache);
+    free(l1_icache);
+    free(mem_space);
+    return 0;
+}
@@ -0,0 +1,109 @@
+/**
+ * @file bench-probe.c
+ * @brief microbenchmark of the set probe for several associativities
+ *
+ * Fills a cache with valid lines and probes it with random addresses
+ * (about half of them hit), for 4-, 8-, 16- and 20-way sets, with the
+ * AoS layout and with the SoA one under each instruction set the host
+ * supports. All variants must report the same number of hits.
+ *
+ * usage: bench-probe [nb_probes]
+ */
+
+#define _DEFAULT_SOURCE // for clock_gettime()
+
+#include "error.h"
+#include "cache_mng.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <time.h>
+
+#define DEFAULT_PROBES 20000000UL
+#define BENCH_SETS     1024
+#define BENCH_LINE     64
+
+// ======================================================================
+// xorshift: cheap and reproducible, so that all variants probe the same addresses
+static uint32_t next_random(uint32_t * state)
+{
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+// ======================================================================
+static double now_in_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec + (double) ts.tv_nsec * 1e-9;
+}
+
+// ======================================================================
+// The tags installed are the even ones below 2 * ways: odd tags always miss.
+static int bench_one(uint8_t ways, cache_layout_t layout, cache_simd_t simd,
+                     const char * name, unsigned long nb_probes)
+{
+    cache_config_t cfg;
+    M_EXIT_IF_ERR(cache_config_init(&cfg, L2_CACHE, BENCH_SETS, ways, BENCH_LINE, LRU), "cache_config_init");
+    M_EXIT_IF_ERR(cache_config_set_layout(&cfg, layout), "cache_config_set_layout");
+    if (cache_config_set_simd(&cfg, simd) != ERR_NONE) {
+        printf("%2u ways, %-12s: not supported by this host\n", ways, name);
+        return ERR_NONE;
+    }
+
+    void * cache = calloc(1, cache_size(&cfg));
+    M_EXIT_IF_NULL(cache, cache_size(&cfg));
+
+    const word_t line[CACHE_MAX_WORDS_PER_LINE] = { 0 };
+    for (uint16_t index = 0; index < cfg.sets; ++index) {
+        foreach_way(way, cfg.ways) {
+            cfg.kernels.install(cache, &cfg, index, way, 2u * way, line);
+        }
+    }
+
+    uint32_t seed = 0x9E3779B9u;
+    unsigned long nb_hits = 0;
+    const double start = now_in_seconds();
+    for (unsigned long i = 0; i < nb_probes; ++i) {
+        const uint32_t r = next_random(&seed);
+        const uint32_t tag = r % (2u * ways);
+        const uint32_t phy = (tag << cfg.tag_shift) | (r & ((1u << cfg.tag_shift) - 1));
+        nb_hits += cfg.kernels.probe(cache, &cfg, phy) != HIT_WAY_MISS;
+    }
+    const double elapsed = now_in_seconds() - start;
+
+    printf("%2u ways, %-12s: %6.1f Mprobes/s (%lu hits)\n",
+           ways, name, (double) nb_probes / elapsed * 1e-6, nb_hits);
+
+    free(cache);
+    return ERR_NONE;
+}
+
+// ======================================================================
+int main(int argc, char *argv[])
+{
+    unsigned long nb_probes = argc > 1 ? strtoul(argv[1], NULL, 0) : DEFAULT_PROBES;
+    if (nb_probes == 0) {
+        fprintf(stderr, "usage: %s [nb_probes]\n", argv[0]);
+        return 1;
+    }
+
+    const uint8_t all_ways[] = { 4, 8, 16, 20 };
+    for (size_t i = 0; i < sizeof(all_ways) / sizeof(all_ways[0]); ++i) {
+        const uint8_t ways = all_ways[i];
+        if (bench_one(ways, CACHE_LAYOUT_AOS, CACHE_SIMD_SCALAR, "AoS scalar", nb_probes) != ERR_NONE
+            || bench_one(ways, CACHE_LAYOUT_SOA, CACHE_SIMD_SCALAR, "SoA scalar", nb_probes) != ERR_NONE
+            || bench_one(ways, CACHE_LAYOUT_SOA, CACHE_SIMD_SSE2, "SoA SSE2", nb_probes) != ERR_NONE
+            || bench_one(ways, CACHE_LAYOUT_SOA, CACHE_SIMD_AVX2, "SoA AVX2", nb_probes) != ERR_NONE) {
+            return 2;
+        }
+    }
+
+    return 0;
+}
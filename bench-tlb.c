@@ -0,0 +1,191 @@
+/**
+ * @file bench-tlb.c
+ * @brief microbenchmark of the fully-associative TLB lookup
+ *
+ * Translates random virtual addresses drawn from 9/8 times as many pages as
+ * the TLB has entries (so that most accesses hit), through a TLB of 128,
+ * 1024 and 4096 entries, once walking the replacement list on each access
+ * and once through the hash index of the TLB (see tlb_index_t), then
+ * through the index with paging-structure caches on the page walks of the
+ * misses (see page_walk_cache_t). All variants replace the least recently
+ * used entry, so they must report the same hits and the same translations.
+ *
+ * usage: bench-tlb [nb_accesses]
+ */
+
+#define _DEFAULT_SOURCE // for clock_gettime()
+
+#include "error.h"
+#include "addr_mng.h"
+#include "page_walk.h"
+#include "list.h"
+#include "tlb.h"
+#include "tlb_mng.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <time.h>
+
+#define DEFAULT_ACCESSES 4000000UL
+#define BENCH_PTE_PAGES  16 // page tables of the mapped pages
+#define BENCH_PAGES      (BENCH_PTE_PAGES * PD_ENTRIES)
+
+// paging-structure caches of the last variant (PGD, PUD and PMD caches)
+static const uint16_t bench_pwc_entries[NB_PWC_LEVELS] = { 2, 4, 32 };
+static const uint8_t bench_pwc_ways[NB_PWC_LEVELS] = { 2, 4, 4 };
+
+// ======================================================================
+// xorshift: cheap and reproducible, so that both variants translate the same addresses
+static uint32_t next_random(uint32_t * state)
+{
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+// ======================================================================
+static double now_in_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec + (double) ts.tv_nsec * 1e-9;
+}
+
+// ======================================================================
+// Page tables mapping the BENCH_PAGES first virtual pages: the PGD, PUD and PMD pages
+// first, then the page tables; virtual page p is mapped to physical page p + 1000
+static pte_t * make_page_tables(void)
+{
+    pte_t * mem = calloc(3 + BENCH_PTE_PAGES, PAGE_SIZE);
+    if (mem == NULL) return NULL;
+
+    const size_t per_page = PAGE_SIZE / sizeof(pte_t);
+    mem[0] = PAGE_SIZE;
+    mem[per_page] = 2 * PAGE_SIZE;
+    for (uint32_t t = 0; t < BENCH_PTE_PAGES; ++t) {
+        mem[2 * per_page + t] = (3 + t) * PAGE_SIZE;
+        for (uint32_t e = 0; e < PD_ENTRIES; ++e) {
+            mem[(3 + t) * per_page + e] = (t * PD_ENTRIES + e + 1000) * PAGE_SIZE;
+        }
+    }
+    return mem;
+}
+
+// ======================================================================
+// tlb_insert() only takes TLB_LINES entries: the misses of the list variant are
+// handled here as tlb_search() does
+static int list_search(const void * mem_space, const virt_addr_t * vaddr, phy_addr_t * paddr,
+                       tlb_entry_t * tlb, replacement_policy_t * policy, int * hit)
+{
+    *hit = tlb_hit(vaddr, paddr, tlb, policy);
+    if (*hit) return ERR_NONE;
+
+    const int err = page_walk(mem_space, vaddr, paddr);
+    if (err != ERR_NONE) return err;
+    array_node_t * lru = &policy->ll->nodes[policy->ll->front];
+    tlb_entry_init(vaddr, paddr, &tlb[lru->value]);
+    policy->move_back(policy->ll, lru);
+    return ERR_NONE;
+}
+
+// ======================================================================
+static int bench_one(const void * mem_space, uint32_t lines, int indexed, int walk_cached, unsigned long nb_accesses)
+{
+    tlb_entry_t * tlb = calloc(lines, sizeof(tlb_entry_t));
+    M_EXIT_IF_NULL(tlb, lines * sizeof(tlb_entry_t));
+
+    array_node_t * nodes = calloc(lines, sizeof(array_node_t));
+    M_EXIT_IF_NULL(nodes, lines * sizeof(array_node_t));
+    array_list_t ll;
+    M_EXIT_IF_ERR(init_array_list(&ll, nodes, lines), "init_array_list");
+    replacement_policy_t policy = {
+        .ll        = &ll,
+        .move_back = array_move_back,
+        .push_back = array_push_back
+    };
+    if (walk_cached) {
+        policy.walk_cache = malloc(page_walk_cache_size(bench_pwc_entries));
+        M_EXIT_IF_NULL(policy.walk_cache, page_walk_cache_size(bench_pwc_entries));
+        M_EXIT_IF_ERR(page_walk_cache_init(policy.walk_cache, bench_pwc_entries, bench_pwc_ways), "page_walk_cache_init");
+    }
+    if (indexed) {
+        policy.index = calloc(1, tlb_index_size(lines));
+        M_EXIT_IF_NULL(policy.index, tlb_index_size(lines));
+        M_EXIT_IF_ERR(tlb_index_init(policy.index, lines), "tlb_index_init");
+    } else {
+        for (list_content_t line_index = 0; line_index < lines; line_index++) {
+            M_EXIT_IF_NULL(array_push_back(&ll, &line_index), sizeof(array_node_t));
+        }
+    }
+
+    const uint32_t nb_pages = lines + lines / 8;
+    uint32_t seed = 0x9E3779B9u;
+    unsigned long nb_hits = 0;
+    uint32_t checksum = 0;
+    const double start = now_in_seconds();
+    for (unsigned long i = 0; i < nb_accesses; ++i) {
+        const uint32_t r = next_random(&seed);
+        const uint32_t page = r % nb_pages;
+        virt_addr_t vaddr;
+        init_virt_addr(&vaddr, 0, 0, (uint16_t) (page / PD_ENTRIES), (uint16_t) (page % PD_ENTRIES),
+                       (uint16_t) (r >> 20));
+        phy_addr_t paddr;
+        int hit = 0;
+        const int err = indexed ? tlb_search(mem_space, &vaddr, &paddr, tlb, &policy, &hit)
+                                : list_search(mem_space, &vaddr, &paddr, tlb, &policy, &hit);
+        M_EXIT_IF_ERR(err, "tlb_search");
+        nb_hits += (unsigned long) hit;
+        checksum = checksum * 31 + paddr.phy_page_num;
+    }
+    const double elapsed = now_in_seconds() - start;
+
+    printf("%4" PRIu32 " entries, %-23s: %6.1f Maccesses/s (%lu hits, translations %08" PRIx32 ")",
+           lines, walk_cached ? "hash index, walk caches" : indexed ? "hash index" : "list walk",
+           (double) nb_accesses / elapsed * 1e-6, nb_hits, checksum);
+    if (walk_cached) {
+        const pwc_stats_t * stats = &policy.walk_cache->stats;
+        uint64_t reads = 0;
+        for (uint32_t depth = 1; depth <= PAGE_WALK_LEVELS; ++depth) reads += depth * stats->walks_by_reads[depth];
+        printf(", %.2f entries read per walk", stats->walks ? (double) reads / (double) stats->walks : 0.0);
+    }
+    putchar('\n');
+
+    free(nodes);
+    free(policy.walk_cache);
+    free(policy.index);
+    free(tlb);
+    return ERR_NONE;
+}
+
+// ======================================================================
+int main(int argc, char *argv[])
+{
+    unsigned long nb_accesses = argc > 1 ? strtoul(argv[1], NULL, 0) : DEFAULT_ACCESSES;
+    if (nb_accesses == 0) {
+        fprintf(stderr, "usage: %s [nb_accesses]\n", argv[0]);
+        return 1;
+    }
+
+    pte_t * mem_space = make_page_tables();
+    if (mem_space == NULL) {
+        fputs("cannot allocate memory\n", stderr);
+        return 2;
+    }
+
+    const uint32_t all_lines[] = { 128, 1024, 4096 };
+    for (size_t i = 0; i < sizeof(all_lines) / sizeof(all_lines[0]); ++i) {
+        if (bench_one(mem_space, all_lines[i], 0, 0, nb_accesses) != ERR_NONE
+            || bench_one(mem_space, all_lines[i], 1, 0, nb_accesses) != ERR_NONE
+            || bench_one(mem_space, all_lines[i], 1, 1, nb_accesses) != ERR_NONE) {
+            free(mem_space);
+            return 2;
+        }
+    }
+
+    free(mem_space);
+    return 0;
+}
@@ -2,11 +2,16 @@
 
 /**
  * @file cache.h
- * @brief definitions associated to a a two-level hierarchy of cache memories
+ * @brief definitions associated to a hierarchy of cache memories: two L1 caches,
+ *        an L2 and an optional L3
+ *
+ * The L1_*, L2_* and L3_* macros give the default geometry; any other one can be
+ * described at run time with a cache_config_t.
  */
 
 #include "addr.h" // for word_t
 #include <stdint.h>
+#include <stddef.h> // for size_t
 
 #define L1_ICACHE_WORDS_PER_LINE 4
 #define L1_ICACHE_LINE   16u // 16 bytes (4 words) per line
@@ -29,6 +34,13 @@
 #define L2_CACHE_TAG_REMAINING_BITS   13 // 2(select byte) + 2(select word) + 9(select line)
 #define L2_CACHE_TAG_BITS             19 // 32 - L1_ICACHE_TAG_REMAINING_BITS
 
+#define L3_CACHE_WORDS_PER_LINE L1_ICACHE_WORDS_PER_LINE
+#define L3_CACHE_LINE   L1_ICACHE_LINE
+#define L3_CACHE_WAYS   16u
+#define L3_CACHE_LINES  2048u
+#define L3_CACHE_TAG_REMAINING_BITS   15 // 2(select byte) + 2(select word) + 11(select line)
+#define L3_CACHE_TAG_BITS             17 // 32 - L3_CACHE_TAG_REMAINING_BITS
+
 /**
  * L1 ICACHE, L1 DCACHE:
  *  - byte addressing
@@ -37,7 +49,7 @@
  *  - 4 words/way, where word = 4 bytes (=> 128 bits/way)
  *  - 64 sets (= 64 blocks per way) (= 6 bits to index)
  *  - total capacity = 4kiB
- *  - write-through policy (no dirty bit)
+ *  - write-through policy by default, write-back on demand (see cache_write_t)
  *  - write-allocate on write miss
  *
  * L2 CACHE:
@@ -47,7 +59,7 @@
  *  - 4 words/way, where word = 4 bytes (=> 128 bits/way)
  *  - 512 sets (= 512 blocks per way) (= 9 bits to index)
  *  - total capacity = 64kiB
- *  - write-through policy (no dirty bit)
+ *  - write-through policy by default, write-back on demand (see cache_write_t)
  *  - write-allocate on write miss
  *
  *  Exclusive policy (https://en.wikipedia.org/wiki/Cache_inclusion_policy)
@@ -61,50 +73,423 @@
  *      behaves like a victim cache. If the block is not found neither in L1 nor
  *      in L2, then it is fetched from main memory and placed just in L1 and not
  *      in L2.
+ *  This is the default; inclusive and non-inclusive non-exclusive L2 caches are
+ *  available too (see cache_inclusion_t).
+ *
+ * L3 CACHE (optional, shared last level):
+ *  - byte addressing
+ *  - physically addressed
+ *  - 16-way set-associative
+ *  - 4 words/way, where word = 4 bytes (=> 128 bits/way)
+ *  - 2048 sets (= 2048 blocks per way) (= 11 bits to index)
+ *  - total capacity = 512kiB
+ *  - write-through policy by default, write-back on demand (see cache_write_t)
+ *  - inclusive of all the levels above by default, as on Kaby Lake (see cache_inclusion_t)
+ *
+ */
+
+typedef enum {L1_ICACHE, L1_DCACHE, L2_CACHE, L3_CACHE} cache_t;
+
+/**
+ * Replacement policies (see replacement.h):
+ *  - LRU: exact least recently used
+ *  - PLRU: tree pseudo-LRU, power-of-2 ways up to 64
+ *  - SRRIP, BRRIP: static/bimodal re-reference interval prediction (2-bit RRPV)
+ *  - FIFO: oldest fill first
+ *  - RANDOM: reproducible pseudo-random, see cache_config_t.seed
+ */
+enum cache_replacement_policy { LRU, PLRU, SRRIP, BRRIP, FIFO, RANDOM };
+typedef enum cache_replacement_policy cache_replace_t;
+
+// X(POLICY, ARG) for every policy
+#define CACHE_POLICIES(X, ARG) \
+    X(LRU, ARG) X(PLRU, ARG) X(SRRIP, ARG) X(BRRIP, ARG) X(FIFO, ARG) X(RANDOM, ARG)
+
+#define CACHE_DEFAULT_SEED 0x2545F4914F6CDD1Dull
+
+#define CACHE_MAX_LINE_BYTES      128u
+#define CACHE_MAX_WORDS_PER_LINE  (CACHE_MAX_LINE_BYTES / sizeof(word_t))
+
+/**
+ * Geometries for which cache_mng.c stamps out specialized kernels,
+ * as X(SETS, WAYS, LINE_BYTES, ARG). Any other geometry uses the generic ones.
+ */
+#define CACHE_GEOMETRIES(X, ARG) \
+    X(64,   4, 16, ARG)  /* default L1 ICACHE/DCACHE */ \
+    X(512,  8, 16, ARG)  /* default L2 */ \
+    X(64,   8, 64, ARG)  /* Kaby Lake L1I/L1D, 32 kiB */ \
+    X(1024, 4, 64, ARG)  /* Kaby Lake L2, 256 kiB */ \
+    X(2048, 16, 16, ARG) /* default L3 */ \
+    X(2048, 16, 64, ARG) /* Kaby Lake L3, 2 MiB per core */
+
+/**
+ * Write policy of a cache level:
+ *  - CACHE_WRITE_THROUGH: every store is copied down at once, to the nearest level below
+ *    holding the line or to memory; lines are never dirty
+ *  - CACHE_WRITE_BACK: stores only mark the line dirty; it is written down when it
+ *    leaves the level (or goes to a write-through level), or by cache_sim_writeback()
+ * Instruction fetches do not snoop L1 DCACHE: with write-back, code and data are assumed
+ * not to share lines (no self-modifying code).
+ */
+typedef enum { CACHE_WRITE_THROUGH, CACHE_WRITE_BACK } cache_write_t;
+
+/**
+ * Inclusion policy of L2 (resp. L3) with respect to the levels above it:
+ *  - CACHE_EXCLUSIVE: a victim cache (see above), filled by the evictions of the level above
+ *  - CACHE_INCLUSIVE: every line above is also here. Misses fill this level too, and a
+ *    line evicted from it is back-invalidated from the levels above
+ *  - CACHE_NINE: non-inclusive non-exclusive. Misses fill this level too, but it evicts
+ *    without back-invalidation
+ * In the last two, the level keeps its copy when it fills the one above; a clean victim
+ * of the level above is dropped and a dirty one is written into the copy.
+ */
+typedef enum { CACHE_EXCLUSIVE, CACHE_INCLUSIVE, CACHE_NINE } cache_inclusion_t;
+
+/**
+ * MESI coherence state of a line in the private levels (L1 and L2) of one core, only
+ * kept in multi-core hierarchies (see cache_cores_access_batch()); all the copies of a
+ * line in the levels of a core have the same state:
+ *  - MESI_MODIFIED: no other core holds the line, and this one has written it
+ *  - MESI_EXCLUSIVE: no other core holds the line, which has not been written
+ *  - MESI_SHARED: other cores may hold the line, which must be upgraded before a write
+ * MESI_INVALID is that of the lines of a single core and of L3, whatever their valid bit.
+ */
+typedef enum { MESI_INVALID, MESI_SHARED, MESI_EXCLUSIVE, MESI_MODIFIED } cache_mesi_t;
+
+/**
+ * Hardware prefetcher of L1 DCACHE or L2. It trains on the demand misses of its level and
+ * on the first demand hit on each line it brought in; commands carry no instruction
+ * address, so strides are tracked per page-sized region instead of per instruction:
+ *  - CACHE_PREFETCH_NEXT_LINE: the lines right after the one accessed
+ *  - CACHE_PREFETCH_STRIDE: a direct-mapped table of regions, each with the stride between
+ *    its last two accesses; a stride seen twice in a row is followed
+ *  - CACHE_PREFETCH_STREAM: like the L2 streamer of Intel cores, a table of ascending or
+ *    descending streams (one per page, least recently used replaced); a direction seen
+ *    twice in a row is followed
+ * Each trigger prefetches up to "degree" lines, never beyond the page of the access.
+ * A prefetched line hit by a demand access less than CACHE_PREFETCH_LATE_ACCESSES demand
+ * accesses of the level after its prefetch counts as late: the hardware would still be
+ * fetching it.
+ */
+typedef enum { CACHE_PREFETCH_NONE, CACHE_PREFETCH_NEXT_LINE, CACHE_PREFETCH_STRIDE,
+               CACHE_PREFETCH_STREAM } cache_prefetch_t;
+#define CACHE_PREFETCH_MAX_DEGREE      16
+#define CACHE_PREFETCH_MAX_ENTRIES     1024
+#define CACHE_PREFETCH_DEFAULT_DEGREE  2
+#define CACHE_PREFETCH_DEFAULT_ENTRIES 32  // as many streams as the Intel L2 streamer
+#define CACHE_PREFETCH_LATE_ACCESSES   4
+
+// One region (stride) or stream of a prefetcher table
+typedef struct cache_prefetch_entry {
+    uint32_t page;       // PHY >> PAGE_OFFSET
+    uint32_t last;       // line number (PHY >> offset bits) of the last access
+    int32_t stride;      // in lines; a stream's direction is +1 or -1
+    uint32_t used;       // stream: tick of the last access, for the replacement
+    uint8_t confidence;  // times in a row the stride was seen again
+    uint8_t v;
+} cache_prefetch_entry_t;
+
+/**
+ * Storage layout of a cache level:
+ *  - CACHE_LAYOUT_AOS: one cache_entry_t (header + line) per way, sets one after the other
+ *  - CACHE_LAYOUT_SOA: separate planes of tags, line data, valid bits, ages, dirty bits and
+ *    MESI states, each
+ *    indexed by line_index * ways + way. The tags and valid bits of a set are then
+ *    contiguous and a probe never touches the line data.
+ */
+typedef enum { CACHE_LAYOUT_AOS, CACHE_LAYOUT_SOA } cache_layout_t;
+
+/**
+ * Instruction set used by the SoA probe to compare the tags of a set at once.
+ * CACHE_SIMD_AUTO picks the best one the host supports for sets of at least
+ * CACHE_SIMD_MIN_WAYS ways (below that the scalar loop is as fast).
+ */
+typedef enum { CACHE_SIMD_AUTO, CACHE_SIMD_SCALAR, CACHE_SIMD_SSE2, CACHE_SIMD_AVX2 } cache_simd_t;
+#define CACHE_SIMD_MIN_WAYS 8
+
+/**
+ * Latency model: a demand access costs the hit latency of each level it looks up, from
+ * L1 down to the one that holds the line, plus the memory latency of the last level
+ * (L3 if there is one, else L2) when none does. Stores drain through a write buffer
+ * (write-throughs, write-backs) and prefetches run in the background: neither adds to
+ * the latency of demand accesses. Defaults, in cycles (see cache_config_set_latency()):
+ */
+#define L1_CACHE_HIT_LATENCY  4u
+#define L2_CACHE_HIT_LATENCY  12u
+#define L3_CACHE_HIT_LATENCY  42u
+#define CACHE_MEMORY_LATENCY  200u
+#define CACHE_LATENCY_BUCKETS 16  // bucket k counts latencies in [2^k, 2^(k+1)), the last one all above
+
+/**
+ * Non-blocking levels, once a core clock times the accesses (see cache_timing_t): a level
+ * tracks each of its misses in flight in one of its MSHRs (miss status holding registers)
+ * until the line arrives. An access to a line in flight merges into its MSHR (a secondary
+ * miss) instead of taking another one; a miss that finds them all busy waits for the
+ * first to free. Default numbers of MSHRs (see cache_config_set_mshrs()):
+ */
+#define L1_CACHE_MSHRS  8u
+#define L2_CACHE_MSHRS  16u
+#define L3_CACHE_MSHRS  32u
+#define CACHE_MAX_MSHRS 64u
+
+typedef struct cache_mshr {
+    uint64_t ready;  // cycle at which the line arrives, from which the MSHR is free
+    uint32_t line;   // line number (PHY >> offset bits)
+} cache_mshr_t;
+
+/**
+ * Way prediction (see cache_config_set_way_prediction()): a demand lookup first checks
+ * one predicted way, that of the last line the level accessed if it is this one, else
+ * the most recently used way of the set; it only scans the whole set when the predicted
+ * way does not hold the line. As in hardware, a hit in another way than the predicted
+ * one costs a second lookup of L1: CACHE_WAY_MISPREDICT_PENALTY more cycles.
+ */
+#define CACHE_WAY_MISPREDICT_PENALTY 1u
+
+typedef struct cache_way_memo {
+    uint32_t line;   // line number (PHY >> offset bits) of the last line accessed
+    uint8_t way;
+    uint8_t v;
+} cache_way_memo_t;
+
+/**
+ * Event counters of one cache level, kept at the end of the cache itself
+ * (see cache_stats() below). Hits and misses count the probes of the level.
+ */
+typedef struct cache_stats {
+    uint64_t read_hits;
+    uint64_t read_misses;
+    uint64_t write_hits;
+    uint64_t write_misses;
+    uint64_t victim_insertions; // lines evicted from the level above and inserted here (exclusive L2, L3)
+    uint64_t evictions;         // valid lines replaced
+    uint64_t back_invalidations; // lines invalidated because an inclusive level below evicted them
+    uint64_t memory_fills;      // lines brought in from memory
+    uint64_t memory_writes;     // lines written to memory (write-through stores, write-backs)
+    uint64_t prefetches;        // lines the prefetcher of the level brought in
+    uint64_t prefetch_useful;   // prefetched lines then hit by a demand access
+    uint64_t prefetch_late;     // useful ones hit too soon after their prefetch (see cache_prefetch_t)
+    uint64_t prefetch_useless;  // prefetched lines replaced before any demand access
+    uint64_t cycles;            // L1: latency of its demand accesses (see the latency model)
+    uint64_t latency_histogram[CACHE_LATENCY_BUCKETS]; // L1: demand accesses per latency bucket
+    uint64_t mshr_merges;       // secondary misses: accesses to a line in flight at this level
+    uint64_t mshr_full_cycles;  // cycles its misses waited for a free MSHR
+    uint64_t way_memo_hits;     // hits in the way of the last line accessed (way prediction)
+    uint64_t way_mru_hits;      // hits in the most recently used way of the set (way prediction)
+    uint64_t way_mispredictions; // hits in another way than the predicted one
+} cache_stats_t;
+
+struct cache_config;
+
+/**
+ * Per-geometry and per-policy set operations, chosen once by cache_config_init()
+ * (and again by cache_config_set_layout() and cache_config_set_simd()). This is
+ * the replacement-policy vtable: each policy gets its own instances. They expect the set
+ * to be current (see cache_set_current()).
+ *  - probe: way holding phy (updating the replacement state), HIT_WAY_MISS otherwise
+ *  - victim: first invalid way of the set, else the one the policy evicts
+ *  - install: write a valid line in (line_index, way) and update the replacement state
+ */
+typedef struct cache_kernels {
+    const char * name;
+    uint8_t (*probe)(void * cache, const struct cache_config * cfg, uint32_t phy);
+    uint8_t (*victim)(void * cache, const struct cache_config * cfg, uint16_t line_index);
+    void (*install)(void * cache, const struct cache_config * cfg, uint16_t line_index,
+                    uint8_t way, uint32_t tag, const word_t * line);
+} cache_kernels_t;
+
+/**
+ * Geometry of one cache level, fixed at run time.
  *
+ * sets, ways, line_bytes, policy and layout are the user-provided part (see
+ * cache_config_init() and cache_config_set_layout()); the remaining fields are
+ * derived from them so that index, tag and word select are plain shifts and masks.
+ */
+typedef struct cache_config {
+    cache_t type;            // level described, for dumps and debug messages
+    uint16_t sets;           // number of lines (sets), power of 2
+    uint8_t ways;
+    uint16_t line_bytes;     // power of 2, at least one word
+    cache_replace_t policy;
+    cache_write_t write_policy; // CACHE_WRITE_THROUGH after cache_config_init()
+    cache_inclusion_t inclusion; // L2 and L3 only, CACHE_EXCLUSIVE (L3: CACHE_INCLUSIVE) after cache_config_init()
+
+    uint8_t words_per_line;  // line_bytes / sizeof(word_t)
+    uint8_t offset_bits;     // log2(line_bytes)
+    uint8_t tag_shift;       // offset_bits + log2(sets)
+    uint32_t index_mask;     // sets - 1
+    size_t entry_size;       // bytes from one way to the next
+    size_t set_size;         // bytes from one set to the next (ways * entry_size)
+
+    cache_layout_t layout;
+    size_t lines_offset;     // SoA only: offsets of the planes after the tag plane
+    size_t valid_offset;
+    size_t age_offset;
+    size_t dirty_offset;
+    size_t mesi_offset;
+    cache_simd_t simd;       // never CACHE_SIMD_AUTO once the kernels are picked
+    size_t state_offset;     // per-set replacement state word, after the entries (both layouts)
+    uint64_t seed;           // RANDOM policy, CACHE_DEFAULT_SEED after cache_config_init()
+    size_t stats_offset;     // cache_stats_t, after the state words (both layouts)
+    uint8_t age_bits;        // LRU/FIFO: bits per age packed in the set state word, 0 if in the entries
+    uint64_t age_lanes;      // lowest bit of each packed age (see lru.h)
+    cache_prefetch_t prefetch; // L1 DCACHE and L2 only, CACHE_PREFETCH_NONE after cache_config_init()
+    uint8_t prefetch_degree;   // lines prefetched per trigger
+    uint16_t prefetch_entries; // STRIDE: regions (power of 2), STREAM: streams
+    size_t prefetch_offset;    // prefetcher tick and table, after the stats (if there is a prefetcher)
+    size_t stamps_offset;      // prefetch tick of each prefetched way not used yet, 0 otherwise
+    uint16_t hit_latency;      // cycles of a lookup of the level (see the latency model)
+    uint16_t memory_latency;   // cycles of a memory access on a miss, when the level is the last one
+    uint8_t way_prediction;    // 1 if demand lookups check a predicted way first (see cache_way_memo_t)
+    size_t way_memo_offset;    // way prediction: memo, then MRU way of each set (if there is prediction)
+    uint8_t mshrs;             // misses in flight at most (see cache_mshr_t)
+    size_t mshr_offset;        // MSHR file
+    size_t epoch_offset;       // flush epoch of the cache, then of each set (see cache_set_current()), last
+
+    cache_kernels_t kernels;
+} cache_config_t;
+
+// --------------------------------------------------
+#define cache_line_index(CFG, PHY)  (((PHY) >> (CFG)->offset_bits) & (CFG)->index_mask)
+#define cache_tag_of(CFG, PHY)      ((PHY) >> (CFG)->tag_shift)
+#define cache_word_select(CFG, PHY) (((PHY) >> 2) & ((uint32_t) (CFG)->words_per_line - 1))
+#define cache_line_addr(CFG, PHY)   ((PHY) & ~((uint32_t) (CFG)->line_bytes - 1))
+
+/**
+ * All cache entries start with the same header; the line data that follows
+ * has cache_config_t.words_per_line words.
  */
+#define CACHE_ENTRY_HEADER \
+    uint32_t tag;          \
+    uint8_t v;             \
+    uint8_t age;           \
+    uint8_t dirty;         \
+    uint8_t mesi
 
+typedef struct cache_entry {
+    CACHE_ENTRY_HEADER;
+    word_t line[];
+} cache_entry_t;
+
+// Entry types of the default geometries (see the L1_*, L2_* and L3_* macros above)
 typedef struct l1_icache_entry {
-    uint8_t v : 1;
-    uint8_t age : 2;
-    uint32_t tag : L1_ICACHE_TAG_BITS;
+    CACHE_ENTRY_HEADER;
     word_t line[L1_ICACHE_WORDS_PER_LINE];
 } l1_icache_entry_t;
 
-/////////////////////// ALIAS???????????????????????????????
 typedef l1_icache_entry_t l1_dcache_entry_t;
 
-
 typedef struct l2_cache_entry {
-    uint8_t v : 1;
-    uint8_t age : 3;
-    uint32_t tag : L2_CACHE_TAG_BITS;
+    CACHE_ENTRY_HEADER;
     word_t line[L2_CACHE_WORDS_PER_LINE];
 } l2_cache_entry_t;
 
-typedef enum {L1_ICACHE, L1_DCACHE, L2_CACHE} cache_t;
+typedef struct l3_cache_entry {
+    CACHE_ENTRY_HEADER;
+    word_t line[L3_CACHE_WORDS_PER_LINE];
+} l3_cache_entry_t;
+
 
 
 
 // --------------------------------------------------
-#define cache_cast(TYPE) ((TYPE *)cache)
+// AoS: first entry of a set, and entry of a way within it
+#define cache_set(CFG, CACHE, LINE_INDEX) \
+        ((char *) (CACHE) + (size_t) (LINE_INDEX) * (CFG)->set_size)
+
+#define cache_set_entry(CFG, SET, WAY) \
+        ((cache_entry_t *) ((SET) + (size_t) (WAY) * (CFG)->entry_size))
+
+#define cache_entry(CFG, CACHE, LINE_INDEX, WAY) \
+        cache_set_entry(CFG, cache_set(CFG, CACHE, LINE_INDEX), WAY)
 
 // --------------------------------------------------
-#define cache_entry(TYPE, WAYS, LINE_INDEX, WAY) \
-        (cache_cast(TYPE) + (LINE_INDEX) * (WAYS) + (WAY))
+// SoA: position of a way in the planes, and the planes themselves
+#define cache_slot(CFG, LINE_INDEX, WAY) \
+        ((size_t) (LINE_INDEX) * (CFG)->ways + (WAY))
+
+#define cache_plane(CFG, CACHE, OFFSET, TYPE) \
+        ((TYPE *) ((char *) (CACHE) + (OFFSET)))
 
 // --------------------------------------------------
-#define cache_valid(TYPE, WAYS, LINE_INDEX, WAY) \
-        cache_entry(TYPE, WAYS, LINE_INDEX, WAY)->v
+// Field accessors, valid for both layouts (the layout test folds away
+// in kernels instantiated for a constant geometry)
+#define cache_field(CFG, CACHE, LINE_INDEX, WAY, FIELD, OFFSET, TYPE) \
+        (*((CFG)->layout == CACHE_LAYOUT_SOA \
+            ? &cache_plane(CFG, CACHE, OFFSET, TYPE)[cache_slot(CFG, LINE_INDEX, WAY)] \
+            : &cache_entry(CFG, CACHE, LINE_INDEX, WAY)->FIELD))
 
 // --------------------------------------------------
-#define cache_age(TYPE, WAYS, LINE_INDEX, WAY) \
-        cache_entry(TYPE, WAYS, LINE_INDEX, WAY)->age
+#define cache_valid(CFG, CACHE, LINE_INDEX, WAY) \
+        cache_field(CFG, CACHE, LINE_INDEX, WAY, v, (CFG)->valid_offset, uint8_t)
 
 // --------------------------------------------------
-#define cache_tag(TYPE, WAYS, LINE_INDEX, WAY) \
-        cache_entry(TYPE, WAYS, LINE_INDEX, WAY)->tag
+#define cache_age(CFG, CACHE, LINE_INDEX, WAY) \
+        cache_field(CFG, CACHE, LINE_INDEX, WAY, age, (CFG)->age_offset, uint8_t)
 
 // --------------------------------------------------
-#define cache_line(TYPE, WAYS, LINE_INDEX, WAY) \
-        cache_entry(TYPE, WAYS, LINE_INDEX, WAY)->line
+#define cache_dirty(CFG, CACHE, LINE_INDEX, WAY) \
+        cache_field(CFG, CACHE, LINE_INDEX, WAY, dirty, (CFG)->dirty_offset, uint8_t)
+
+// --------------------------------------------------
+#define cache_mesi(CFG, CACHE, LINE_INDEX, WAY) \
+        cache_field(CFG, CACHE, LINE_INDEX, WAY, mesi, (CFG)->mesi_offset, uint8_t)
+
+// --------------------------------------------------
+#define cache_tag(CFG, CACHE, LINE_INDEX, WAY) \
+        cache_field(CFG, CACHE, LINE_INDEX, WAY, tag, 0, uint32_t)
+
+// --------------------------------------------------
+#define cache_line(CFG, CACHE, LINE_INDEX, WAY) \
+        ((CFG)->layout == CACHE_LAYOUT_SOA \
+            ? cache_plane(CFG, CACHE, (CFG)->lines_offset, word_t) \
+              + cache_slot(CFG, LINE_INDEX, WAY) * (CFG)->words_per_line \
+            : cache_entry(CFG, CACHE, LINE_INDEX, WAY)->line)
+
+// --------------------------------------------------
+// per-set replacement state (see replacement.h)
+#define cache_set_state(CFG, CACHE, LINE_INDEX) \
+        cache_plane(CFG, CACHE, (CFG)->state_offset, uint64_t)[LINE_INDEX]
+
+// --------------------------------------------------
+// event counters of the level (see cache_stats_t)
+#define cache_stats(CFG, CACHE) \
+        cache_plane(CFG, CACHE, (CFG)->stats_offset, cache_stats_t)
+
+// --------------------------------------------------
+// prefetcher state (see cache_prefetch_t): demand accesses of the level so far, table,
+// and prefetch stamp of each way
+#define cache_prefetch_tick(CFG, CACHE) \
+        cache_plane(CFG, CACHE, (CFG)->prefetch_offset, uint32_t)[0]
+
+#define cache_prefetch_table(CFG, CACHE) \
+        cache_plane(CFG, CACHE, (CFG)->prefetch_offset + sizeof(uint64_t), cache_prefetch_entry_t)
+
+#define cache_prefetch_stamp(CFG, CACHE, LINE_INDEX, WAY) \
+        cache_plane(CFG, CACHE, (CFG)->stamps_offset, uint32_t)[cache_slot(CFG, LINE_INDEX, WAY)]
+
+// --------------------------------------------------
+// way predictor of the level (see cache_way_memo_t): last line accessed, and MRU way of each set
+#define cache_way_memo(CFG, CACHE) \
+        cache_plane(CFG, CACHE, (CFG)->way_memo_offset, cache_way_memo_t)
+
+#define cache_way_mru(CFG, CACHE, LINE_INDEX) \
+        cache_plane(CFG, CACHE, (CFG)->way_memo_offset + sizeof(cache_way_memo_t), uint8_t)[LINE_INDEX]
+
+// --------------------------------------------------
+// MSHR file of the level (see cache_mshr_t)
+#define cache_mshrs(CFG, CACHE) \
+        cache_plane(CFG, CACHE, (CFG)->mshr_offset, cache_mshr_t)
+
+// --------------------------------------------------
+// Flush epochs: cache_flush() only starts a new epoch of the cache. A set whose epoch is
+// an older one holds no valid line, whatever its entries say, and is emptied when it is
+// next used; until then, its entries must not be read.
+#define cache_epoch(CFG, CACHE) \
+        cache_plane(CFG, CACHE, (CFG)->epoch_offset, uint32_t)[0]
+
+#define cache_set_epoch(CFG, CACHE, LINE_INDEX) \
+        cache_plane(CFG, CACHE, (CFG)->epoch_offset + sizeof(uint64_t), uint32_t)[LINE_INDEX]
+
+#define cache_set_current(CFG, CACHE, LINE_INDEX) \
+        (cache_set_epoch(CFG, CACHE, LINE_INDEX) == cache_epoch(CFG, CACHE))
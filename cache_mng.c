@@ -10,79 +10,223 @@
 #include "addr.h"
 #include <stdint.h>
 #include <stdlib.h>
-#include "lru.h"
+#include <string.h> // for memcpy
+#include "replacement.h"
 
 
 #include <inttypes.h> // for PRIx macros
 
+_Static_assert(sizeof(l1_icache_entry_t) == sizeof(cache_entry_t) + L1_ICACHE_LINE,
+               "l1_icache_entry_t must have the layout of cache_entry_t");
+_Static_assert(sizeof(l2_cache_entry_t) == sizeof(cache_entry_t) + L2_CACHE_LINE,
+               "l2_cache_entry_t must have the layout of cache_entry_t");
+
 //=========================================================================
-#define PRINT_CACHE_LINE(OUTFILE, TYPE, WAYS, LINE_INDEX, WAY, WORDS_PER_LINE) \
+// letters of the cache_mesi_t states, printed for the lines that have one
+static const char mesi_names[] = "ISEM";
+
+#define PRINT_CACHE_LINE(OUTFILE, CFG, CACHE, LINE_INDEX, WAY) \
     do { \
-            fprintf(OUTFILE, "V: %1" PRIx8 ", AGE: %1" PRIx8 ", TAG: 0x%03" PRIx16 ", values: ( ", \
-                        cache_valid(TYPE, WAYS, LINE_INDEX, WAY), \
-                        cache_age(TYPE, WAYS, LINE_INDEX, WAY), \
-                        cache_tag(TYPE, WAYS, LINE_INDEX, WAY)); \
-            for(int i_ = 0; i_ < WORDS_PER_LINE; i_++) \
+            fprintf(OUTFILE, "V: %1" PRIx8 ", ", cache_valid(CFG, CACHE, LINE_INDEX, WAY)); \
+            if ((CFG)->write_policy == CACHE_WRITE_BACK) \
+                fprintf(OUTFILE, "D: %1" PRIx8 ", ", cache_dirty(CFG, CACHE, LINE_INDEX, WAY)); \
+            if (cache_mesi(CFG, CACHE, LINE_INDEX, WAY) != MESI_INVALID) \
+                fprintf(OUTFILE, "S: %c, ", mesi_names[cache_mesi(CFG, CACHE, LINE_INDEX, WAY)]); \
+            fprintf(OUTFILE, "AGE: %1" PRIx8 ", TAG: 0x%03" PRIx32 ", values: ( ", \
+                        LRU_age(CFG, CACHE, WAY, LINE_INDEX), \
+                        cache_tag(CFG, CACHE, LINE_INDEX, WAY)); \
+            for(int i_ = 0; i_ < (CFG)->words_per_line; i_++) \
                 fprintf(OUTFILE, "0x%08" PRIx32 " ", \
-                        cache_line(TYPE, WAYS, LINE_INDEX, WAY)[i_]); \
+                        cache_line(CFG, CACHE, LINE_INDEX, WAY)[i_]); \
             fputs(")\n", OUTFILE); \
     } while(0)
 
-#define PRINT_INVALID_CACHE_LINE(OUTFILE, TYPE, WAYS, LINE_INDEX, WAY, WORDS_PER_LINE) \
+#define PRINT_INVALID_CACHE_LINE(OUTFILE, CFG, CACHE, LINE_INDEX, WAY) \
     do { \
-            fprintf(OUTFILE, "V: %1" PRIx8 ", AGE: -, TAG: -----, values: ( ---------- ---------- ---------- ---------- )\n", \
-                        cache_valid(TYPE, WAYS, LINE_INDEX, WAY)); \
+            fputs("V: 0, ", OUTFILE); \
+            if ((CFG)->write_policy == CACHE_WRITE_BACK) fputs("D: -, ", OUTFILE); \
+            fputs("AGE: -, TAG: -----, values: ( ", OUTFILE); \
+            for(int i_ = 0; i_ < (CFG)->words_per_line; i_++) \
+                fputs("---------- ", OUTFILE); \
+            fputs(")\n", OUTFILE); \
     } while(0)
 
-#define DUMP_CACHE_TYPE(OUTFILE, TYPE, WAYS, LINES, WORDS_PER_LINE)  \
-    do { \
-        for(uint16_t index = 0; index < LINES; index++) { \
-            foreach_way(way, WAYS) { \
-                fprintf(output, "%02" PRIx8 "/%04" PRIx16 ": ", way, index); \
-                if(cache_valid(TYPE, WAYS, index, way)) \
-                    PRINT_CACHE_LINE(OUTFILE, const TYPE, WAYS, index, way, WORDS_PER_LINE); \
-                else \
-                    PRINT_INVALID_CACHE_LINE(OUTFILE, const TYPE, WAYS, index, way, WORDS_PER_LINE);\
-            } \
-        } \
-    } while(0)
+//=========================================================================
+// see cache_mng.h
+int cache_dump(FILE* output, const void* cache, const cache_config_t * cfg)
+{
+    M_REQUIRE_NON_NULL(output);
+    M_REQUIRE_NON_NULL(cache);
+    M_REQUIRE_NON_NULL(cfg);
+
+    fputs(cfg->write_policy == CACHE_WRITE_BACK ? "WAY/LINE: V: D: AGE: TAG: WORDS\n"
+                                                 : "WAY/LINE: V: AGE: TAG: WORDS\n", output);
+    for(uint16_t index = 0; index < cfg->sets; index++) {
+        foreach_way(way, cfg->ways) {
+            fprintf(output, "%02" PRIx8 "/%04" PRIx16 ": ", way, index);
+            if(cache_set_current(cfg, cache, index) && cache_valid(cfg, cache, index, way))
+                PRINT_CACHE_LINE(output, cfg, cache, index, way);
+            else
+                PRINT_INVALID_CACHE_LINE(output, cfg, cache, index, way);
+        }
+    }
+    putc('\n', output);
+
+    return ERR_NONE;
+}
+
 
 //=========================================================================
 // see cache_mng.h
-int cache_dump(FILE* output, const void* cache, cache_t cache_type)
+int cache_get_stats(const void * cache, const cache_config_t * cfg, cache_stats_t * stats)
+{
+    M_REQUIRE_NON_NULL(cache);
+    M_REQUIRE_NON_NULL(cfg);
+    M_REQUIRE_NON_NULL(stats);
+
+    *stats = *cache_stats(cfg, cache);
+
+    return ERR_NONE;
+}
+
+//=========================================================================
+// see cache_mng.h
+int cache_reset_stats(void * cache, const cache_config_t * cfg)
+{
+    M_REQUIRE_NON_NULL(cache);
+    M_REQUIRE_NON_NULL(cfg);
+
+    memset(cache_stats(cfg, cache), 0, sizeof(cache_stats_t));
+
+    return ERR_NONE;
+}
+
+//=========================================================================
+static const char * const cache_names[] = { "L1_ICACHE", "L1_DCACHE", "L2_CACHE", "L3_CACHE" };
+
+// miss ratio in percent, 0 when there was no access
+#define MISS_PERCENT(MISSES, HITS) \
+    ((MISSES) + (HITS) ? 100.0 * (double) (MISSES) / (double) ((MISSES) + (HITS)) : 0.0)
+
+// see cache_mng.h
+int cache_stats_dump(FILE * output, const void * cache, const cache_config_t * cfg)
 {
     M_REQUIRE_NON_NULL(output);
     M_REQUIRE_NON_NULL(cache);
+    M_REQUIRE_NON_NULL(cfg);
+
+    const cache_stats_t * st = cache_stats(cfg, cache);
+    fprintf(output, "%s: reads: %" PRIu64 " hits, %" PRIu64 " misses (%.2f%%)"
+            ", writes: %" PRIu64 " hits, %" PRIu64 " misses (%.2f%%)\n",
+            cache_names[cfg->type],
+            st->read_hits, st->read_misses, MISS_PERCENT(st->read_misses, st->read_hits),
+            st->write_hits, st->write_misses, MISS_PERCENT(st->write_misses, st->write_hits));
+    fprintf(output, "%s: victim insertions: %" PRIu64 ", evictions: %" PRIu64
+            ", back-invalidations: %" PRIu64 ", memory fills: %" PRIu64 ", memory writes: %" PRIu64 "\n",
+            cache_names[cfg->type], st->victim_insertions, st->evictions, st->back_invalidations,
+            st->memory_fills, st->memory_writes);
+    if (cfg->prefetch != CACHE_PREFETCH_NONE)
+        fprintf(output, "%s: prefetches: %" PRIu64 ", useful: %" PRIu64 " (%" PRIu64 " late)"
+                ", useless: %" PRIu64 "\n",
+                cache_names[cfg->type], st->prefetches, st->prefetch_useful, st->prefetch_late,
+                st->prefetch_useless);
+    if (cfg->way_prediction) {
+        const uint64_t predicted = st->way_memo_hits + st->way_mru_hits;
+        fprintf(output, "%s: way prediction: %" PRIu64 " memo hits, %" PRIu64 " MRU hits"
+                ", %" PRIu64 " mispredictions (accuracy %.2f%%)\n",
+                cache_names[cfg->type], st->way_memo_hits, st->way_mru_hits, st->way_mispredictions,
+                predicted ? 100.0 * (double) predicted / (double) (predicted + st->way_mispredictions) : 0.0);
+    }
 
-    fputs("WAY/LINE: V: AGE: TAG: WORDS\n", output);
-    switch (cache_type) {
-    case L1_ICACHE:
-        DUMP_CACHE_TYPE(output, l1_icache_entry_t, L1_ICACHE_WAYS,
-                        L1_ICACHE_LINES, L1_ICACHE_WORDS_PER_LINE);
-        break;
-    case L1_DCACHE:
-        DUMP_CACHE_TYPE(output, l1_dcache_entry_t, L1_DCACHE_WAYS,
-                        L1_DCACHE_LINES, L1_DCACHE_WORDS_PER_LINE);
-        break;
-    case L2_CACHE:
-        DUMP_CACHE_TYPE(output, l2_cache_entry_t, L2_CACHE_WAYS,
-                        L2_CACHE_LINES, L2_CACHE_WORDS_PER_LINE);
-        break;
-    default:
-        debug_print("%d: unknown cache type", cache_type);
-        return ERR_BAD_PARAMETER;
+    return ERR_NONE;
+}
+
+// see cache_mng.h
+int cache_coherence_stats_dump(FILE * output, uint8_t core, const cache_coherence_stats_t * coherence)
+{
+    M_REQUIRE_NON_NULL(output);
+    M_REQUIRE_NON_NULL(coherence);
+
+    fprintf(output, "CORE %" PRIu8 ": invalidations: %" PRIu64 ", upgrades: %" PRIu64
+            ", cache-to-cache transfers: %" PRIu64 "\n",
+            core, coherence->invalidations, coherence->upgrades, coherence->c2c_transfers);
+
+    return ERR_NONE;
+}
+
+// accesses of a level (its probes)
+#define STATS_ACCESSES(ST) ((ST)->read_hits + (ST)->read_misses + (ST)->write_hits + (ST)->write_misses)
+// average cycles per access, 0 when there was no access
+#define AVERAGE_CYCLES(CYCLES, ACCESSES) ((ACCESSES) ? (double) (CYCLES) / (double) (ACCESSES) : 0.0)
+
+// cycles and latency histogram of the demand accesses of an L1 cache
+static void cache_latency_dump(FILE * output, const void * cache, const cache_config_t * cfg)
+{
+    const cache_stats_t * st = cache_stats(cfg, cache);
+    const uint64_t accesses = STATS_ACCESSES(st);
+    fprintf(output, "%s: accesses: %" PRIu64 ", cycles: %" PRIu64 ", AMAT: %.2f cycles\n",
+            cache_names[cfg->type], accesses, st->cycles, AVERAGE_CYCLES(st->cycles, accesses));
+
+    for (uint8_t k = 0; k < CACHE_LATENCY_BUCKETS; ++k) {
+        if (st->latency_histogram[k] == 0) continue;
+        const uint32_t low = k ? 1u << k : 0;
+        fprintf(output, "%s:   cycles %5" PRIu32, cache_names[cfg->type], low);
+        if (k < CACHE_LATENCY_BUCKETS - 1) fprintf(output, "-%-5" PRIu32, (2u << k) - 1);
+        else fputs("+     ", output);
+        fprintf(output, ": %" PRIu64 " (%.2f%%)\n", st->latency_histogram[k],
+                100.0 * (double) st->latency_histogram[k] / (double) accesses);
     }
-    putc('\n', output);
+}
+
+// see cache_mng.h
+int cache_sim_latency_dump(FILE * output, const cache_sim_t * sim)
+{
+    M_REQUIRE_NON_NULL(output);
+    M_REQUIRE_NON_NULL(sim);
+    M_REQUIRE(sim->l1_icache != NULL && sim->l1_icfg != NULL && sim->l1_dcache != NULL && sim->l1_dcfg != NULL,
+              ERR_BAD_PARAMETER, "%s", "missing L1 cache");
+
+    cache_latency_dump(output, sim->l1_icache, sim->l1_icfg);
+    cache_latency_dump(output, sim->l1_dcache, sim->l1_dcfg);
+
+    const cache_stats_t * ist = cache_stats(sim->l1_icfg, sim->l1_icache);
+    const cache_stats_t * dst = cache_stats(sim->l1_dcfg, sim->l1_dcache);
+    const uint64_t accesses = STATS_ACCESSES(ist) + STATS_ACCESSES(dst);
+    const uint64_t cycles = ist->cycles + dst->cycles;
+    fprintf(output, "TOTAL: accesses: %" PRIu64 ", cycles: %" PRIu64 ", AMAT: %.2f cycles\n",
+            accesses, cycles, AVERAGE_CYCLES(cycles, accesses));
+    if (sim->timing == NULL) return ERR_NONE;
+
+    //NON-BLOCKING LEVELS, WITH A CORE CLOCK
+    const void * caches[] = { sim->l1_icache, sim->l1_dcache, sim->l2_cache, sim->l3_cache };
+    const cache_config_t * cfgs[] = { sim->l1_icfg, sim->l1_dcfg, sim->l2_cfg, sim->l3_cfg };
+    for (size_t i = 0; i < sizeof(caches) / sizeof(caches[0]) && caches[i] != NULL; ++i) {
+        const cache_stats_t * st = cache_stats(cfgs[i], caches[i]);
+        fprintf(output, "%s: MSHRs: %" PRIu8 ", secondary misses: %" PRIu64 ", MSHR-full cycles: %" PRIu64 "\n",
+                cache_names[cfgs[i]->type], cfgs[i]->mshrs, st->mshr_merges, st->mshr_full_cycles);
+    }
+    const cache_timing_t * timing = sim->timing;
+    fprintf(output, "TIMING: cycles: %" PRIu64 ", issue stalls: %" PRIu64 " on MSHRs, %" PRIu64
+            " on dependences, MLP: %.2f\n",
+            timing->end > timing->now ? timing->end : timing->now, timing->mshr_stalls,
+            timing->dependence_stalls, AVERAGE_CYCLES(timing->miss_cycles, timing->miss_busy));
 
     return ERR_NONE;
 }
 
 
+#define BYTE_MAX (int) 255
+#define BYTE_SIZE 8
+
+
 // DECLARATION OF AUXILIARY FUNCTIONS
 uint32_t phy_to_uint32(phy_addr_t paddr);
-int transfer_to_l1(void * cache, void * entry, cache_t cache_type, uint8_t way, uint16_t index);
-uint8_t LRU_way(void * cache, cache_t type, uint16_t index);
-uint8_t invalid_way(void * cache, cache_t type, uint32_t line_index );
+uint8_t LRU_way(const void * cache, const cache_config_t * cfg, uint16_t line_index);
+uint8_t invalid_way(const void * cache, const cache_config_t * cfg, uint16_t line_index);
+static void cache_select_kernels(cache_config_t * cfg);
+static void cache_fill_l1(const cache_sim_t * s, void * l1_cache, const cache_config_t * l1_cfg,
+                          uint16_t line_index, uint32_t tag, const word_t * line, uint8_t dirty,
+                          uint8_t mesi, uint8_t * way_out);
 
 
 // ################################################ IMPLEMENTATION OF AUXILIARY FUNCTIONS ##################################################################
@@ -92,310 +236,1264 @@ uint32_t phy_to_uint32(phy_addr_t paddr){
     return (paddr.phy_page_num << PAGE_OFFSET) | paddr.page_offset;
 }
 
-// This function will update the line in l1 depending of the words find in l2
-int transfer_to_l1(void * cache, void * entry, cache_t type, uint8_t way, uint16_t index) {
-    switch (type) {
-        case L1_ICACHE :
-            for (int i = 0; i < L1_ICACHE_WORDS_PER_LINE; ++i ) {
-                ((l1_icache_entry_t*)entry)->line[i] = cache_line(l2_cache_entry_t, L2_CACHE_LINES, index, way)[i];
-            }
+// The kernel bodies below are written once against a cache_config_t. They are forced
+// inline so that, instantiated with a compile-time constant geometry, shifts, strides
+// and loop bounds fold into immediates.
+#define KERNEL_INLINE static inline __attribute__((always_inline))
+
+// SoA planes, in order: tags, line data, valid bits, ages, dirty bits, MESI states (keeps each plane aligned)
+#define SOA_LINES_OFFSET(NB_ENTRIES)            ((NB_ENTRIES) * sizeof(uint32_t))
+#define SOA_VALID_OFFSET(NB_ENTRIES, LINE_BYTES) (SOA_LINES_OFFSET(NB_ENTRIES) + (NB_ENTRIES) * (LINE_BYTES))
+#define SOA_AGE_OFFSET(NB_ENTRIES, LINE_BYTES)   (SOA_VALID_OFFSET(NB_ENTRIES, LINE_BYTES) + (NB_ENTRIES))
+#define SOA_DIRTY_OFFSET(NB_ENTRIES, LINE_BYTES) (SOA_AGE_OFFSET(NB_ENTRIES, LINE_BYTES) + (NB_ENTRIES))
+#define SOA_MESI_OFFSET(NB_ENTRIES, LINE_BYTES)  (SOA_DIRTY_OFFSET(NB_ENTRIES, LINE_BYTES) + (NB_ENTRIES))
+
+// Per-set replacement state words, after the entries of either layout (rounded up to 8 bytes)
+#define ALIGN_8(X) (((X) + 7) & ~(size_t) 7)
+#define STATE_OFFSET(LAYOUT, SETS, WAYS, LINE_BYTES) \
+        ALIGN_8((LAYOUT) == CACHE_LAYOUT_SOA \
+                ? SOA_MESI_OFFSET((size_t) (SETS) * (WAYS), LINE_BYTES) + (size_t) (SETS) * (WAYS) \
+                : (size_t) (SETS) * (WAYS) * (sizeof(cache_entry_t) + (LINE_BYTES)))
+
+// Prefetcher tick and table after the stats (rounded up to 8 bytes), then the prefetch stamps
+// (if there is a prefetcher), then the way predictor (if there is one), then the MSHR file,
+// then the flush epochs
+static inline void cache_tail_layout(cache_config_t * cfg)
+{
+    cfg->prefetch_offset = ALIGN_8(cfg->stats_offset + sizeof(cache_stats_t));
+    cfg->stamps_offset = cfg->prefetch_offset + sizeof(uint64_t)
+                         + (size_t) cfg->prefetch_entries * sizeof(cache_prefetch_entry_t);
+    cfg->way_memo_offset = cfg->prefetch == CACHE_PREFETCH_NONE ? cfg->prefetch_offset
+                           : ALIGN_8(cfg->stamps_offset + (size_t) cfg->sets * cfg->ways * sizeof(uint32_t));
+    cfg->mshr_offset = !cfg->way_prediction ? cfg->way_memo_offset
+                       : ALIGN_8(cfg->way_memo_offset + sizeof(cache_way_memo_t) + cfg->sets);
+    cfg->epoch_offset = ALIGN_8(cfg->mshr_offset + (size_t) cfg->mshrs * sizeof(cache_mshr_t));
+}
 
-            ((l1_icache_entry_t *)entry)->v = 1;
+// Empty a set: its entries, replacement state, prefetch stamps and predicted way
+static void cache_set_clear(void * cache, const cache_config_t * cfg, uint16_t line_index)
+{
+    if (cfg->layout == CACHE_LAYOUT_AOS) {
+        memset(cache_set(cfg, cache, line_index), 0, cfg->set_size);
+    } else {
+        const size_t first = cache_slot(cfg, line_index, 0);
+        memset(&cache_tag(cfg, cache, line_index, 0), 0, cfg->ways * sizeof(uint32_t));
+        memset(cache_line(cfg, cache, line_index, 0), 0, (size_t) cfg->ways * cfg->line_bytes);
+        memset(cache_plane(cfg, cache, cfg->valid_offset, uint8_t) + first, 0, cfg->ways);
+        memset(cache_plane(cfg, cache, cfg->age_offset, uint8_t) + first, 0, cfg->ways);
+        memset(cache_plane(cfg, cache, cfg->dirty_offset, uint8_t) + first, 0, cfg->ways);
+        memset(cache_plane(cfg, cache, cfg->mesi_offset, uint8_t) + first, 0, cfg->ways);
+    }
+    cache_set_state(cfg, cache, line_index) = 0;
+    if (cfg->prefetch != CACHE_PREFETCH_NONE)
+        memset(&cache_prefetch_stamp(cfg, cache, line_index, 0), 0, cfg->ways * sizeof(uint32_t));
+    if (cfg->way_prediction) cache_way_mru(cfg, cache, line_index) = 0;
+}
 
-        break;
+// Make a set current before it is used, emptying it if the cache was flushed since its last use
+static inline void cache_set_refresh(void * cache, const cache_config_t * cfg, uint16_t line_index)
+{
+    if (cache_set_current(cfg, cache, line_index)) return;
+    cache_set_clear(cache, cfg, line_index);
+    cache_set_epoch(cfg, cache, line_index) = cache_epoch(cfg, cache);
+}
 
-        case L1_DCACHE:
-            for (int i = 0; i < L1_DCACHE_WORDS_PER_LINE; ++i ) {
-                ((l1_dcache_entry_t *)entry)->line[i] = cache_line(l2_cache_entry_t, L2_CACHE_LINES, index, way)[i];
-            }
+//Function that find the way if one of them contain an invalid line
+KERNEL_INLINE uint8_t invalid_way_body(const void * cache, const cache_config_t * cfg, uint16_t line_index){
 
-            ((l1_dcache_entry_t *)entry)->v = 1;
-        break;
+    const uint8_t nb_ways = cfg->ways;
 
-        default :
-            return ERR_BAD_PARAMETER;
+    for (uint8_t i = 0; i < nb_ways; i++) {
+        if (0 == cache_valid(cfg, cache, line_index, i)) {
+            return i;
         }
+    }
 
-    return ERR_NONE;
-
-} 
+    return HIT_WAY_MISS;
+}
 
 // Function that return the way where we have to put the entry, using the correct remplacement policy
-uint8_t LRU_way(void* cache, cache_t type, uint16_t line_index) {
+// (the switch folds away whenever cfg->policy is a constant, see the kernel instances)
+KERNEL_INLINE uint8_t policy_victim(void * cache, const cache_config_t * cfg, uint16_t line_index, uint64_t seed)
+{
+    uint8_t way = 0;
+    switch (cfg->policy) {
+    case LRU:    LRU_victim(cfg, cache, line_index, way); break;
+    case PLRU:   PLRU_victim(cfg, cache, line_index, way); break;
+    case SRRIP:  SRRIP_victim(cfg, cache, line_index, way); break;
+    case BRRIP:  BRRIP_victim(cfg, cache, line_index, way); break;
+    case FIFO:   FIFO_victim(cfg, cache, line_index, way); break;
+    case RANDOM: RANDOM_victim(cfg, cache, line_index, seed, way); break;
+    }
+    return way;
+}
+
+KERNEL_INLINE void policy_hit(void * cache, const cache_config_t * cfg, uint8_t way, uint16_t line_index)
+{
+    switch (cfg->policy) {
+#define POLICY_HIT(POLICY, ARG) case POLICY: POLICY##_hit(cfg, cache, way, line_index); break;
+    CACHE_POLICIES(POLICY_HIT, _)
+#undef POLICY_HIT
+    }
+}
 
-    uint8_t age_max = 0;
+KERNEL_INLINE void policy_fill(void * cache, const cache_config_t * cfg, uint8_t way, uint16_t line_index)
+{
+    switch (cfg->policy) {
+#define POLICY_FILL(POLICY, ARG) case POLICY: POLICY##_fill(cfg, cache, way, line_index); break;
+    CACHE_POLICIES(POLICY_FILL, _)
+#undef POLICY_FILL
+    }
+}
+
+uint8_t LRU_way(const void * cache, const cache_config_t * cfg, uint16_t line_index) {
     uint8_t way = 0;
+    LRU_victim(cfg, cache, line_index, way);
+    return way;
+}
 
-    if (type == L1_ICACHE) {
-        foreach_way(i, L1_ICACHE_WAYS) {
-            if (cache_age(l1_icache_entry_t, L1_ICACHE_WAYS, line_index, i) >= age_max){
-                way = i;
-                age_max = cache_age(l1_icache_entry_t, L1_ICACHE_WAYS, line_index, i);
+uint8_t invalid_way(const void * cache, const cache_config_t * cfg, uint16_t line_index){
+    return invalid_way_body(cache, cfg, line_index);
+}
 
-            }
+
+// ######################################################## KERNEL BODIES #############################################################
+
+KERNEL_INLINE uint8_t probe_body(void * cache, const cache_config_t * cfg, uint32_t phy)
+{
+    const uint16_t line_index = cache_line_index(cfg, phy);
+    const uint32_t tag = cache_tag_of(cfg, phy);
+    const uint8_t nb_ways = cfg->ways;
+
+    /*LOOP OVER CACHE WAYS*/
+    for (uint8_t way = 0; way < nb_ways; way++) {
+        /*CHECK IF TAG CORRESPONDS AND VALID (INVALID HOLES ARE SKIPPED: THE EXCLUSIVE POLICY LEAVES SOME IN L2)*/
+        if (tag == cache_tag(cfg, cache, line_index, way) && cache_valid(cfg, cache, line_index, way)) {
+            policy_hit(cache, cfg, way, line_index);
+            return way;
         }
     }
 
-    if (type == L1_DCACHE) {
-        foreach_way(i, L1_DCACHE_WAYS) {
-            if (cache_age(l1_dcache_entry_t, L1_DCACHE_WAYS, line_index, i) >= age_max){
-                way = i;
-                age_max = cache_age(l1_dcache_entry_t, L1_DCACHE_WAYS, line_index, i);
-            }
-        }
+    return HIT_WAY_MISS;
+}
+
+// seed comes from the runtime configuration: it is not part of the geometry
+KERNEL_INLINE uint8_t victim_body(void * cache, const cache_config_t * cfg, uint16_t line_index, uint64_t seed)
+{
+    const uint8_t way = invalid_way_body(cache, cfg, line_index);
+    return way != HIT_WAY_MISS ? way : policy_victim(cache, cfg, line_index, seed);
+}
+
+KERNEL_INLINE void install_body(void * cache, const cache_config_t * cfg, uint16_t line_index,
+                                uint8_t way, uint32_t tag, const word_t * line)
+{
+    cache_valid(cfg, cache, line_index, way) = 1;
+    cache_tag(cfg, cache, line_index, way) = tag;
+    memcpy(cache_line(cfg, cache, line_index, way), line, cfg->line_bytes);
+    policy_fill(cache, cfg, way, line_index);
+}
+
+
+// ######################################################## KERNEL INSTANCES #############################################################
+
+// Generic kernels, one per policy: geometry read from the runtime configuration
+// (working on a local copy: the uint8_t stores to the cache could alias *cfg,
+// which would force the compiler to reload the geometry on every way)
+#define DEFINE_GENERIC_KERNELS(POLICY, ARG) \
+    static uint8_t probe_generic_##POLICY(void * cache, const cache_config_t * cfg, uint32_t phy) \
+    { \
+        cache_config_t geometry = *cfg; \
+        geometry.policy = POLICY; \
+        return probe_body(cache, &geometry, phy); \
+    } \
+    static uint8_t victim_generic_##POLICY(void * cache, const cache_config_t * cfg, uint16_t line_index) \
+    { \
+        cache_config_t geometry = *cfg; \
+        geometry.policy = POLICY; \
+        return victim_body(cache, &geometry, line_index, cfg->seed); \
+    } \
+    static void install_generic_##POLICY(void * cache, const cache_config_t * cfg, uint16_t line_index, \
+                                         uint8_t way, uint32_t tag, const word_t * line) \
+    { \
+        cache_config_t geometry = *cfg; \
+        geometry.policy = POLICY; \
+        install_body(cache, &geometry, line_index, way, tag, line); \
+    } \
+    static const cache_kernels_t kernels_generic_##POLICY = { \
+        "generic " #POLICY, probe_generic_##POLICY, victim_generic_##POLICY, install_generic_##POLICY \
+    };
+
+CACHE_POLICIES(DEFINE_GENERIC_KERNELS, _)
+
+// Specialized kernels: the runtime configuration is ignored in favour of a constant one
+#define GEOMETRY_CONSTANT(SETS, WAYS, LINE_BYTES, LAYOUT, POLICY) { \
+        .sets = SETS, \
+        .ways = WAYS, \
+        .line_bytes = LINE_BYTES, \
+        .policy = POLICY, \
+        .words_per_line = (LINE_BYTES) / sizeof(word_t), \
+        .offset_bits = __builtin_ctz(LINE_BYTES), \
+        .tag_shift = __builtin_ctz(LINE_BYTES) + __builtin_ctz(SETS), \
+        .index_mask = (SETS) - 1, \
+        .entry_size = sizeof(cache_entry_t) + (LINE_BYTES), \
+        .set_size = (sizeof(cache_entry_t) + (LINE_BYTES)) * (WAYS), \
+        .layout = LAYOUT, \
+        .lines_offset = SOA_LINES_OFFSET((SETS) * (WAYS)), \
+        .valid_offset = SOA_VALID_OFFSET((SETS) * (WAYS), LINE_BYTES), \
+        .age_offset = SOA_AGE_OFFSET((SETS) * (WAYS), LINE_BYTES), \
+        .dirty_offset = SOA_DIRTY_OFFSET((SETS) * (WAYS), LINE_BYTES), \
+        .mesi_offset = SOA_MESI_OFFSET((SETS) * (WAYS), LINE_BYTES), \
+        .state_offset = STATE_OFFSET(LAYOUT, SETS, WAYS, LINE_BYTES), \
+        .age_bits = LRU_PACKED_AGE_BITS(POLICY, WAYS), \
+        .age_lanes = LRU_PACKED_AGE_BITS(POLICY, WAYS) ? LRU_AGE_LANES(LRU_AGE_BITS(WAYS), WAYS) : 0 }
+
+#define KERNEL_NAME(OP, SETS, WAYS, LINE_BYTES, LAYOUT, POLICY) \
+        OP##_##SETS##_##WAYS##_##LINE_BYTES##_##LAYOUT##_##POLICY
+
+#define DEFINE_KERNELS(SETS, WAYS, LINE_BYTES, LAYOUT, POLICY) \
+    static const cache_config_t KERNEL_NAME(geometry, SETS, WAYS, LINE_BYTES, LAYOUT, POLICY) = \
+        GEOMETRY_CONSTANT(SETS, WAYS, LINE_BYTES, CACHE_LAYOUT_##LAYOUT, POLICY); \
+    static uint8_t KERNEL_NAME(probe, SETS, WAYS, LINE_BYTES, LAYOUT, POLICY)(void * cache, \
+                                                    const cache_config_t * cfg _unused, uint32_t phy) \
+    { \
+        return probe_body(cache, &KERNEL_NAME(geometry, SETS, WAYS, LINE_BYTES, LAYOUT, POLICY), phy); \
+    } \
+    static uint8_t KERNEL_NAME(victim, SETS, WAYS, LINE_BYTES, LAYOUT, POLICY)(void * cache, \
+                                                    const cache_config_t * cfg, uint16_t line_index) \
+    { \
+        return victim_body(cache, &KERNEL_NAME(geometry, SETS, WAYS, LINE_BYTES, LAYOUT, POLICY), \
+                           line_index, cfg->seed); \
+    } \
+    static void KERNEL_NAME(install, SETS, WAYS, LINE_BYTES, LAYOUT, POLICY)(void * cache, \
+                                                    const cache_config_t * cfg _unused, uint16_t line_index, \
+                                                    uint8_t way, uint32_t tag, const word_t * line) \
+    { \
+        install_body(cache, &KERNEL_NAME(geometry, SETS, WAYS, LINE_BYTES, LAYOUT, POLICY), \
+                     line_index, way, tag, line); \
+    } \
+    static const cache_kernels_t KERNEL_NAME(kernels, SETS, WAYS, LINE_BYTES, LAYOUT, POLICY) = { \
+        #SETS "x" #WAYS "x" #LINE_BYTES " " #LAYOUT " " #POLICY, \
+        KERNEL_NAME(probe, SETS, WAYS, LINE_BYTES, LAYOUT, POLICY), \
+        KERNEL_NAME(victim, SETS, WAYS, LINE_BYTES, LAYOUT, POLICY), \
+        KERNEL_NAME(install, SETS, WAYS, LINE_BYTES, LAYOUT, POLICY) \
+    };
+
+#define DEFINE_KERNELS_BOTH_LAYOUTS(SETS, WAYS, LINE_BYTES, POLICY) \
+    DEFINE_KERNELS(SETS, WAYS, LINE_BYTES, AOS, POLICY) \
+    DEFINE_KERNELS(SETS, WAYS, LINE_BYTES, SOA, POLICY)
+
+#define DEFINE_KERNELS_ALL_GEOMETRIES(POLICY, ARG) \
+    CACHE_GEOMETRIES(DEFINE_KERNELS_BOTH_LAYOUTS, POLICY)
+
+#ifndef CACHE_NO_SPECIALIZATION
+CACHE_POLICIES(DEFINE_KERNELS_ALL_GEOMETRIES, _)
+#endif
+
+
+// ######################################################## SIMD SOA PROBES #############################################################
+
+#if defined(__x86_64__) || defined(__i386__)
+#define CACHE_X86_SIMD 1
+#include <immintrin.h>
+
+#define MOVEMASK_128(X) _mm_movemask_ps(_mm_castsi128_ps(X))
+#define MOVEMASK_256(X) _mm256_movemask_ps(_mm256_castsi256_ps(X))
+
+/*
+ * Compares LANES tags of the set at once, then checks the valid bit of the matching
+ * ways only. The last vector of a set may read past it: this stays inside the
+ * allocation since the line plane follows the tag plane, and the extra lanes are masked.
+ * One instance per policy, as for the generic kernels.
+ */
+#define DEFINE_PROBE_SOA_SIMD(NAME, TARGET, LANES, VEC, SET1, LOADU, CMPEQ, MOVEMASK, POLICY) \
+    __attribute__((target(TARGET))) \
+    static uint8_t NAME##_##POLICY(void * cache, const cache_config_t * cfg, uint32_t phy) \
+    { \
+        cache_config_t geometry = *cfg; \
+        geometry.policy = POLICY; \
+        const cache_config_t * g = &geometry; \
+        const uint16_t line_index = cache_line_index(g, phy); \
+        const uint32_t * tags = &cache_plane(g, cache, 0, uint32_t)[cache_slot(g, line_index, 0)]; \
+        const uint8_t * valid = &cache_plane(g, cache, g->valid_offset, uint8_t)[cache_slot(g, line_index, 0)]; \
+        const VEC key = SET1((int) cache_tag_of(g, phy)); \
+        for (uint8_t base = 0; base < g->ways; base += LANES) { \
+            uint32_t match = (uint32_t) MOVEMASK(CMPEQ(LOADU((const VEC *) (tags + base)), key)); \
+            if (g->ways - base < LANES) match &= (1u << (g->ways - base)) - 1; \
+            for (; match != 0; match &= match - 1) { \
+                const uint8_t way = (uint8_t) (base + __builtin_ctz(match)); \
+                if (valid[way]) { \
+                    policy_hit(cache, g, way, line_index); \
+                    return way; \
+                } \
+            } \
+        } \
+        return HIT_WAY_MISS; \
     }
 
-    if (type == L2_CACHE) {
-        foreach_way(i, L2_CACHE_WAYS) {
-            if (cache_age(l2_cache_entry_t, L2_CACHE_WAYS, line_index, i) >= age_max) {
-                way = i;
-                age_max = cache_age(l2_cache_entry_t, L2_CACHE_WAYS, line_index, i);
-            }
+#define DEFINE_PROBES_SOA_SIMD(POLICY, ARG) \
+    DEFINE_PROBE_SOA_SIMD(probe_soa_sse2, "sse2", 4, __m128i, _mm_set1_epi32, _mm_loadu_si128, \
+                          _mm_cmpeq_epi32, MOVEMASK_128, POLICY) \
+    DEFINE_PROBE_SOA_SIMD(probe_soa_avx2, "avx2", 8, __m256i, _mm256_set1_epi32, _mm256_loadu_si256, \
+                          _mm256_cmpeq_epi32, MOVEMASK_256, POLICY)
+
+CACHE_POLICIES(DEFINE_PROBES_SOA_SIMD, _)
+#endif
+
+// Best instruction set of the host for the SoA probe
+static cache_simd_t cache_simd_best(void)
+{
+#ifdef CACHE_X86_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return CACHE_SIMD_AVX2;
+    if (__builtin_cpu_supports("sse2")) return CACHE_SIMD_SSE2;
+#endif
+    return CACHE_SIMD_SCALAR;
+}
+
+// Picks the kernels of a configuration; called once per configuration, never per access
+static void cache_select_kernels(cache_config_t * cfg)
+{
+    switch (cfg->policy) {
+#define SELECT_GENERIC(POLICY, ARG) case POLICY: cfg->kernels = kernels_generic_##POLICY; break;
+    CACHE_POLICIES(SELECT_GENERIC, _)
+#undef SELECT_GENERIC
+    }
+#ifndef CACHE_NO_SPECIALIZATION
+#define SELECT_KERNELS(SETS, WAYS, LINE_BYTES, POLICY) \
+    if (cfg->policy == (POLICY) && cfg->sets == (SETS) && cfg->ways == (WAYS) && cfg->line_bytes == (LINE_BYTES)) \
+        cfg->kernels = cfg->layout == CACHE_LAYOUT_SOA ? KERNEL_NAME(kernels, SETS, WAYS, LINE_BYTES, SOA, POLICY) \
+                                                       : KERNEL_NAME(kernels, SETS, WAYS, LINE_BYTES, AOS, POLICY);
+#define SELECT_KERNELS_ALL_GEOMETRIES(POLICY, ARG) CACHE_GEOMETRIES(SELECT_KERNELS, POLICY)
+    CACHE_POLICIES(SELECT_KERNELS_ALL_GEOMETRIES, _)
+#undef SELECT_KERNELS_ALL_GEOMETRIES
+#undef SELECT_KERNELS
+#endif
+
+    // ONLY THE SOA LAYOUT HAS ITS TAGS CONTIGUOUS, THE AOS ONE ALWAYS PROBES WAY BY WAY
+    if (cfg->simd == CACHE_SIMD_AUTO) {
+        cfg->simd = cfg->layout == CACHE_LAYOUT_SOA && cfg->ways >= CACHE_SIMD_MIN_WAYS
+                    ? cache_simd_best() : CACHE_SIMD_SCALAR;
+    }
+#ifdef CACHE_X86_SIMD
+    if (cfg->layout == CACHE_LAYOUT_SOA && cfg->simd != CACHE_SIMD_SCALAR) {
+        switch (cfg->policy) {
+#define SELECT_SIMD(POLICY, ARG) \
+        case POLICY: \
+            cfg->kernels.probe = cfg->simd == CACHE_SIMD_AVX2 ? probe_soa_avx2_##POLICY : probe_soa_sse2_##POLICY; \
+            break;
+        CACHE_POLICIES(SELECT_SIMD, _)
+#undef SELECT_SIMD
         }
     }
+#endif
+}
+
 
+// Counts a probe in the read or write hits or misses of a level
+#define STATS_COUNT_PROBE(STATS, WRITE, MISS) \
+    do { \
+        if (WRITE) { if (MISS) (STATS)->write_misses++; else (STATS)->write_hits++; } \
+        else       { if (MISS) (STATS)->read_misses++;  else (STATS)->read_hits++; } \
+    } while(0)
+
+// Address of the line held in (line_index, way)
+#define cache_way_addr(CFG, CACHE, LINE_INDEX, WAY) \
+    ((cache_tag(CFG, CACHE, LINE_INDEX, WAY) << (CFG)->tag_shift) | ((uint32_t) (LINE_INDEX) << (CFG)->offset_bits))
+
+// Way holding phy, HIT_WAY_MISS if none. Unlike the probe kernel, it leaves the
+// replacement state alone: it serves the coherence of the copies, not an access.
+static inline uint8_t cache_find_way(const void * cache, const cache_config_t * cfg, uint32_t phy)
+{
+    const uint16_t line_index = cache_line_index(cfg, phy);
+    const uint32_t tag = cache_tag_of(cfg, phy);
+    if (!cache_set_current(cfg, cache, line_index)) return HIT_WAY_MISS;
+    foreach_way(way, cfg->ways) {
+        if (cache_valid(cfg, cache, line_index, way) && cache_tag(cfg, cache, line_index, way) == tag)
+            return way;
+    }
+    return HIT_WAY_MISS;
+}
+
+// The way predictor of a level learns that phy is in WAY (see cache_way_memo_t)
+static inline void cache_way_train(void * cache, const cache_config_t * cfg, uint32_t phy, uint8_t way)
+{
+    if (!cfg->way_prediction) return;
+    cache_way_memo_t * memo = cache_way_memo(cfg, cache);
+    memo->line = phy >> cfg->offset_bits;
+    memo->way = way;
+    memo->v = 1;
+    cache_way_mru(cfg, cache, cache_line_index(cfg, phy)) = way;
+}
+
+// Demand probe of a level: with way prediction, the predicted way is checked first and
+// the probe kernel only scans the set when it does not hold phy; *p_mispredicted (if not
+// NULL) then tells whether a hit was in another way. Same result and replacement update
+// as the probe kernel.
+static inline uint8_t cache_probe(void * cache, const cache_config_t * cfg, uint32_t phy, int * p_mispredicted)
+{
+    const uint16_t line_index = cache_line_index(cfg, phy);
+    cache_set_refresh(cache, cfg, line_index);
+    if (!cfg->way_prediction) return cfg->kernels.probe(cache, cfg, phy);
+
+    const cache_way_memo_t * memo = cache_way_memo(cfg, cache);
+    cache_stats_t * stats = cache_stats(cfg, cache);
+    const int from_memo = memo->v && memo->line == phy >> cfg->offset_bits;
+    uint8_t way = from_memo ? memo->way : cache_way_mru(cfg, cache, line_index);
+
+    if (cache_valid(cfg, cache, line_index, way) && cache_tag(cfg, cache, line_index, way) == cache_tag_of(cfg, phy)) {
+        policy_hit(cache, cfg, way, line_index);
+        if (from_memo) stats->way_memo_hits++;
+        else stats->way_mru_hits++;
+    } else {
+        way = cfg->kernels.probe(cache, cfg, phy);
+        if (way == HIT_WAY_MISS) return way;
+        stats->way_mispredictions++;
+        if (p_mispredicted != NULL) *p_mispredicted = 1;
+    }
+    cache_way_train(cache, cfg, phy, way);
     return way;
 }
 
-//Function that find the way if one of them contain an invalid line
-uint8_t invalid_way(void * cache, cache_t type, uint32_t line_index ){
+/*
+ * Copies of a line in several levels: a dirty copy is newer than the nearest copy below
+ * it (or memory), a clean one is the same. Writing a line down thus means updating
+ * the nearest copy below, else memory.
+ */
 
-    switch (type) {
-        case L1_ICACHE :
-            foreach_way(i, L1_ICACHE_WAYS){
-                if (0 == cache_valid(l1_icache_entry_t, L1_DCACHE_WAYS, line_index, i)){
-                    return i;
-                }
-            }
-        break;
+// The levels below FROM_CFG that may hold a copy of one of its lines, nearest first
+// (an exclusive L2 never holds a copy of an L1 line). Returns their number.
+static inline size_t cache_levels_below(const cache_sim_t * s, const cache_config_t * from_cfg,
+                                        void ** below, const cache_config_t ** below_cfg)
+{
+    size_t n = 0;
+    if (from_cfg->type <= L1_DCACHE && s->l2_cfg->inclusion != CACHE_EXCLUSIVE) {
+        below[n] = s->l2_cache;
+        below_cfg[n++] = s->l2_cfg;
+    }
+    if (s->l3_cache != NULL && from_cfg->type != L3_CACHE) {
+        below[n] = s->l3_cache;
+        below_cfg[n++] = s->l3_cfg;
+    }
+    return n;
+}
 
-        case L1_DCACHE :
-            foreach_way(i, L1_DCACHE_WAYS) {
-                if (0 == cache_valid(l1_dcache_entry_t, L1_DCACHE_WAYS, line_index, i)){
-                    return i;
-                }
+// Write the line at addr of level FROM down: into the nearest copy below, which becomes
+// dirty (or, if write-through, writes it down in turn), else into memory.
+static void cache_write_down(const cache_sim_t * s, void * from, const cache_config_t * from_cfg,
+                             uint32_t addr, const word_t * line)
+{
+    void * below[2];
+    const cache_config_t * below_cfg[2];
+    const size_t n = cache_levels_below(s, from_cfg, below, below_cfg);
+
+    for (size_t i = 0; i < n; ++i) {
+        const uint8_t way = cache_find_way(below[i], below_cfg[i], addr);
+        if (way == HIT_WAY_MISS) continue;
+
+        const uint16_t line_index = cache_line_index(below_cfg[i], addr);
+        memcpy(cache_line(below_cfg[i], below[i], line_index, way), line, below_cfg[i]->line_bytes);
+        if (below_cfg[i]->write_policy == CACHE_WRITE_BACK) {
+            cache_dirty(below_cfg[i], below[i], line_index, way) = 1;
+            return;
+        }
+        from = below[i];
+        from_cfg = below_cfg[i];
+    }
+
+    memcpy((uint8_t *) s->mem_space + cache_line_addr(from_cfg, addr), line, from_cfg->line_bytes);
+    cache_stats(from_cfg, from)->memory_writes++;
+}
+
+// Write a valid line of a cache down (see cache_write_down())
+static inline void cache_write_line_down(const cache_sim_t * s, void * cache, const cache_config_t * cfg,
+                                         uint16_t line_index, uint8_t way)
+{
+    cache_write_down(s, cache, cfg, cache_way_addr(cfg, cache, line_index, way),
+                     cache_line(cfg, cache, line_index, way));
+}
+
+/*
+ * Prefetchers (see cache_prefetch_t): each prefetched way keeps the tick of its prefetch
+ * until a demand access uses it (useful) or it is replaced (useless).
+ */
+
+// A way of a level with a prefetcher is replaced
+static inline void cache_prefetch_forget(void * cache, const cache_config_t * cfg,
+                                         uint16_t line_index, uint8_t way)
+{
+    uint32_t * stamp = &cache_prefetch_stamp(cfg, cache, line_index, way);
+    if (*stamp != 0) {
+        cache_stats(cfg, cache)->prefetch_useless++;
+        *stamp = 0;
+    }
+}
+
+// A way of a level with a prefetcher was just filled by a prefetch
+static inline void cache_prefetch_mark(void * cache, const cache_config_t * cfg,
+                                       uint16_t line_index, uint8_t way)
+{
+    const uint32_t tick = cache_prefetch_tick(cfg, cache);
+    cache_prefetch_stamp(cfg, cache, line_index, way) = tick != 0 ? tick : 1;
+    cache_stats(cfg, cache)->prefetches++;
+}
+
+// A demand access of a level with a prefetcher, to (line_index, way) or a miss (HIT_WAY_MISS).
+// Returns 1 if the prefetcher trains on it: a miss or the first hit on a prefetched line.
+static inline int cache_prefetch_demand(void * cache, const cache_config_t * cfg,
+                                        uint16_t line_index, uint8_t way)
+{
+    const uint32_t tick = ++cache_prefetch_tick(cfg, cache);
+    if (way == HIT_WAY_MISS) return 1;
+
+    uint32_t * stamp = &cache_prefetch_stamp(cfg, cache, line_index, way);
+    if (*stamp == 0) return 0;
+
+    cache_stats_t * stats = cache_stats(cfg, cache);
+    stats->prefetch_useful++;
+    if (tick - *stamp < CACHE_PREFETCH_LATE_ACCESSES) stats->prefetch_late++;
+    *stamp = 0;
+    return 1;
+}
+
+// Update a region (or, DIRECTION, a stream) with an access to line LINE of PAGE.
+// Returns 1 once its stride (for a stream, only the sign) has been seen twice in a row.
+static inline int cache_prefetch_follow(cache_prefetch_entry_t * e, uint32_t page, uint32_t line,
+                                        int direction)
+{
+    if (!e->v || e->page != page) {
+        const uint32_t used = e->used;
+        memset(e, 0, sizeof(*e));
+        e->v = 1;
+        e->page = page;
+        e->last = line;
+        e->used = used;
+        return 0;
+    }
+
+    int32_t d = (int32_t) (line - e->last);
+    if (direction) d = (d > 0) - (d < 0);
+    if (d == 0) return 0;
+
+    if (d == e->stride) {
+        if (e->confidence < UINT8_MAX) e->confidence++;
+    } else {
+        e->stride = d;
+        e->confidence = 0;
+    }
+    e->last = line;
+    return e->confidence > 0;
+}
+
+// Train the prefetcher of a level on a demand access to phy. The addresses of the lines to
+// prefetch (at most its degree, all in the page of phy) go to LINES; returns their number.
+static uint8_t cache_prefetch_train(void * cache, const cache_config_t * cfg, uint32_t phy, uint32_t * lines)
+{
+    const uint32_t line = phy >> cfg->offset_bits;
+    const uint32_t page = phy >> PAGE_OFFSET;
+    cache_prefetch_entry_t * table = cache_prefetch_table(cfg, cache);
+    int32_t stride = 1;
+
+    switch (cfg->prefetch) {
+    case CACHE_PREFETCH_NEXT_LINE:
+        break;
+    case CACHE_PREFETCH_STRIDE: {
+        cache_prefetch_entry_t * e = &table[page & (cfg->prefetch_entries - 1u)];
+        if (!cache_prefetch_follow(e, page, line, 0)) return 0;
+        stride = e->stride;
+        break;
+    }
+    case CACHE_PREFETCH_STREAM: {
+        // THE STREAM OF THE PAGE, ELSE THE LEAST RECENTLY USED ONE
+        cache_prefetch_entry_t * e = &table[0];
+        for (uint16_t i = 0; i < cfg->prefetch_entries; ++i) {
+            if (table[i].v && table[i].page == page) {
+                e = &table[i];
+                break;
             }
+            if (!table[i].v || (e->v && table[i].used < e->used)) e = &table[i];
+        }
+        e->used = cache_prefetch_tick(cfg, cache);
+        if (!cache_prefetch_follow(e, page, line, 1)) return 0;
+        stride = e->stride;
         break;
+    }
+    default:
+        return 0;
+    }
 
-        case L2_CACHE :
-            foreach_way(i, L2_CACHE_WAYS) {
-                if (0 == cache_valid(l2_cache_entry_t, L2_CACHE_WAYS, line_index, i)){
-                    return i;
-                }
+    uint8_t n = 0;
+    for (uint8_t k = 1; k <= cfg->prefetch_degree; ++k) {
+        const uint32_t next = line + (uint32_t) ((int32_t) k * stride);
+        const uint32_t next_phy = next << cfg->offset_bits;
+        if (next_phy >> cfg->offset_bits != next || next_phy >> PAGE_OFFSET != page) break;
+        lines[n++] = next_phy;
+    }
+    return n;
+}
+
+// Install a line with its dirty bit and MESI state; a write-through level writes a dirty
+// line down at once
+static inline void cache_install(const cache_sim_t * s, void * cache, const cache_config_t * cfg,
+                                 uint16_t line_index, uint8_t way, uint32_t tag,
+                                 const word_t * line, uint8_t dirty, uint8_t mesi)
+{
+    if (cfg->prefetch != CACHE_PREFETCH_NONE) cache_prefetch_forget(cache, cfg, line_index, way);
+    cfg->kernels.install(cache, cfg, line_index, way, tag, line);
+    if (dirty && cfg->write_policy == CACHE_WRITE_THROUGH) {
+        cache_write_line_down(s, cache, cfg, line_index, way);
+        dirty = 0;
+    }
+    cache_dirty(cfg, cache, line_index, way) = dirty;
+    cache_mesi(cfg, cache, line_index, way) = mesi;
+}
+
+// A line left an inclusive level, so it leaves CACHE above it too (if it is known).
+// A dirty copy there is newer than the evicted one: its data goes to INTO, which becomes dirty.
+static inline void cache_back_invalidate(void * cache, const cache_config_t * cfg, uint32_t addr,
+                                         word_t * into, uint8_t * into_dirty)
+{
+    if (cache == NULL) return;
+
+    const uint8_t way = cache_find_way(cache, cfg, addr);
+    if (way == HIT_WAY_MISS) return;
+
+    const uint16_t line_index = cache_line_index(cfg, addr);
+    if (cache_dirty(cfg, cache, line_index, way)) {
+        memcpy(into, cache_line(cfg, cache, line_index, way), cfg->line_bytes);
+        *into_dirty = 1;
+    }
+    cache_valid(cfg, cache, line_index, way) = 0;
+    cache_stats(cfg, cache)->back_invalidations++;
+}
+
+// Choose the way of L3 set index_l3 to fill and free it. A valid line there leaves the
+// hierarchy: with an inclusive L3 it is back-invalidated from all the levels above, of
+// all the cores (nearest first, so that the newest dirty copy wins; at most one core
+// has one), then written back if dirty.
+static inline uint8_t cache_l3_make_room(const cache_sim_t * s, uint16_t index_l3)
+{
+    const cache_config_t * l3_cfg = s->l3_cfg;
+    cache_set_refresh(s->l3_cache, l3_cfg, index_l3);
+    const uint8_t way_l3 = l3_cfg->kernels.victim(s->l3_cache, l3_cfg, index_l3);
+
+    if (cache_valid(l3_cfg, s->l3_cache, index_l3, way_l3)) {
+        cache_stats(l3_cfg, s->l3_cache)->evictions++;
+        if (l3_cfg->inclusion == CACHE_INCLUSIVE) {
+            const uint32_t victim_addr = cache_way_addr(l3_cfg, s->l3_cache, index_l3, way_l3);
+            word_t * line = cache_line(l3_cfg, s->l3_cache, index_l3, way_l3);
+            uint8_t * dirty = &cache_dirty(l3_cfg, s->l3_cache, index_l3, way_l3);
+            const cache_sim_t * core = s->cores != NULL ? s->cores : s;
+            const cache_sim_t * const end = core + (s->cores != NULL ? s->nb_cores : 1);
+            for (; core < end; ++core) {
+                cache_back_invalidate(core->l2_cache, core->l2_cfg, victim_addr, line, dirty);
+                cache_back_invalidate(core->l1_icache, core->l1_icfg, victim_addr, line, dirty);
+                cache_back_invalidate(core->l1_dcache, core->l1_dcfg, victim_addr, line, dirty);
             }
-        break;
+        }
+        if (cache_dirty(l3_cfg, s->l3_cache, index_l3, way_l3))
+            cache_write_line_down(s, s->l3_cache, l3_cfg, index_l3, way_l3);
+        cache_valid(l3_cfg, s->l3_cache, index_l3, way_l3) = 0;
+    }
 
-        default :
-            return HIT_WAY_MISS ;
+    return way_l3;
+}
+
+// A valid line leaves L2. An exclusive L3 takes it in, its only way in. Otherwise a
+// clean line is just dropped and a dirty one is written down.
+static inline void cache_l2_evict(const cache_sim_t * s, uint16_t index_l2, uint8_t way_l2)
+{
+    const cache_config_t * l2_cfg = s->l2_cfg;
+    const uint8_t dirty = cache_dirty(l2_cfg, s->l2_cache, index_l2, way_l2);
+
+    if (s->l3_cache != NULL && s->l3_cfg->inclusion == CACHE_EXCLUSIVE) {
+        const cache_config_t * l3_cfg = s->l3_cfg;
+        const uint32_t victim_addr = cache_way_addr(l2_cfg, s->l2_cache, index_l2, way_l2);
+        const uint16_t index_l3 = cache_line_index(l3_cfg, victim_addr);
+        // SEVERAL CORES MAY SHARE THE LINE: ANOTHER ONE MAY HAVE PUT IT IN L3 ALREADY
+        if (s->cores != NULL && cache_find_way(s->l3_cache, l3_cfg, victim_addr) != HIT_WAY_MISS) {
+            if (dirty) cache_write_line_down(s, s->l2_cache, l2_cfg, index_l2, way_l2);
+            return;
         }
+        const uint8_t way_l3 = cache_l3_make_room(s, index_l3);
+        cache_stats(l3_cfg, s->l3_cache)->victim_insertions++;
+        cache_install(s, s->l3_cache, l3_cfg, index_l3, way_l3, cache_tag_of(l3_cfg, victim_addr),
+                      cache_line(l2_cfg, s->l2_cache, index_l2, way_l2), dirty, MESI_INVALID);
+    } else if (dirty) {
+        cache_write_line_down(s, s->l2_cache, l2_cfg, index_l2, way_l2);
+    }
+}
 
-    return HIT_WAY_MISS;
+// Choose the way of L2 set index_l2 to fill and free it: a valid line there is
+// back-invalidated from the L1 caches if L2 is inclusive, then leaves L2 (see cache_l2_evict()).
+static inline uint8_t cache_l2_make_room(const cache_sim_t * s, uint16_t index_l2)
+{
+    const cache_config_t * l2_cfg = s->l2_cfg;
+    cache_set_refresh(s->l2_cache, l2_cfg, index_l2);
+    const uint8_t way_l2 = l2_cfg->kernels.victim(s->l2_cache, l2_cfg, index_l2);
+
+    if (cache_valid(l2_cfg, s->l2_cache, index_l2, way_l2)) {
+        cache_stats(l2_cfg, s->l2_cache)->evictions++;
+        if (l2_cfg->inclusion == CACHE_INCLUSIVE) {
+            const uint32_t victim_addr = cache_way_addr(l2_cfg, s->l2_cache, index_l2, way_l2);
+            word_t * line = cache_line(l2_cfg, s->l2_cache, index_l2, way_l2);
+            uint8_t * dirty = &cache_dirty(l2_cfg, s->l2_cache, index_l2, way_l2);
+            cache_back_invalidate(s->l1_icache, s->l1_icfg, victim_addr, line, dirty);
+            cache_back_invalidate(s->l1_dcache, s->l1_dcfg, victim_addr, line, dirty);
+        }
+        cache_l2_evict(s, index_l2, way_l2);
+        cache_valid(l2_cfg, s->l2_cache, index_l2, way_l2) = 0;
+    }
+
+    return way_l2;
 }
 
+// A valid line leaves L1. An exclusive L2 takes it in, its only way in. Otherwise a
+// clean line is just dropped and a dirty one is written down.
+static inline void cache_l1_evict(const cache_sim_t * s, void * l1_cache, const cache_config_t * l1_cfg,
+                                  uint16_t line_index, uint8_t way)
+{
+    const cache_config_t * l2_cfg = s->l2_cfg;
+    const uint8_t dirty = cache_dirty(l1_cfg, l1_cache, line_index, way);
+    cache_stats(l1_cfg, l1_cache)->evictions++;
 
+    if (l2_cfg->inclusion != CACHE_EXCLUSIVE) {
+        if (dirty) cache_write_line_down(s, l1_cache, l1_cfg, line_index, way);
+        return;
+    }
+
+    const uint32_t victim_addr = cache_way_addr(l1_cfg, l1_cache, line_index, way);
+    const uint16_t index_l2 = cache_line_index(l2_cfg, victim_addr);
+
+    // THE OTHER L1 MAY HAVE LEFT ITS COPY OF THE LINE IN L2: THE VICTIM GOES INTO IT (UNLESS IT
+    // IS CLEAN AND THE COPY DIRTY), SO THAT L2 NEVER HOLDS A LINE TWICE
+    const uint8_t copy_l2 = cache_find_way(s->l2_cache, l2_cfg, victim_addr);
+    if (copy_l2 != HIT_WAY_MISS) {
+        cache_stats(l2_cfg, s->l2_cache)->victim_insertions++;
+        if (dirty || !cache_dirty(l2_cfg, s->l2_cache, index_l2, copy_l2))
+            cache_install(s, s->l2_cache, l2_cfg, index_l2, copy_l2, cache_tag_of(l2_cfg, victim_addr),
+                          cache_line(l1_cfg, l1_cache, line_index, way), dirty,
+                          cache_mesi(l1_cfg, l1_cache, line_index, way));
+        return;
+    }
+
+    const uint8_t way_l2 = cache_l2_make_room(s, index_l2);
+    // AN INCLUSIVE L3 MAY HAVE TAKEN THE VICTIM OUT OF THE HIERARCHY MEANWHILE
+    if (!cache_valid(l1_cfg, l1_cache, line_index, way)) return;
+    cache_stats(l2_cfg, s->l2_cache)->victim_insertions++;
+    cache_install(s, s->l2_cache, l2_cfg, index_l2, way_l2, cache_tag_of(l2_cfg, victim_addr),
+                  cache_line(l1_cfg, l1_cache, line_index, way), dirty,
+                  cache_mesi(l1_cfg, l1_cache, line_index, way));
+}
+
+// Line of addr for the levels above L3, after an L2 miss: from L3 if it holds the line
+// (copied to BUF), else from memory, through L3 unless it is exclusive. *p_line and
+// *dirty receive the line and its dirty bit, which only an exclusive L3 hands over.
+// Returns 1 if the line comes from memory.
+static inline int cache_fetch_below_l2(const cache_sim_t * s, uint32_t addr, int write,
+                                       word_t * buf, const word_t ** p_line, uint8_t * dirty)
+{
+    const word_t * mem_line = (const word_t *) ((const uint8_t *) s->mem_space + cache_line_addr(s->l2_cfg, addr));
+    *p_line = mem_line;
+    *dirty = 0;
+    if (s->l3_cache == NULL) return 1;
+
+    const cache_config_t * l3_cfg = s->l3_cfg;
+    const uint16_t index_l3 = cache_line_index(l3_cfg, addr);
+    const uint8_t way_l3 = cache_probe(s->l3_cache, l3_cfg, addr, NULL);
+    cache_stats_t * l3_stats = cache_stats(l3_cfg, s->l3_cache);
+    STATS_COUNT_PROBE(l3_stats, write, way_l3 == HIT_WAY_MISS);
+
+    if (way_l3 != HIT_WAY_MISS) {
+        memcpy(buf, cache_line(l3_cfg, s->l3_cache, index_l3, way_l3), l3_cfg->line_bytes);
+        *p_line = buf;
+        if (l3_cfg->inclusion == CACHE_EXCLUSIVE) {
+            *dirty = cache_dirty(l3_cfg, s->l3_cache, index_l3, way_l3);
+            cache_valid(l3_cfg, s->l3_cache, index_l3, way_l3) = 0;
+        }
+        return 0;
+    }
+
+    if (l3_cfg->inclusion != CACHE_EXCLUSIVE) {
+        const uint8_t way = cache_l3_make_room(s, index_l3);
+        cache_install(s, s->l3_cache, l3_cfg, index_l3, way, cache_tag_of(l3_cfg, addr), mem_line, 0, MESI_INVALID);
+        l3_stats->memory_fills++;
+    }
+    return 1;
+}
+
+// Insert a line coming from below in L1. If the set is full, the victim of L1
+// (per its replacement policy) leaves it first (see cache_l1_evict()).
+static void cache_fill_l1(const cache_sim_t * s, void * l1_cache, const cache_config_t * l1_cfg,
+                          uint16_t line_index, uint32_t tag, const word_t * line, uint8_t dirty,
+                          uint8_t mesi, uint8_t * way_out)
+{
+    cache_set_refresh(l1_cache, l1_cfg, line_index);
+    const uint8_t way = l1_cfg->kernels.victim(l1_cache, l1_cfg, line_index);
+
+    //CASE THERE IS NO PLACE: THE OLDEST LINE OF L1 LEAVES
+    if (cache_valid(l1_cfg, l1_cache, line_index, way))
+        cache_l1_evict(s, l1_cache, l1_cfg, line_index, way);
+
+    cache_install(s, l1_cache, l1_cfg, line_index, way, tag, line, dirty, mesi);
+    *way_out = way;
+}
 
 /*
-Define Macro for init, flush, insert, hit and read
+ * MESI coherence of the private levels of the cores (see cache_cores_access_batch()),
+ * by snooping: the state of a line in a core is that of all its copies there.
  */
 
-#define BYTE_MAX (int) 255
-#define BYTE_SIZE 8
-#define INDEX_OFFSET 4
-#define INDEX_L2_MASK 0b111111111
-#define INDEX_L1_MASK 0b111111
+// The private levels of a core, from the top down
+#define CACHE_PRIVATE_LEVELS 3
+#define CACHE_PRIVATE_CACHES(CORE) { (CORE)->l1_icache, (CORE)->l1_dcache, (CORE)->l2_cache }
+#define CACHE_PRIVATE_CFGS(CORE)   { (CORE)->l1_icfg, (CORE)->l1_dcfg, (CORE)->l2_cfg }
+
+// State of the line at addr in a core, MESI_INVALID if it holds no copy
+static inline uint8_t cache_core_mesi(const cache_sim_t * core, uint32_t addr)
+{
+    void * const caches[CACHE_PRIVATE_LEVELS] = CACHE_PRIVATE_CACHES(core);
+    const cache_config_t * const cfgs[CACHE_PRIVATE_LEVELS] = CACHE_PRIVATE_CFGS(core);
+    for (size_t i = 0; i < CACHE_PRIVATE_LEVELS; ++i) {
+        const uint8_t way = cache_find_way(caches[i], cfgs[i], addr);
+        if (way != HIT_WAY_MISS) return cache_mesi(cfgs[i], caches[i], cache_line_index(cfgs[i], addr), way);
+    }
+    return MESI_INVALID;
+}
+
+// Set the state of all the copies of the line at addr in a core. To leave MESI_MODIFIED
+// (MESI: MESI_SHARED or MESI_INVALID), the dirty copies are written down first, from the
+// top down so that the newest data reaches the shared levels.
+static void cache_core_set_mesi(const cache_sim_t * core, uint32_t addr, uint8_t mesi)
+{
+    void * const caches[CACHE_PRIVATE_LEVELS] = CACHE_PRIVATE_CACHES(core);
+    const cache_config_t * const cfgs[CACHE_PRIVATE_LEVELS] = CACHE_PRIVATE_CFGS(core);
+    for (size_t i = 0; i < CACHE_PRIVATE_LEVELS; ++i) {
+        const uint8_t way = cache_find_way(caches[i], cfgs[i], addr);
+        if (way == HIT_WAY_MISS) continue;
+
+        const uint16_t line_index = cache_line_index(cfgs[i], addr);
+        if (mesi != MESI_MODIFIED && cache_dirty(cfgs[i], caches[i], line_index, way)) {
+            cache_write_line_down(core, caches[i], cfgs[i], line_index, way);
+            cache_dirty(cfgs[i], caches[i], line_index, way) = 0;
+        }
+        if (mesi == MESI_INVALID) cache_valid(cfgs[i], caches[i], line_index, way) = 0;
+        else cache_mesi(cfgs[i], caches[i], line_index, way) = mesi;
+    }
+}
 
-// ######################################################## CACHE_INIT MACRO #############################################################
+// Core s misses the line at addr in all its private levels, or upgrades its shared copy
+// (WRITE): the copies of the other cores become shared, or are invalidated for a write.
+// Returns the state of the copies of s.
+static uint8_t cache_snoop(const cache_sim_t * s, uint32_t addr, int write)
+{
+    uint8_t mesi = write ? MESI_MODIFIED : MESI_EXCLUSIVE;
+
+    for (const cache_sim_t * other = s->cores; other < s->cores + s->nb_cores; ++other) {
+        if (other == s) continue;
+        const uint8_t other_mesi = cache_core_mesi(other, addr);
+        if (other_mesi == MESI_INVALID) continue;
+
+        //A MODIFIED COPY IS WRITTEN DOWN FOR S: A CACHE-TO-CACHE TRANSFER
+        if (other_mesi == MESI_MODIFIED) s->coherence->c2c_transfers++;
+        if (write) {
+            other->coherence->invalidations++;
+            cache_core_set_mesi(other, addr, MESI_INVALID);
+        } else {
+            mesi = MESI_SHARED;
+            cache_core_set_mesi(other, addr, MESI_SHARED);
+        }
+    }
+
+    return mesi;
+}
 
-#define init_cache(TYPE, TAG_REMAINING_BITS, WORDS_PER_LINE) \
- TYPE* VAR = (TYPE*) cache_entry; \
-    VAR->v = 1; \
-    VAR->tag = phy >> TAG_REMAINING_BITS; \
-    VAR->age = 0; \
-    M_REQUIRE_NON_NULL(memcpy(VAR->line, mem_space + phy, WORDS_PER_LINE*sizeof(word_t)));
 
+// ########################################################## FUNCTIONS ###################################################################
+/*
+    FUNCTION BEHAVIOUR COMMENTS IN MACROS
+*/
+
+static inline int is_power_of_2(uint32_t x)
+{
+    return x != 0 && (x & (x - 1)) == 0;
+}
 
+static inline uint8_t log2_u32(uint32_t x)
+{
+    uint8_t n = 0;
+    while (x >>= 1) ++n;
+    return n;
+}
+
+
+int cache_config_init(cache_config_t * cfg, cache_t type, uint16_t sets,
+                      uint8_t ways, uint16_t line_bytes, cache_replace_t policy){
+
+    M_REQUIRE_NON_NULL(cfg);
+    M_REQUIRE(type >= L1_ICACHE && type <= L3_CACHE, ERR_BAD_PARAMETER, "%d: unknown cache type", type);
+    M_REQUIRE(policy >= LRU && policy <= RANDOM, ERR_POLICY, "%d: unknown replacement policy", policy);
+    M_REQUIRE(policy != PLRU || (is_power_of_2(ways) && ways <= 64), ERR_POLICY,
+              "tree-PLRU needs a power-of-2 number of ways, at most 64 (%u)", ways);
+    M_REQUIRE(is_power_of_2(sets), ERR_SIZE, "%u sets is not a power of 2", sets);
+    M_REQUIRE(ways > 0 && ways != HIT_WAY_MISS, ERR_SIZE, "%u: bad number of ways", ways);
+    M_REQUIRE(is_power_of_2(line_bytes) && line_bytes >= sizeof(word_t) && line_bytes <= CACHE_MAX_LINE_BYTES,
+              ERR_SIZE, "%u: bad line size", line_bytes);
+
+    const uint8_t offset_bits = log2_u32(line_bytes);
+    const uint8_t tag_shift = (uint8_t) (offset_bits + log2_u32(sets));
+    M_REQUIRE(tag_shift < PHY_ADDR, ERR_SIZE, "%s", "cache larger than the physical address space");
+
+    cfg->type = type;
+    cfg->sets = sets;
+    cfg->ways = ways;
+    cfg->line_bytes = line_bytes;
+    cfg->policy = policy;
+
+    cfg->words_per_line = (uint8_t) (line_bytes / sizeof(word_t));
+    cfg->offset_bits = offset_bits;
+    cfg->tag_shift = tag_shift;
+    cfg->index_mask = (uint32_t) sets - 1;
+    cfg->entry_size = sizeof(cache_entry_t) + line_bytes;
+    cfg->set_size = cfg->entry_size * ways;
+    cfg->seed = CACHE_DEFAULT_SEED;
+    cfg->write_policy = CACHE_WRITE_THROUGH;
+    cfg->inclusion = type == L3_CACHE ? CACHE_INCLUSIVE : CACHE_EXCLUSIVE;
+    cfg->age_bits = LRU_PACKED_AGE_BITS(policy, ways);
+    cfg->age_lanes = cfg->age_bits ? LRU_AGE_LANES(cfg->age_bits, ways) : 0;
+    cfg->prefetch = CACHE_PREFETCH_NONE;
+    cfg->prefetch_degree = 0;
+    cfg->prefetch_entries = 0;
+    cfg->hit_latency = (uint16_t) (type == L3_CACHE ? L3_CACHE_HIT_LATENCY
+                                   : type == L2_CACHE ? L2_CACHE_HIT_LATENCY : L1_CACHE_HIT_LATENCY);
+    cfg->memory_latency = CACHE_MEMORY_LATENCY;
+    cfg->mshrs = (uint8_t) (type == L3_CACHE ? L3_CACHE_MSHRS : type == L2_CACHE ? L2_CACHE_MSHRS : L1_CACHE_MSHRS);
+    cfg->way_prediction = 0;
+
+    return cache_config_set_layout(cfg, CACHE_LAYOUT_AOS);
+}
+
+
+int cache_config_set_layout(cache_config_t * cfg, cache_layout_t layout){
+
+    M_REQUIRE_NON_NULL(cfg);
+    M_REQUIRE(layout == CACHE_LAYOUT_AOS || layout == CACHE_LAYOUT_SOA,
+              ERR_BAD_PARAMETER, "%d: unknown cache layout", layout);
+
+    const size_t nb_entries = (size_t) cfg->sets * cfg->ways;
+    cfg->layout = layout;
+    cfg->lines_offset = SOA_LINES_OFFSET(nb_entries);
+    cfg->valid_offset = SOA_VALID_OFFSET(nb_entries, cfg->line_bytes);
+    cfg->age_offset = SOA_AGE_OFFSET(nb_entries, cfg->line_bytes);
+    cfg->dirty_offset = SOA_DIRTY_OFFSET(nb_entries, cfg->line_bytes);
+    cfg->mesi_offset = SOA_MESI_OFFSET(nb_entries, cfg->line_bytes);
+    cfg->state_offset = STATE_OFFSET(layout, cfg->sets, cfg->ways, cfg->line_bytes);
+    cfg->stats_offset = cfg->state_offset + (size_t) cfg->sets * sizeof(uint64_t);
+    cache_tail_layout(cfg);
+    cfg->simd = CACHE_SIMD_AUTO;
+    cache_select_kernels(cfg);
+
+    return ERR_NONE;
+}
 
-// ######################################################## CACHE_FLUSH MACRO #############################################################
 
-#define flush_cache(TYPE, CACHE_LINES, CACHE_WAYS, WORDS_PER_LINE) \
-TYPE* var = (TYPE*) cache;\
-        /*SETTING ALL ENTRIES TO 0*/ \
-        for (size_t i = 0; i < CACHE_LINES*CACHE_WAYS; ++i){ \
-            var[i].age = 0; \
-            var[i].v = 0; \
-            var[i].tag = 0; \
-            M_REQUIRE_NON_NULL(memset(((TYPE *)cache)->line, 0, WORDS_PER_LINE * sizeof(word_t)));\
-             \
+int cache_config_set_write_policy(cache_config_t * cfg, cache_write_t write_policy){
+
+    M_REQUIRE_NON_NULL(cfg);
+    M_REQUIRE(write_policy == CACHE_WRITE_THROUGH || write_policy == CACHE_WRITE_BACK,
+              ERR_POLICY, "%d: unknown write policy", write_policy);
+
+    cfg->write_policy = write_policy;
+
+    return ERR_NONE;
+}
+
+
+int cache_config_set_inclusion(cache_config_t * cfg, cache_inclusion_t inclusion){
+
+    M_REQUIRE_NON_NULL(cfg);
+    M_REQUIRE(cfg->type == L2_CACHE || cfg->type == L3_CACHE, ERR_BAD_PARAMETER,
+              "%s", "only L2 and L3 have an inclusion policy");
+    M_REQUIRE(inclusion >= CACHE_EXCLUSIVE && inclusion <= CACHE_NINE,
+              ERR_POLICY, "%d: unknown inclusion policy", inclusion);
+
+    cfg->inclusion = inclusion;
+
+    return ERR_NONE;
+}
+
+
+int cache_config_set_prefetch(cache_config_t * cfg, cache_prefetch_t prefetch,
+                              uint8_t degree, uint16_t entries){
+
+    M_REQUIRE_NON_NULL(cfg);
+    M_REQUIRE(prefetch >= CACHE_PREFETCH_NONE && prefetch <= CACHE_PREFETCH_STREAM,
+              ERR_POLICY, "%d: unknown prefetcher", prefetch);
+    M_REQUIRE(prefetch == CACHE_PREFETCH_NONE || cfg->type == L1_DCACHE || cfg->type == L2_CACHE,
+              ERR_BAD_PARAMETER, "%s", "only L1 DCACHE and L2 have a prefetcher");
+    M_REQUIRE(prefetch == CACHE_PREFETCH_NONE || (degree >= 1 && degree <= CACHE_PREFETCH_MAX_DEGREE),
+              ERR_BAD_PARAMETER, "%u: bad prefetch degree", degree);
+    const int with_table = prefetch == CACHE_PREFETCH_STRIDE || prefetch == CACHE_PREFETCH_STREAM;
+    M_REQUIRE(!with_table || (entries >= 1 && entries <= CACHE_PREFETCH_MAX_ENTRIES
+                              && (prefetch != CACHE_PREFETCH_STRIDE || is_power_of_2(entries))),
+              ERR_SIZE, "%u: bad number of prefetcher entries", entries);
+
+    cfg->prefetch = prefetch;
+    cfg->prefetch_degree = prefetch == CACHE_PREFETCH_NONE ? 0 : degree;
+    cfg->prefetch_entries = with_table ? entries : 0;
+    cache_tail_layout(cfg);
+
+    return ERR_NONE;
+}
+
+
+int cache_config_set_latency(cache_config_t * cfg, uint16_t hit_latency, uint16_t memory_latency){
+
+    M_REQUIRE_NON_NULL(cfg);
+
+    cfg->hit_latency = hit_latency;
+    cfg->memory_latency = memory_latency;
+
+    return ERR_NONE;
+}
+
+
+int cache_config_set_mshrs(cache_config_t * cfg, uint8_t mshrs){
+
+    M_REQUIRE_NON_NULL(cfg);
+    M_REQUIRE(mshrs >= 1 && mshrs <= CACHE_MAX_MSHRS, ERR_SIZE, "%u: bad number of MSHRs", mshrs);
+
+    cfg->mshrs = mshrs;
+    cache_tail_layout(cfg);
+
+    return ERR_NONE;
+}
+
+
+int cache_config_set_way_prediction(cache_config_t * cfg, int enable){
+
+    M_REQUIRE_NON_NULL(cfg);
+
+    cfg->way_prediction = enable != 0;
+    cache_tail_layout(cfg);
+
+    return ERR_NONE;
+}
+
+
+int cache_config_set_simd(cache_config_t * cfg, cache_simd_t simd){
+
+    M_REQUIRE_NON_NULL(cfg);
+    M_REQUIRE(simd >= CACHE_SIMD_AUTO && simd <= CACHE_SIMD_AVX2,
+              ERR_BAD_PARAMETER, "%d: unknown instruction set", simd);
+    M_REQUIRE(simd == CACHE_SIMD_AUTO || simd <= cache_simd_best(),
+              ERR_BAD_PARAMETER, "%d: instruction set not supported by this host", simd);
+
+    cfg->simd = simd;
+    cache_select_kernels(cfg);
+
+    return ERR_NONE;
+}
+
+
+static const char * const policy_names[] = {
+#define POLICY_NAME(POLICY, ARG) [POLICY] = #POLICY,
+    CACHE_POLICIES(POLICY_NAME, _)
+#undef POLICY_NAME
+};
+
+const char * cache_policy_name(cache_replace_t policy){
+    return policy >= LRU && policy <= RANDOM ? policy_names[policy] : NULL;
+}
+
+
+int cache_policy_parse(const char * name, cache_replace_t * policy){
+
+    M_REQUIRE_NON_NULL(name);
+    M_REQUIRE_NON_NULL(policy);
+
+    for (size_t i = 0; i < sizeof(policy_names) / sizeof(policy_names[0]); ++i) {
+        if (!strcmp(name, policy_names[i])) {
+            *policy = (cache_replace_t) i;
+            return ERR_NONE;
+        }
+    }
+    M_EXIT(ERR_POLICY, "%s: unknown replacement policy", name);
+}
+
+
+static const char * const inclusion_names[] = {
+    [CACHE_EXCLUSIVE] = "EXCLUSIVE", [CACHE_INCLUSIVE] = "INCLUSIVE", [CACHE_NINE] = "NINE"
+};
+
+const char * cache_inclusion_name(cache_inclusion_t inclusion){
+    return inclusion >= CACHE_EXCLUSIVE && inclusion <= CACHE_NINE ? inclusion_names[inclusion] : NULL;
+}
+
+
+int cache_inclusion_parse(const char * name, cache_inclusion_t * inclusion){
+
+    M_REQUIRE_NON_NULL(name);
+    M_REQUIRE_NON_NULL(inclusion);
+
+    for (size_t i = 0; i < sizeof(inclusion_names) / sizeof(inclusion_names[0]); ++i) {
+        if (!strcmp(name, inclusion_names[i])) {
+            *inclusion = (cache_inclusion_t) i;
+            return ERR_NONE;
+        }
+    }
+    M_EXIT(ERR_POLICY, "%s: unknown inclusion policy", name);
+}
+
+
+static const char * const prefetch_names[] = {
+    [CACHE_PREFETCH_NONE] = "NONE", [CACHE_PREFETCH_NEXT_LINE] = "NEXT_LINE",
+    [CACHE_PREFETCH_STRIDE] = "STRIDE", [CACHE_PREFETCH_STREAM] = "STREAM"
+};
+
+const char * cache_prefetch_name(cache_prefetch_t prefetch){
+    return prefetch >= CACHE_PREFETCH_NONE && prefetch <= CACHE_PREFETCH_STREAM ? prefetch_names[prefetch] : NULL;
+}
+
+
+int cache_prefetch_parse(const char * name, cache_prefetch_t * prefetch){
+
+    M_REQUIRE_NON_NULL(name);
+    M_REQUIRE_NON_NULL(prefetch);
+
+    for (size_t i = 0; i < sizeof(prefetch_names) / sizeof(prefetch_names[0]); ++i) {
+        if (!strcmp(name, prefetch_names[i])) {
+            *prefetch = (cache_prefetch_t) i;
+            return ERR_NONE;
         }
+    }
+    M_EXIT(ERR_POLICY, "%s: unknown prefetcher", name);
+}
 
 
+int cache_config_default(cache_config_t * cfg, cache_t type){
+
+    switch (type) {
+    case L1_ICACHE:
+        return cache_config_init(cfg, type, L1_ICACHE_LINES, L1_ICACHE_WAYS, L1_ICACHE_LINE, LRU);
+    case L1_DCACHE:
+        return cache_config_init(cfg, type, L1_DCACHE_LINES, L1_DCACHE_WAYS, L1_DCACHE_LINE, LRU);
+    case L2_CACHE:
+        return cache_config_init(cfg, type, L2_CACHE_LINES, L2_CACHE_WAYS, L2_CACHE_LINE, LRU);
+    case L3_CACHE:
+        return cache_config_init(cfg, type, L3_CACHE_LINES, L3_CACHE_WAYS, L3_CACHE_LINE, LRU);
+    default:
+        debug_print("%d: unknown cache type", type);
+        return ERR_BAD_PARAMETER;
+    }
+}
+
+
+size_t cache_size(const cache_config_t * cfg){
+
+    if (cfg == NULL) return 0;
+
+    return cfg->epoch_offset + sizeof(uint64_t) + (size_t) cfg->sets * sizeof(uint32_t);
+}
+
+
+int cache_entry_init(const void * mem_space,
+                     const phy_addr_t * paddr,
+                     void * cache_entry,
+                     const cache_config_t * cfg){
 
-// ######################################################## CACHE_INSERT MACRO #############################################################
+    M_REQUIRE_NON_NULL(cache_entry);
+    M_REQUIRE_NON_NULL(mem_space);
+    M_REQUIRE_NON_NULL(paddr);
+    M_REQUIRE_NON_NULL(cfg);
 
-#define insert_cache(TYPE, CACHE_LINES, CACHE_WAYS, WORDS_PER_LINE) \
-    TYPE* var = (TYPE*) cache_line_in; \
-        M_REQUIRE(cache_line_index < CACHE_LINES, ERR_BAD_PARAMETER,%s, "bad line index"); \
-        M_REQUIRE(cache_way < CACHE_WAYS, ERR_BAD_PARAMETER,%s, "bad cache way"); \
-        \
-        /*SETTING CACHE LINE ENTRIES*/ \
-        M_REQUIRE_NON_NULL(memcpy(cache_line(TYPE, CACHE_WAYS, cache_line_index, cache_way), (*var).line, WORDS_PER_LINE*sizeof(word_t))); \
-        cache_age(TYPE, CACHE_WAYS, cache_line_index, cache_way) = (*var).age; \
-        cache_valid(TYPE, CACHE_WAYS, cache_line_index, cache_way) = (*var).v; \
-        cache_tag(TYPE, CACHE_WAYS, cache_line_index, cache_way) = (*var).tag;
+    uint32_t phy = phy_to_uint32(*paddr);
 
+    cache_entry_t * entry = cache_entry;
+    entry->v = 1;
+    entry->tag = cache_tag_of(cfg, phy);
+    entry->age = 0;
+    entry->dirty = 0;
+    entry->mesi = MESI_INVALID;
+    memcpy(entry->line, (const uint8_t *) mem_space + cache_line_addr(cfg, phy), cfg->line_bytes);
 
+    return ERR_NONE;
+}
 
-// ######################################################## CACHE_HIT MACRO #############################################################
 
-#define hit_cache(TYPE, CACHE_LINES, CACHE_WAYS, TAG_REMAINING_BITS) \
-    line_index = (phy/16) % CACHE_LINES; \
-    tag = phy >> TAG_REMAINING_BITS; \
-    cache = (TYPE*) cache; \
-    /*LOOP OVER CACHE WAYS*/ \
-    foreach_way(ways, CACHE_WAYS){ \
-        /*CHECK IF THE LINE IS VALID*/ \
-        if (cache_valid(TYPE, CACHE_WAYS, line_index, ways) == 0){ \
-            *hit_way = HIT_WAY_MISS; \
-            *hit_index = HIT_INDEX_MISS; \
-            return ERR_NONE; \
-        } \
-        /*CHECK IF NOT VALID BUT TAG CORRESPONDS*/ \
-        if (cache_valid(TYPE, CACHE_WAYS, line_index, ways) && tag == cache_tag(TYPE, CACHE_WAYS, line_index, ways)){ \
-            *hit_way = ways; \
-            *hit_index = line_index; \
-            *p_line = cache_line(TYPE, CACHE_WAYS,  *hit_index, *hit_way ); \
-            LRU_age_update(TYPE, CACHE_WAYS, *hit_way, *hit_index); \
-            return ERR_NONE; \
-        } \
-    } \
-            *hit_way = HIT_WAY_MISS; \
-            *hit_index = HIT_INDEX_MISS;
-
-
-
-// ######################################################## CACHE_READ MACRO #############################################################
-
-// Macro for cache_read, case hit in L2 and insert in L1
-#define cache_read_L2(TYPE, CACHE_WAYS, CACHE_LINES) \
-        \
-        /*CREATE L1 ENTRY TO INSERT*/ \
-        TYPE *  entry = malloc(sizeof(TYPE)); \
-        M_REQUIRE_NON_NULL(entry);\
-        entry->tag = tag_l1; \
-        M_REQUIRE(transfer_to_l1(l2_cache, entry, cache_type , hit_way, hit_index) == 0, ERR_BAD_PARAMETER, %s,"error in transfer_to_l1"); \
-        cache_valid(l2_cache_entry_t, L2_CACHE_LINES, hit_index, hit_way) = 0; \
-        uint8_t way_find = invalid_way(l1_cache, cache_type, line_index_l1); \
-        \
-        /*CASE THERE IS AN AVAILABLE LINE (INVALID) IN CACHE*/ \
-        if(way_find != HIT_WAY_MISS){ \
-                M_REQUIRE(cache_insert(line_index_l1, way_find, entry, l1_cache, cache_type) == ERR_NONE, ERR_BAD_PARAMETER, %s, " error in cache_insert"); \
-                LRU_age_increase(TYPE, CACHE_WAYS, way_find, line_index_l1); \
-        } \
-        \
-        /*CASE THERE IS NO PLACE, REMOVE OLDEST FROM L1 TO PUT IN L2 AND INSERT NEWEST IN L1*/ \
-        else {\
-            \
-            /*FIND THE WAY OF THE "OLDEST" (HIGHEST AGE)*/ \
-            uint8_t way_delete = LRU_way(l1_cache, cache_type, line_index_l1); \
-            TYPE entry_delete = *cache_entry(TYPE, CACHE_LINES, line_index_l1, way_delete); \
-            \
-            /*INSERT NEW ENTRY IN L1 AND UPDATE AGE*/ \
-            M_REQUIRE(cache_insert(line_index_l1, way_delete, entry, l1_cache, cache_type) == ERR_NONE, ERR_BAD_PARAMETER, %s, "error in cache_insert"); \
-            LRU_age_update(TYPE, CACHE_WAYS, way_delete, line_index_l1); \
-            \
-            /*FIND A WAY IN L2 TO INSERT DETLETED ENTRY*/ \
-            uint8_t way_in_l2 = invalid_way(l2_cache, L2_CACHE, hit_index); \
-            /*UPDATE WORD TO READ*/ \
-            *word = cache_line(TYPE, CACHE_WAYS, line_index_l1, way_delete)[w_select]; \
-            cache = l2_cache; \
-            \
-            /*CASE THERE IS AVAILABLE PLACE IN L2*/ \
-            if (way_in_l2 != HIT_WAY_MISS) { \
-                cache_insert(hit_index, way_in_l2, &entry_delete, l2_cache, L2_CACHE ); \
-                LRU_age_increase(l2_cache_entry_t, L2_CACHE_WAYS, way_in_l2, hit_index ); \
-            } \
-            /*CASE THERE IS NO PLACE IN L2, DELETE OLDEST ENTRY AND INSERT NEW ONE*/ \
-            else { \
-                uint8_t way_evicted = LRU_way(l2_cache, L2_CACHE, hit_index); \
-                M_REQUIRE(cache_insert(hit_index, way_evicted, &entry_delete, l2_cache, L2_CACHE ) == ERR_NONE, ERR_BAD_PARAMETER, %s, " error in cache_insert"); \
-                LRU_age_update(l2_cache_entry_t, L2_CACHE_WAYS, way_evicted, hit_index); \
-            } \
-        } 
 
+int cache_flush(void *cache, const cache_config_t * cfg){
 
+    M_REQUIRE_NON_NULL(cache);
+    M_REQUIRE_NON_NULL(cfg);
 
-// Macro for cache_read, case miss in L1 and in L2, writeback in L1
-#define cache_read_memory(TYPE, CACHE_WAYS) \
-        TYPE* entry = malloc(sizeof(TYPE)); \
-        M_REQUIRE_NON_NULL(entry); \
-        /* FETCH FROM MEMORY*/ \
-        M_REQUIRE(cache_entry_init(mem_space, paddr, entry, cache_type) == ERR_NONE, ERR_BAD_PARAMETER, %s, " error in cache_entry_init"); \
-        \
-        /* WRITEBACK IN L1*/ \
-        uint8_t way_find = invalid_way(l1_cache, cache_type, line_index_l1); \
-        if (way_find == HIT_WAY_MISS) { \
-             way_find = LRU_way(l1_cache, cache_type, line_index_l1); \
-        } \
-        \
-        M_REQUIRE(cache_insert(line_index_l1, way_find, entry, l1_cache, cache_type ) == ERR_NONE, ERR_BAD_PARAMETER, %s, " error in cache_insert"); \
-        /*UPDATE AGE*/ \
-        LRU_age_update(TYPE, CACHE_WAYS, way_find, line_index_l1); \
-        \
-        *word = cache_line(TYPE, CACHE_WAYS, line_index_l1, way_find)[w_select]; 
+    /*A NEW EPOCH: THE SETS ARE EMPTIED WHEN NEXT USED (SEE cache_set_refresh())*/
+    if (++cache_epoch(cfg, cache) == 0) {
+        //CASE THE EPOCH WRAPS AROUND: A SET LEFT SINCE THEN WOULD LOOK CURRENT, SO ALL ARE EMPTIED NOW
+        memset(cache, 0, cfg->stats_offset);
+        memset((char *) cache + cfg->prefetch_offset, 0, cache_size(cfg) - cfg->prefetch_offset);
+        return ERR_NONE;
+    }
 
+    /*SETTING THE PREFETCHER TICK AND TABLE, THE WAY MEMO AND THE MSHRS TO 0 (THE STATISTICS ARE KEPT)*/
+    if (cfg->prefetch != CACHE_PREFETCH_NONE)
+        memset((char *) cache + cfg->prefetch_offset, 0, cfg->stamps_offset - cfg->prefetch_offset);
+    if (cfg->way_prediction) memset(cache_way_memo(cfg, cache), 0, sizeof(cache_way_memo_t));
+    memset(cache_mshrs(cfg, cache), 0, (size_t) cfg->mshrs * sizeof(cache_mshr_t));
 
+    return ERR_NONE;
+}
 
 
-// ########################################################## FUNCTIONS ###################################################################
-/*
-    FUNCTION BEHAVIOUR COMMENTS IN MACROS
-*/
 
+int cache_writeback(void * mem_space, void * cache, const cache_config_t * cfg){
 
-int cache_entry_init(const void * mem_space,
-                     const phy_addr_t * paddr,
-                     void * cache_entry,
-                     cache_t cache_type){
-
-        M_REQUIRE_NON_NULL(cache_entry);
-        M_REQUIRE_NON_NULL(mem_space);
-        M_REQUIRE_NON_NULL(paddr);
-                         
-                         
-        uint32_t phy = phy_to_uint32(*paddr);
-
-        
-        if(cache_type == L1_DCACHE){
-            init_cache(l1_dcache_entry_t, L1_DCACHE_TAG_REMAINING_BITS, L1_DCACHE_WORDS_PER_LINE);
-        } else if(cache_type == L1_ICACHE){
-            init_cache(l1_icache_entry_t, L1_ICACHE_TAG_REMAINING_BITS, L1_ICACHE_WORDS_PER_LINE);
-        } else if(cache_type == L2_CACHE){
-            init_cache(l2_cache_entry_t, L2_CACHE_TAG_REMAINING_BITS, L2_CACHE_WORDS_PER_LINE);
-        } else{
-            return ERR_BAD_PARAMETER;
+    M_REQUIRE_NON_NULL(mem_space);
+    M_REQUIRE_NON_NULL(cache);
+    M_REQUIRE_NON_NULL(cfg);
+
+    for (uint16_t index = 0; index < cfg->sets; index++) {
+        if (!cache_set_current(cfg, cache, index)) continue;
+        foreach_way(way, cfg->ways) {
+            if (cache_valid(cfg, cache, index, way) && cache_dirty(cfg, cache, index, way)) {
+                memcpy((uint8_t *) mem_space + cache_way_addr(cfg, cache, index, way),
+                       cache_line(cfg, cache, index, way), cfg->line_bytes);
+                cache_stats(cfg, cache)->memory_writes++;
+                cache_dirty(cfg, cache, index, way) = 0;
+            }
         }
-                         
+    }
 
     return ERR_NONE;
 }
 
 
 
-int cache_flush(void *cache, cache_t cache_type){
-
-    M_REQUIRE_NON_NULL(cache);
-
-        if(cache_type == L1_DCACHE){
-            flush_cache(l1_dcache_entry_t, L1_DCACHE_LINES, L1_DCACHE_WAYS, L1_DCACHE_WORDS_PER_LINE);
-        } else if(cache_type == L1_ICACHE){
-            flush_cache(l1_icache_entry_t, L1_ICACHE_LINES, L1_ICACHE_WAYS, L1_ICACHE_WORDS_PER_LINE);
-        } else if(cache_type == L2_CACHE){
-            flush_cache(l2_cache_entry_t, L2_CACHE_LINES, L2_CACHE_WAYS, L2_CACHE_WORDS_PER_LINE);
-        } else{
-            return ERR_BAD_PARAMETER;
+int cache_sim_writeback(const cache_sim_t * sim){
+
+    M_REQUIRE_NON_NULL(sim);
+    M_REQUIRE_NON_NULL(sim->mem_space);
+    M_REQUIRE_NON_NULL(sim->l2_cache);
+    M_REQUIRE_NON_NULL(sim->l2_cfg);
+
+    // FROM THE TOP DOWN, SO THAT THE NEWEST COPIES GO DOWN FIRST
+    void * const caches[] = { sim->l1_icache, sim->l1_dcache, sim->l2_cache, sim->l3_cache };
+    const cache_config_t * const cfgs[] = { sim->l1_icfg, sim->l1_dcfg, sim->l2_cfg, sim->l3_cfg };
+    for (size_t level = 0; level < sizeof(caches) / sizeof(caches[0]); ++level) {
+        void * cache = caches[level];
+        const cache_config_t * cfg = cfgs[level];
+        if (cache == NULL) continue;
+        M_REQUIRE_NON_NULL(cfg);
+        for (uint16_t index = 0; index < cfg->sets; index++) {
+            if (!cache_set_current(cfg, cache, index)) continue;
+            foreach_way(way, cfg->ways) {
+                if (cache_valid(cfg, cache, index, way) && cache_dirty(cfg, cache, index, way)) {
+                    cache_write_line_down(sim, cache, cfg, index, way);
+                    cache_dirty(cfg, cache, index, way) = 0;
+                }
+            }
         }
-                         
-   
+    }
+
     return ERR_NONE;
 }
 
@@ -405,22 +1503,30 @@ int cache_insert(uint16_t cache_line_index,
                  uint8_t cache_way,
                  const void * cache_line_in,
                  void * cache,
-                 cache_t cache_type){
-
+                 const cache_config_t * cfg){
 
     M_REQUIRE_NON_NULL(cache);
     M_REQUIRE_NON_NULL(cache_line_in);
-
-        if(cache_type == L1_DCACHE){
-            insert_cache(l1_dcache_entry_t, L1_DCACHE_LINES, L1_DCACHE_WAYS, L1_DCACHE_WORDS_PER_LINE);
-        } else if(cache_type == L1_ICACHE){
-            insert_cache(l1_icache_entry_t, L1_ICACHE_LINES, L1_ICACHE_WAYS, L1_ICACHE_WORDS_PER_LINE);
-        } else if(cache_type == L2_CACHE){
-            insert_cache(l2_cache_entry_t, L2_CACHE_LINES, L2_CACHE_WAYS, L2_CACHE_WORDS_PER_LINE);
-        } else{
-            return ERR_BAD_PARAMETER;
-        }
-
+    M_REQUIRE_NON_NULL(cfg);
+    M_REQUIRE(cache_line_index < cfg->sets, ERR_BAD_PARAMETER, "%s", "bad line index");
+    M_REQUIRE(cache_way < cfg->ways, ERR_BAD_PARAMETER, "%s", "bad cache way");
+
+    /*SETTING CACHE LINE ENTRIES*/
+    const cache_entry_t * in = cache_line_in;
+    cache_set_refresh(cache, cfg, cache_line_index);
+    cache_valid(cfg, cache, cache_line_index, cache_way) = in->v;
+    if (cfg->age_bits) {
+        uint64_t * ages = &cache_set_state(cfg, cache, cache_line_index);
+        const uint64_t field = ((uint64_t) 1 << cfg->age_bits) - 1;
+        *ages = (*ages & ~(field << (cache_way * cfg->age_bits)))
+                | ((uint64_t) (in->age & field) << (cache_way * cfg->age_bits));
+    } else {
+        cache_age(cfg, cache, cache_line_index, cache_way) = in->age;
+    }
+    cache_tag(cfg, cache, cache_line_index, cache_way) = in->tag;
+    cache_dirty(cfg, cache, cache_line_index, cache_way) = in->dirty;
+    cache_mesi(cfg, cache, cache_line_index, cache_way) = in->mesi;
+    memcpy(cache_line(cfg, cache, cache_line_index, cache_way), in->line, cfg->line_bytes);
 
     return ERR_NONE;
 }
@@ -430,14 +1536,15 @@ int cache_insert(uint16_t cache_line_index,
 
 int cache_hit (const void * mem_space,
                void * cache,
+               const cache_config_t * cfg,
                phy_addr_t * paddr,
                const uint32_t ** p_line,
                uint8_t *hit_way,
-               uint16_t *hit_index,
-               cache_t cache_type){
+               uint16_t *hit_index){
 
 
     M_REQUIRE_NON_NULL(cache);
+    M_REQUIRE_NON_NULL(cfg);
     M_REQUIRE_NON_NULL(mem_space);
     M_REQUIRE_NON_NULL(paddr);
     M_REQUIRE_NON_NULL(p_line);
@@ -446,102 +1553,501 @@ int cache_hit (const void * mem_space,
 
 
     uint32_t phy = phy_to_uint32(*paddr);
-    uint32_t line_index;
-    uint32_t tag;
-
-    if(cache_type == L1_DCACHE){
-        hit_cache(l1_dcache_entry_t, L1_DCACHE_LINES, L1_DCACHE_WAYS, L1_DCACHE_TAG_REMAINING_BITS);
-    } else if(cache_type == L1_ICACHE){
-        hit_cache(l1_icache_entry_t, L1_ICACHE_LINES, L1_ICACHE_WAYS, L1_ICACHE_TAG_REMAINING_BITS);
-    } else if(cache_type == L2_CACHE){
-        hit_cache(l2_cache_entry_t, L2_CACHE_LINES, L2_CACHE_WAYS, L2_CACHE_TAG_REMAINING_BITS);
+
+    cache_set_refresh(cache, cfg, cache_line_index(cfg, phy));
+    *hit_way = cfg->kernels.probe(cache, cfg, phy);
+    if (*hit_way == HIT_WAY_MISS) {
+        *hit_index = HIT_INDEX_MISS;
     } else {
-        return ERR_BAD_PARAMETER;
+        *hit_index = cache_line_index(cfg, phy);
+        *p_line = cache_line(cfg, cache, *hit_index, *hit_way);
     }
 
     return ERR_NONE;
 }
 
 
-int cache_read(const void * mem_space,
-               phy_addr_t * paddr,
-               mem_access_t access,
-               void * l1_cache,
-               void * l2_cache,
-               uint32_t * word,
-               cache_replace_t replace) {
+/*
+ * Timing of the accesses (see the latency model in cache.h). The path of an access is
+ * L1 (I or D), L2 and L3 if there is one, then memory; without a core clock an access
+ * costs the hit latencies down to the level holding the line, with one its misses
+ * overlap those of the accesses around it, as far as the MSHRs of each level allow.
+ */
 
-    M_REQUIRE_NON_NULL(mem_space);
-    M_REQUIRE_NON_NULL(paddr);
-    M_REQUIRE_NON_NULL(l1_cache);
-    M_REQUIRE_NON_NULL(l2_cache);
-    M_REQUIRE_NON_NULL(word);
+// Levels on the path of an access through L1_CACHE, from the top down; returns their
+// number, which stands for memory when a level on the path is given by its index
+static inline uint8_t cache_path_levels(const cache_sim_t * s, void * l1_cache, const cache_config_t * l1_cfg,
+                                        void ** caches, const cache_config_t ** cfgs)
+{
+    caches[0] = l1_cache;
+    cfgs[0] = l1_cfg;
+    caches[1] = s->l2_cache;
+    cfgs[1] = s->l2_cfg;
+    if (s->l3_cache == NULL) return 2;
+    caches[2] = s->l3_cache;
+    cfgs[2] = s->l3_cfg;
+    return 3;
+}
 
-    uint32_t addr = phy_to_uint32(*paddr);
+// Latency of looking the path up from level FIRST to level SERVED, which holds the line
+// (N: memory, behind the last level), when nothing overlaps
+static inline uint32_t cache_path_cycles(const cache_config_t * const * cfgs, uint8_t n,
+                                         uint8_t first, uint8_t served)
+{
+    uint32_t cycles = 0;
+    for (uint8_t k = first; k <= served && k < n; ++k) cycles += cfgs[k]->hit_latency;
+    if (served == n) cycles += cfgs[n - 1]->memory_latency;
+    return cycles;
+}
 
-    //M_REQUIRE(paddr->page_offset % (sizeof(word_t) * WORDS_PER_LINE ) == 0, ERR_BAD_PARAMETER, " ");
-    
-    const uint32_t * p_line_inl1 = calloc(L1_ICACHE_WORDS_PER_LINE, sizeof(word_t));
-    M_REQUIRE_NON_NULL(p_line_inl1);
-    uint8_t w_select = (addr >> 2)& 0b11;
+// MSHR of a level tracking LINE in flight at cycle NOW, NULL if there is none
+static inline const cache_mshr_t * cache_mshr_find(void * cache, const cache_config_t * cfg,
+                                                   uint32_t line, uint64_t now)
+{
+    const cache_mshr_t * mshrs = cache_mshrs(cfg, cache);
+    for (uint8_t i = 0; i < cfg->mshrs; ++i) {
+        if (mshrs[i].ready > now && mshrs[i].line == line) return &mshrs[i];
+    }
+    return NULL;
+}
 
-    uint8_t hit_way = 0 ;
-    uint16_t hit_index = 0;
-    cache_t cache_type = access == INSTRUCTION ? L1_ICACHE : L1_DCACHE;
+// MSHR of a level that is free first (already, if its line has arrived)
+static inline cache_mshr_t * cache_mshr_first_free(void * cache, const cache_config_t * cfg)
+{
+    cache_mshr_t * mshrs = cache_mshrs(cfg, cache);
+    cache_mshr_t * first = &mshrs[0];
+    for (uint8_t i = 1; i < cfg->mshrs; ++i) {
+        if (mshrs[i].ready < first->ready) first = &mshrs[i];
+    }
+    return first;
+}
+
+// Time an access to the line at addr from level FIRST of the path down to level SERVED,
+// which holds the line (see cache_path_levels()), issued at the cycle of the core clock.
+// Each level missed takes an MSHR until the line arrives, unless the line is in flight
+// there already (a secondary miss); a demand access (DEMAND) that finds the L1 MSHRs all
+// busy holds the issue of the core, a prefetch just waits. Returns the completion cycle.
+static uint64_t cache_timing_access(const cache_sim_t * s, void * const * caches,
+                                    const cache_config_t * const * cfgs, uint8_t n,
+                                    uint8_t first, uint8_t served, uint32_t addr, int demand)
+{
+    cache_timing_t * timing = s->timing;
+    const uint32_t line = addr >> cfgs[first]->offset_bits;
+    cache_mshr_t * taken[3];
+    uint8_t nb_taken = 0;
+    uint64_t t = timing->now;
+    uint64_t miss_start = 0;
+    uint64_t done = 0;
+
+    for (uint8_t k = first; ; ++k) {
+        //PAST THE LAST LEVEL: MEMORY
+        if (k == n) {
+            done = t + cfgs[n - 1]->memory_latency;
+            break;
+        }
+
+        t += cfgs[k]->hit_latency;
+        const cache_mshr_t * in_flight = cache_mshr_find(caches[k], cfgs[k], line, t);
+        if (in_flight != NULL) {
+            cache_stats(cfgs[k], caches[k])->mshr_merges++;
+            done = in_flight->ready;
+            break;
+        }
+        if (k == served) {
+            done = t;
+            break;
+        }
 
-    void * cache = l1_cache;
-    M_REQUIRE(cache_hit(mem_space, l1_cache, paddr, &p_line_inl1, &hit_way, &hit_index, cache_type) == ERR_NONE, ERR_BAD_PARAMETER, %s," error in cache_hit");
+        //A PRIMARY MISS TAKES THE FIRST MSHR TO BE FREE, WAITING FOR IT IF NEEDED
+        cache_mshr_t * mshr = cache_mshr_first_free(caches[k], cfgs[k]);
+        if (mshr->ready > t) {
+            const uint64_t wait = mshr->ready - t;
+            cache_stats(cfgs[k], caches[k])->mshr_full_cycles += wait;
+            if (demand && k == 0) {
+                timing->mshr_stalls += wait;
+                timing->now += wait;
+            }
+            t = mshr->ready;
+        }
+        mshr->line = line;
+        taken[nb_taken++] = mshr;
+        if (k == first) miss_start = t;
+    }
+    for (uint8_t i = 0; i < nb_taken; ++i) taken[i]->ready = done;
+
+    //MLP: THE L1 DEMAND MISSES IN FLIGHT, OVER THE CYCLES WITH AT LEAST ONE
+    if (demand) {
+        if (nb_taken > 0 && first == 0) {
+            timing->miss_cycles += done - miss_start;
+            if (done > timing->miss_busy_until) {
+                timing->miss_busy += done - (miss_start > timing->miss_busy_until ? miss_start : timing->miss_busy_until);
+                timing->miss_busy_until = done;
+            }
+        }
+        if (done > timing->end) timing->end = done;
+    }
+    return done;
+}
 
-    // ############################### CASE FIND THE VALUE IN L1 ############################################
-    if (hit_way != HIT_WAY_MISS) {
-        if (cache_type == L1_DCACHE){
-             *word = cache_line(l1_dcache_entry_t, L1_DCACHE_WAYS, hit_index, hit_way)[w_select];
+// Prefetchers to train once a demand access is over (see cache_prefetch())
+#define CACHE_TRAIN_L1 1
+#define CACHE_TRAIN_L2 2
+
+// Bring the line of addr, missing in L1 (I or D), from L2, L3 or memory. On return, *p_hit_way
+// locates it in L1; *p_train tells whether the L2 prefetcher trains on the L2 access.
+// Returns the level of the path that held the line (see cache_path_levels()).
+static inline uint8_t cache_l1_miss(const cache_sim_t * s,
+                                 uint32_t addr,
+                                 int write,
+                                 void * l1_cache,
+                                 const cache_config_t * l1_cfg,
+                                 uint8_t * p_hit_way,
+                                 uint8_t * p_train)
+{
+    const cache_config_t * l2_cfg = s->l2_cfg;
+    const uint32_t tag_l1 = cache_tag_of(l1_cfg, addr);
+    const uint16_t line_index_l1 = cache_line_index(l1_cfg, addr);
+    const uint16_t line_index_l2 = cache_line_index(l2_cfg, addr);
+
+    //CHECK IF DATA IN L2
+    const uint8_t way_l2 = cache_probe(s->l2_cache, l2_cfg, addr, NULL);
+    cache_stats_t * l2_stats = cache_stats(l2_cfg, s->l2_cache);
+    STATS_COUNT_PROBE(l2_stats, write, way_l2 == HIT_WAY_MISS);
+    if (l2_cfg->prefetch != CACHE_PREFETCH_NONE
+        && cache_prefetch_demand(s->l2_cache, l2_cfg, line_index_l2, way_l2))
+        *p_train |= CACHE_TRAIN_L2;
+
+    //HIT IN L2: THE LINE IS COPIED OUT FIRST, SINCE THE L1 VICTIM MAY TAKE ITS PLACE IN L2.
+    //EXCLUSIVE POLICY: IT MOVES TO L1 WITH ITS DIRTY BIT. OTHERWISE L2 KEEPS IT AND L1 GETS A CLEAN COPY
+    if (way_l2 != HIT_WAY_MISS) {
+        word_t line[CACHE_MAX_WORDS_PER_LINE];
+        memcpy(line, cache_line(l2_cfg, s->l2_cache, line_index_l2, way_l2), l1_cfg->line_bytes);
+        uint8_t dirty = 0;
+        const uint8_t mesi = cache_mesi(l2_cfg, s->l2_cache, line_index_l2, way_l2);
+        if (l2_cfg->inclusion == CACHE_EXCLUSIVE) {
+            dirty = cache_dirty(l2_cfg, s->l2_cache, line_index_l2, way_l2);
+            cache_valid(l2_cfg, s->l2_cache, line_index_l2, way_l2) = 0;
         }
+        cache_fill_l1(s, l1_cache, l1_cfg, line_index_l1, tag_l1, line, dirty, mesi, p_hit_way);
+        return 1;
+    }
 
-        if (cache_type == L1_ICACHE){
-            *word = cache_line(l1_icache_entry_t, L1_ICACHE_WAYS, hit_index, hit_way)[w_select];
+    // ############################## CASE WE DID NOT FIND THE VALUE IN L2 ##################################
+    //THE LINE COMES FROM L3 OR MEMORY, ONCE THE OTHER CORES (IF ANY) HAVE BEEN SNOOPED.
+    //EXCLUSIVE POLICY: IT GOES TO L1 ONLY. OTHERWISE TO BOTH, L2 FIRST SO THAT ITS
+    //VICTIM IS BACK-INVALIDATED BEFORE L1 PICKS ITS OWN
+    else {
+        word_t buf[CACHE_MAX_WORDS_PER_LINE];
+        const word_t * line = NULL;
+        uint8_t dirty = 0;
+        const uint8_t mesi = s->cores != NULL ? cache_snoop(s, addr, write) : MESI_INVALID;
+        const int from_memory = cache_fetch_below_l2(s, addr, write, buf, &line, &dirty);
+        if (l2_cfg->inclusion != CACHE_EXCLUSIVE) {
+            const uint8_t way = cache_l2_make_room(s, line_index_l2);
+            cache_install(s, s->l2_cache, l2_cfg, line_index_l2, way, cache_tag_of(l2_cfg, addr), line, dirty, mesi);
+            if (from_memory) l2_stats->memory_fills++;
+            dirty = 0;
         }
+        if (from_memory) cache_stats(l1_cfg, l1_cache)->memory_fills++;
+        cache_fill_l1(s, l1_cache, l1_cfg, line_index_l1, tag_l1, line, dirty, mesi, p_hit_way);
+
+        //FROM L3 (IF ANY), ELSE FROM MEMORY PAST THE LAST LEVEL
+        return (uint8_t) (from_memory && s->l3_cache != NULL ? 3 : 2);
     }
+}
+
+// Histogram bucket of a latency (see CACHE_LATENCY_BUCKETS)
+static inline uint8_t cache_latency_bucket(uint32_t cycles)
+{
+    const uint8_t bucket = cycles ? (uint8_t) (31 - __builtin_clz(cycles)) : 0;
+    return bucket < CACHE_LATENCY_BUCKETS ? bucket : CACHE_LATENCY_BUCKETS - 1;
+}
+
+// Find the line of addr in L1 (I or D), bringing it from L2, L3 or memory if needed,
+// and count the access as a read or a write, with its latency. On return, hit_way/hit_index
+// locate the line in L1, and *p_train tells which prefetchers train on the access (CACHE_TRAIN_*).
+static inline void cache_l1_lookup(const cache_sim_t * s,
+                                   uint32_t addr,
+                                   int write,
+                                   void * l1_cache,
+                                   const cache_config_t * l1_cfg,
+                                   uint8_t * p_hit_way,
+                                   uint16_t * p_hit_index,
+                                   uint8_t * p_train)
+{
+    const uint16_t line_index_l1 = cache_line_index(l1_cfg, addr);
+
+    int mispredicted = 0;
+    uint8_t hit_way = cache_probe(l1_cache, l1_cfg, addr, &mispredicted);
+    cache_stats_t * l1_stats = cache_stats(l1_cfg, l1_cache);
+    const int l1_miss = hit_way == HIT_WAY_MISS;
+    STATS_COUNT_PROBE(l1_stats, write, l1_miss);
+
+    uint8_t train = 0;
+    if (l1_cfg->prefetch != CACHE_PREFETCH_NONE && cache_prefetch_demand(l1_cache, l1_cfg, line_index_l1, hit_way))
+        train = CACHE_TRAIN_L1;
 
     // ############################## CASE WE DID NOT FIND THE VALUE IN L1 ##################################
-    else
-        {
+    uint8_t served = 0;
+    if (l1_miss) {
+        served = cache_l1_miss(s, addr, write, l1_cache, l1_cfg, &hit_way, &train);
+        cache_way_train(l1_cache, l1_cfg, addr, hit_way);
+    }
+
+    //LATENCY, FROM THE ISSUE OF THE ACCESS IF THE CORE HAS A CLOCK
+    void * caches[3];
+    const cache_config_t * cfgs[3];
+    const uint8_t n = cache_path_levels(s, l1_cache, l1_cfg, caches, cfgs);
+    uint32_t cycles = 0;
+    if (s->timing == NULL) {
+        cycles = cache_path_cycles(cfgs, n, 0, served);
+    } else {
+        s->timing->last_done = cache_timing_access(s, caches, cfgs, n, 0, served, addr, 1);
+        cycles = (uint32_t) (s->timing->last_done - s->timing->now);
+    }
+    //A WAY MISPREDICTION COSTS A SECOND LOOKUP OF L1
+    if (mispredicted) {
+        cycles += CACHE_WAY_MISPREDICT_PENALTY;
+        if (s->timing != NULL) s->timing->last_done += CACHE_WAY_MISPREDICT_PENALTY;
+    }
+    l1_stats->cycles += cycles;
+    l1_stats->latency_histogram[cache_latency_bucket(cycles)]++;
 
-            //CHECK IF DATA IN L2
-            M_REQUIRE(cache_hit(mem_space, l2_cache, paddr, &p_line_inl1, &hit_way, &hit_index, L2_CACHE) == 0, ERR_BAD_PARAMETER, %s," error in cache_hit");
+    *p_hit_way = hit_way;
+    *p_hit_index = line_index_l1;
+    *p_train = train;
+}
 
-            int line_index_l1 = (addr >> INDEX_OFFSET) & INDEX_L1_MASK;
-            int tag_l1 = addr >> L1_ICACHE_TAG_REMAINING_BITS;
+// Prefetch the line at addr into L1 DCACHE, as a read miss of it would bring it
+// (not counted as an access of L1, but of the levels below)
+static void cache_prefetch_l1(const cache_sim_t * s, uint32_t addr)
+{
+    void * l1_cache = s->l1_dcache;
+    const cache_config_t * l1_cfg = s->l1_dcfg;
+    if (cache_find_way(l1_cache, l1_cfg, addr) != HIT_WAY_MISS) return;
 
-            //HIT IN L2
-            if (hit_way != HIT_WAY_MISS) {
+    uint8_t way = 0;
+    uint8_t train = 0; // PREFETCHES DO NOT TRAIN
+    const uint8_t served = cache_l1_miss(s, addr, 0, l1_cache, l1_cfg, &way, &train);
+    cache_prefetch_mark(l1_cache, l1_cfg, cache_line_index(l1_cfg, addr), way);
+
+    if (s->timing != NULL) {
+        void * caches[3];
+        const cache_config_t * cfgs[3];
+        const uint8_t n = cache_path_levels(s, l1_cache, l1_cfg, caches, cfgs);
+        cache_timing_access(s, caches, cfgs, n, 0, served, addr, 0);
+    }
+}
 
+// Prefetch the line at addr into L2, from L3 or memory, unless the core already holds it
+static void cache_prefetch_l2(const cache_sim_t * s, uint32_t addr)
+{
+    const cache_config_t * l2_cfg = s->l2_cfg;
+    if (cache_find_way(s->l2_cache, l2_cfg, addr) != HIT_WAY_MISS
+        || (s->l1_icache != NULL && cache_find_way(s->l1_icache, s->l1_icfg, addr) != HIT_WAY_MISS)
+        || (s->l1_dcache != NULL && cache_find_way(s->l1_dcache, s->l1_dcfg, addr) != HIT_WAY_MISS))
+        return;
+
+    word_t buf[CACHE_MAX_WORDS_PER_LINE];
+    const word_t * line = NULL;
+    uint8_t dirty = 0;
+    const uint8_t mesi = s->cores != NULL ? cache_snoop(s, addr, 0) : MESI_INVALID;
+    const int from_memory = cache_fetch_below_l2(s, addr, 0, buf, &line, &dirty);
+
+    const uint16_t line_index = cache_line_index(l2_cfg, addr);
+    const uint8_t way = cache_l2_make_room(s, line_index);
+    cache_install(s, s->l2_cache, l2_cfg, line_index, way, cache_tag_of(l2_cfg, addr), line, dirty, mesi);
+    if (from_memory) cache_stats(l2_cfg, s->l2_cache)->memory_fills++;
+    cache_prefetch_mark(s->l2_cache, l2_cfg, line_index, way);
+
+    if (s->timing != NULL) {
+        void * caches[3];
+        const cache_config_t * cfgs[3];
+        const uint8_t n = cache_path_levels(s, s->l1_dcache, s->l1_dcfg, caches, cfgs);
+        cache_timing_access(s, caches, cfgs, n, 1, (uint8_t) (from_memory ? n : 2), addr, 0);
+    }
+}
 
-                if (cache_type == L1_ICACHE){
-                    cache_read_L2(l1_icache_entry_t, L1_ICACHE_WAYS, L1_ICACHE_LINES);
-                }
-                
-                if (cache_type == L1_DCACHE) {
-                    cache_read_L2(l1_dcache_entry_t, L1_DCACHE_WAYS, L1_DCACHE_LINES);
-                }
-            }
+// Once a demand access to addr is over, the prefetchers it trains (TRAIN: CACHE_TRAIN_*)
+// bring their lines in
+static void cache_prefetch(const cache_sim_t * s, uint32_t addr, uint8_t train)
+{
+    uint32_t lines[CACHE_PREFETCH_MAX_DEGREE];
 
-    // ############################## CASE WE DID NOT FIND THE VALUE IN L2 ##################################
-            else {
+    if (train & CACHE_TRAIN_L1) {
+        const uint8_t n = cache_prefetch_train(s->l1_dcache, s->l1_dcfg, addr, lines);
+        for (uint8_t i = 0; i < n; ++i) cache_prefetch_l1(s, lines[i]);
+    }
+    if (train & CACHE_TRAIN_L2) {
+        const uint8_t n = cache_prefetch_train(s->l2_cache, s->l2_cfg, addr, lines);
+        for (uint8_t i = 0; i < n; ++i) cache_prefetch_l2(s, lines[i]);
+    }
+}
 
-                if (cache_type == L1_ICACHE) {
 
-                    cache_read_memory(l1_icache_entry_t, L1_ICACHE_WAYS);
+// The accesses themselves, once the arguments have been checked (by cache_read and
+// friends for a single access, once per batch by cache_access_batch)
+static inline word_t cache_read_word_at(const cache_sim_t * s, uint32_t addr,
+                                        void * l1_cache, const cache_config_t * l1_cfg)
+{
+    uint8_t hit_way = 0;
+    uint16_t hit_index = 0;
+    uint8_t train = 0;
+    cache_l1_lookup(s, addr, 0, l1_cache, l1_cfg, &hit_way, &hit_index, &train);
 
-                }
+    const word_t word = cache_line(l1_cfg, l1_cache, hit_index, hit_way)[cache_word_select(l1_cfg, addr)];
+    if (train) cache_prefetch(s, addr, train);
+    return word;
+}
+
+// The n bytes at addr, all in its line, copied straight out of the L1 line
+static inline void cache_read_span_at(const cache_sim_t * s, uint32_t addr,
+                                      void * l1_cache, const cache_config_t * l1_cfg,
+                                      uint8_t * dst, size_t n)
+{
+    uint8_t hit_way = 0;
+    uint16_t hit_index = 0;
+    uint8_t train = 0;
+    cache_l1_lookup(s, addr, 0, l1_cache, l1_cfg, &hit_way, &hit_index, &train);
 
-                if (cache_type == L1_DCACHE) {
+    const uint8_t * line = (const uint8_t *) cache_line(l1_cfg, l1_cache, hit_index, hit_way);
+    memcpy(dst, line + (addr & (l1_cfg->line_bytes - 1u)), n);
+    if (train) cache_prefetch(s, addr, train);
+}
 
-                    cache_read_memory(l1_dcache_entry_t, L1_DCACHE_WAYS);
-                        
-                }
-            }
+static inline uint8_t cache_read_byte_at(const cache_sim_t * s, uint32_t addr,
+                                         void * l1_cache, const cache_config_t * l1_cfg)
+{
+    // RETURN CORRESPONDING BYTE IN THE CORRESPONDING WORD
+    const word_t word = cache_read_word_at(s, addr, l1_cache, l1_cfg);
+    return (word >> ((addr % 4) * BYTE_SIZE)) & BYTE_MAX;
+}
+
+// The n bytes at addr, all in its line, copied straight into the L1 line
+static inline void cache_write_span_at(const cache_sim_t * s, uint32_t addr,
+                                       void * l1_cache, const cache_config_t * l1_cfg,
+                                       const void * src, size_t n)
+{
+    // WRITE-ALLOCATE: BRING THE LINE IN L1 (FROM L2 OR MEMORY) IF IT IS NOT THERE YET
+    uint8_t hit_way = 0;
+    uint16_t hit_index = 0;
+    uint8_t train = 0;
+    cache_l1_lookup(s, addr, 1, l1_cache, l1_cfg, &hit_way, &hit_index, &train);
+
+    // MULTI-CORE: THE CORE MUST OWN THE LINE. A SHARED ONE IS UPGRADED FIRST (THE OTHER COPIES
+    // ARE INVALIDATED), THEN ALL THE COPIES OF THE CORE BECOME MODIFIED
+    if (s->cores != NULL) {
+        const uint8_t mesi = cache_mesi(l1_cfg, l1_cache, hit_index, hit_way);
+        if (mesi == MESI_SHARED) {
+            s->coherence->upgrades++;
+            cache_snoop(s, addr, 1);
         }
+        if (mesi != MESI_MODIFIED) cache_core_set_mesi(s, addr, MESI_MODIFIED);
+    }
+
+    // UPDATE THE BYTES IN PLACE
+    word_t * line = cache_line(l1_cfg, l1_cache, hit_index, hit_way);
+    memcpy((uint8_t *) line + (addr & (l1_cfg->line_bytes - 1u)), src, n);
+
+    // WRITE-BACK: THE LINE IS ONLY MARKED DIRTY
+    if (l1_cfg->write_policy == CACHE_WRITE_BACK) {
+        cache_dirty(l1_cfg, l1_cache, hit_index, hit_way) = 1;
+    }
+    // WRITE-THROUGH: COPY THE WHOLE LINE DOWN, TO THE NEAREST COPY BELOW OR MEMORY
+    else {
+        cache_write_down(s, l1_cache, l1_cfg, addr, line);
+    }
+
+    if (train) cache_prefetch(s, addr, train);
+}
+
+static inline void cache_write_word_at(const cache_sim_t * s, uint32_t addr,
+                                       void * l1_cache, const cache_config_t * l1_cfg,
+                                       word_t word)
+{
+    cache_write_span_at(s, addr & ~(uint32_t) (sizeof(word_t) - 1), l1_cache, l1_cfg, &word, sizeof(word_t));
+}
+
+// A range is cut at the lines it crosses, each of them accessed once. Its accesses are
+// issued together: a read is done when the slowest of them is.
+static inline void cache_read_range_at(const cache_sim_t * s, uint32_t addr,
+                                       void * l1_cache, const cache_config_t * l1_cfg,
+                                       uint8_t * dst, size_t n)
+{
+    uint64_t done = 0;
+    while (n > 0) {
+        const size_t room = l1_cfg->line_bytes - (addr & (l1_cfg->line_bytes - 1u));
+        const size_t chunk = n < room ? n : room;
+        cache_read_span_at(s, addr, l1_cache, l1_cfg, dst, chunk);
+        if (s->timing != NULL && s->timing->last_done > done) done = s->timing->last_done;
+        addr += (uint32_t) chunk;
+        dst += chunk;
+        n -= chunk;
+    }
+    if (s->timing != NULL) s->timing->last_done = done;
+}
+
+static inline void cache_write_range_at(const cache_sim_t * s, uint32_t addr,
+                                        void * l1_cache, const cache_config_t * l1_cfg,
+                                        const uint8_t * src, size_t n)
+{
+    while (n > 0) {
+        const size_t room = l1_cfg->line_bytes - (addr & (l1_cfg->line_bytes - 1u));
+        const size_t chunk = n < room ? n : room;
+        cache_write_span_at(s, addr, l1_cache, l1_cfg, src, chunk);
+        addr += (uint32_t) chunk;
+        src += chunk;
+        n -= chunk;
+    }
+}
+
+// A single write access: the byte is merged into the line in place, not read first
+static inline void cache_write_byte_at(const cache_sim_t * s, uint32_t addr,
+                                       void * l1_cache, const cache_config_t * l1_cfg,
+                                       uint8_t byte)
+{
+    cache_write_span_at(s, addr, l1_cache, l1_cfg, &byte, 1);
+}
+
+// Hierarchy seen by a single-access function, which only knows one of the L1 caches and no L3
+static inline cache_sim_t cache_sim_single(void * mem_space, void * l1_cache, const cache_config_t * l1_cfg,
+                                           void * l2_cache, const cache_config_t * l2_cfg)
+{
+    cache_sim_t s = { mem_space, NULL, NULL, NULL, NULL, l2_cache, l2_cfg, NULL, NULL };
+    if (l1_cfg->type == L1_ICACHE) {
+        s.l1_icache = l1_cache;
+        s.l1_icfg = l1_cfg;
+    } else {
+        s.l1_dcache = l1_cache;
+        s.l1_dcfg = l1_cfg;
+    }
+    return s;
+}
+
+
+
+int cache_read(void * mem_space,
+               phy_addr_t * paddr,
+               mem_access_t access,
+               void * l1_cache,
+               const cache_config_t * l1_cfg,
+               void * l2_cache,
+               const cache_config_t * l2_cfg,
+               uint32_t * word) {
+
+    M_REQUIRE_NON_NULL(mem_space);
+    M_REQUIRE_NON_NULL(paddr);
+    M_REQUIRE_NON_NULL(l1_cache);
+    M_REQUIRE_NON_NULL(l1_cfg);
+    M_REQUIRE_NON_NULL(l2_cache);
+    M_REQUIRE_NON_NULL(l2_cfg);
+    M_REQUIRE_NON_NULL(word);
+    M_REQUIRE(l1_cfg->type == (access == INSTRUCTION ? L1_ICACHE : L1_DCACHE),
+              ERR_BAD_PARAMETER, "%s", "L1 cache does not match the access type");
+    M_REQUIRE(l1_cfg->line_bytes == l2_cfg->line_bytes, ERR_SIZE, "%s", "L1 and L2 line sizes differ");
+
+    const cache_sim_t s = cache_sim_single(mem_space, l1_cache, l1_cfg, l2_cache, l2_cfg);
+    *word = cache_read_word_at(&s, phy_to_uint32(*paddr), l1_cache, l1_cfg);
 
     return ERR_NONE;
 }
@@ -550,31 +2056,29 @@ int cache_read(const void * mem_space,
 
 
 
-int cache_read_byte(const void * mem_space,
+int cache_read_byte(void * mem_space,
                     phy_addr_t * p_paddr,
                     mem_access_t access,
                     void * l1_cache,
+                    const cache_config_t * l1_cfg,
                     void * l2_cache,
-                    uint8_t * p_byte,
-                    cache_replace_t replace){
+                    const cache_config_t * l2_cfg,
+                    uint8_t * p_byte){
 
 
     M_REQUIRE_NON_NULL(mem_space);
     M_REQUIRE_NON_NULL(p_paddr);
     M_REQUIRE_NON_NULL(l1_cache);
+    M_REQUIRE_NON_NULL(l1_cfg);
     M_REQUIRE_NON_NULL(l2_cache);
+    M_REQUIRE_NON_NULL(l2_cfg);
     M_REQUIRE_NON_NULL(p_byte);
+    M_REQUIRE(l1_cfg->type == (access == INSTRUCTION ? L1_ICACHE : L1_DCACHE),
+              ERR_BAD_PARAMETER, "%s", "L1 cache does not match the access type");
+    M_REQUIRE(l1_cfg->line_bytes == l2_cfg->line_bytes, ERR_SIZE, "%s", "L1 and L2 line sizes differ");
 
-    // INDEX OF BYTE TO SELECT
-    uint8_t index = p_paddr->page_offset % 4;
-    
-    //READ WORD
-    word_t * word = malloc(sizeof(word_t));
-    M_REQUIRE_NON_NULL(word);
-    M_REQUIRE(cache_read(mem_space, p_paddr, access, l1_cache, l2_cache, word, replace) == ERR_NONE, ERR_BAD_PARAMETER, %s, "error in cache read");
-    
-    // RETURN CORRESPONDING BYTE IN THE CORRESPONDING WORD
-    *p_byte = (*word >> (index * BYTE_SIZE)) & BYTE_MAX;
+    const cache_sim_t s = cache_sim_single(mem_space, l1_cache, l1_cfg, l2_cache, l2_cfg);
+    *p_byte = cache_read_byte_at(&s, phy_to_uint32(*p_paddr), l1_cache, l1_cfg);
 
     return ERR_NONE;
 }
@@ -584,254 +2088,250 @@ int cache_read_byte(const void * mem_space,
 int cache_write(void * mem_space,
                 phy_addr_t * paddr,
                 void * l1_cache,
+                const cache_config_t * l1_cfg,
                 void * l2_cache,
-                const uint32_t * word,
-                cache_replace_t replace){
+                const cache_config_t * l2_cfg,
+                const uint32_t * word){
 
     M_REQUIRE_NON_NULL(mem_space);
     M_REQUIRE_NON_NULL(paddr);
     M_REQUIRE_NON_NULL(l1_cache);
+    M_REQUIRE_NON_NULL(l1_cfg);
     M_REQUIRE_NON_NULL(l2_cache);
+    M_REQUIRE_NON_NULL(l2_cfg);
     M_REQUIRE_NON_NULL(word);
+    M_REQUIRE(l1_cfg->type == L1_DCACHE, ERR_BAD_PARAMETER, "%s", "writes go to L1 DCACHE");
+    M_REQUIRE(l1_cfg->line_bytes == l2_cfg->line_bytes, ERR_SIZE, "%s", "L1 and L2 line sizes differ");
 
-    // CREATE DIFFERENT VARIABLE THAT WE NEED TO USE DURING THE FUNCTION (NAME EXPLICITLY)
-    uint32_t addr = phy_to_uint32(*paddr);
-    uint8_t w_select = (addr >> 2) & 0b11;
-
-    const uint32_t * p_line_inl1 = calloc(L1_DCACHE_WORDS_PER_LINE, sizeof(word_t));
-    const uint32_t * p_line_inl2 =  calloc(L2_CACHE_WORDS_PER_LINE, sizeof(word_t));
-    M_REQUIRE_NON_NULL(p_line_inl1);
-    M_REQUIRE_NON_NULL(p_line_inl2);
-
-    uint8_t hit_way = 0;
-    uint16_t hit_index = 0;
-
-    void * cache = l1_cache;
-    M_REQUIRE(cache_hit(mem_space, l1_cache, paddr, &p_line_inl1, &hit_way, &hit_index, L1_DCACHE) == ERR_NONE, ERR_BAD_PARAMETER, %s, " error in cache_hit ");
-
-
-    // #################################################### CASE WE HIT IN THE L1_DCACHE ###############################################################
-    if (hit_way != HIT_WAY_MISS){
-
-        // COPY THE LINE WE WILL MODIFY
-        uint32_t * line_to_use = calloc(L1_DCACHE_WORDS_PER_LINE, sizeof(word_t));
-        M_REQUIRE_NON_NULL(line_to_use);
-        M_REQUIRE_NON_NULL(memcpy(line_to_use, p_line_inl1, L1_DCACHE_WORDS_PER_LINE*sizeof(word_t)));
-
-        //UPDATE THE WORLD (WRITE)
-        line_to_use[w_select] = *word;
-
-        //INITIALIZE A NEW ENTRY WITH THE NEW LINE TO INSERT IT THEN
-        l1_dcache_entry_t * entry = malloc(sizeof(l1_dcache_entry_t));
-        M_REQUIRE_NON_NULL(entry);
-        entry->tag = cache_tag(l1_dcache_entry_t, L1_DCACHE_WAYS, hit_index, hit_way);
-        M_REQUIRE_NON_NULL(memcpy(entry->line, line_to_use, L1_DCACHE_WORDS_PER_LINE * sizeof(word_t)));
-        entry->v =1;
-        entry->age =0;
-
-        //INSERT THE NEW ENTRY AND UPDATE AGE
-        M_REQUIRE(cache_insert(hit_index, hit_way, entry,  l1_cache, L1_DCACHE) == ERR_NONE, ERR_BAD_PARAMETER, %s, " error in cache_insert");
-        LRU_age_update(l1_dcache_entry_t, L1_DCACHE_WAYS, hit_way, hit_index); 
+    const cache_sim_t s = cache_sim_single(mem_space, l1_cache, l1_cfg, l2_cache, l2_cfg);
+    cache_write_word_at(&s, phy_to_uint32(*paddr), l1_cache, l1_cfg, *word);
 
-        //COPY IN MEMORY THE LINE
-        M_REQUIRE_NON_NULL(memcpy(mem_space + phy_to_uint32(*paddr), line_to_use, L1_ICACHE_WORDS_PER_LINE*sizeof(word_t)));
-
-        return ERR_NONE;
-    }
+    return ERR_NONE;
+}
 
+int cache_write_byte(void * mem_space,
+                     phy_addr_t * paddr,
+                     void * l1_cache,
+                     const cache_config_t * l1_cfg,
+                     void * l2_cache,
+                     const cache_config_t * l2_cfg,
+                     uint8_t p_byte){
 
-    uint8_t * hit_way_l2 = malloc(sizeof(uint8_t));
-    uint16_t  * hit_index_l2 = malloc(sizeof(uint16_t));
-    M_REQUIRE_NON_NULL(hit_way_l2);
-    M_REQUIRE_NON_NULL(hit_index_l2);
+    M_REQUIRE_NON_NULL(paddr);
+    M_REQUIRE_NON_NULL(mem_space);
+    M_REQUIRE_NON_NULL(l2_cache);
+    M_REQUIRE_NON_NULL(l2_cfg);
+    M_REQUIRE_NON_NULL(l1_cache);
+    M_REQUIRE_NON_NULL(l1_cfg);
+    M_REQUIRE(l1_cfg->type == L1_DCACHE, ERR_BAD_PARAMETER, "%s", "writes go to L1 DCACHE");
+    M_REQUIRE(l1_cfg->line_bytes == l2_cfg->line_bytes, ERR_SIZE, "%s", "L1 and L2 line sizes differ");
 
-    M_REQUIRE(cache_hit(mem_space, l2_cache, paddr, &p_line_inl2, hit_way_l2, hit_index_l2, L2_CACHE) == ERR_NONE, ERR_BAD_PARAMETER, %s, "error in cache_hit");
+    const cache_sim_t s = cache_sim_single(mem_space, l1_cache, l1_cfg, l2_cache, l2_cfg);
+    cache_write_byte_at(&s, phy_to_uint32(*paddr), l1_cache, l1_cfg, p_byte);
 
-    // ################################################################ CASE WE HIT IN L2 BUT NOT L1 ###########################################################
-    if (*hit_way_l2 != HIT_WAY_MISS){
+    return ERR_NONE;
+}
 
-        //COPY THE LINE WE WILL MODIFY
-        uint32_t * line_to_use = calloc(L2_CACHE_WORDS_PER_LINE, sizeof(word_t));
-        M_REQUIRE_NON_NULL(line_to_use);
-        cache = l2_cache;
-        M_REQUIRE_NON_NULL(memcpy(line_to_use, p_line_inl2, L2_CACHE_WORDS_PER_LINE * sizeof(word_t)));
+int cache_read_range(void * mem_space,
+                     phy_addr_t * paddr,
+                     mem_access_t access,
+                     void * l1_cache,
+                     const cache_config_t * l1_cfg,
+                     void * l2_cache,
+                     const cache_config_t * l2_cfg,
+                     uint8_t * bytes,
+                     size_t n){
 
-        //UPDATE THE WORLD (WRITE)
-        line_to_use[w_select] = *word;
+    M_REQUIRE_NON_NULL(mem_space);
+    M_REQUIRE_NON_NULL(paddr);
+    M_REQUIRE_NON_NULL(l1_cache);
+    M_REQUIRE_NON_NULL(l1_cfg);
+    M_REQUIRE_NON_NULL(l2_cache);
+    M_REQUIRE_NON_NULL(l2_cfg);
+    M_REQUIRE(n == 0 || bytes != NULL, ERR_BAD_PARAMETER, "%s", "NULL bytes");
+    M_REQUIRE(l1_cfg->type == (access == INSTRUCTION ? L1_ICACHE : L1_DCACHE),
+              ERR_BAD_PARAMETER, "%s", "L1 cache does not match the access type");
+    M_REQUIRE(l1_cfg->line_bytes == l2_cfg->line_bytes, ERR_SIZE, "%s", "L1 and L2 line sizes differ");
+    M_REQUIRE(paddr->page_offset + n <= PAGE_SIZE, ERR_BAD_PARAMETER, "%zu bytes: range crosses a page", n);
 
-        cache = l2_cache;
+    const cache_sim_t s = cache_sim_single(mem_space, l1_cache, l1_cfg, l2_cache, l2_cfg);
+    cache_read_range_at(&s, phy_to_uint32(*paddr), l1_cache, l1_cfg, bytes, n);
 
-        //INITIALIZE A NEW ENTRY WITH THE NEW LINE TO INSERT IT THEN
-        l2_cache_entry_t * entry_l2 = malloc(sizeof(l2_cache_entry_t));
-        M_REQUIRE_NON_NULL(entry_l2);
-        M_REQUIRE_NON_NULL(memcpy(entry_l2->line, line_to_use, L2_CACHE_WORDS_PER_LINE * sizeof(word_t)));
-        entry_l2->tag = cache_tag(l2_cache_entry_t, L2_CACHE_WAYS, *hit_index_l2, *hit_way_l2) ;
-        entry_l2->v = 1;
-        entry_l2->age =0;
+    return ERR_NONE;
+}
 
-        //INSERT THE NEW ENTRY AND UPDATE AGE
-        M_REQUIRE(cache_insert(*hit_index_l2, *hit_way_l2, entry_l2,  l2_cache, L2_CACHE) == ERR_NONE, ERR_BAD_PARAMETER, %s, " error in cache_insert");
-        LRU_age_update(l2_cache_entry_t, L2_CACHE_WAYS, *hit_way_l2, *hit_index_l2);
+int cache_write_range(void * mem_space,
+                      phy_addr_t * paddr,
+                      void * l1_cache,
+                      const cache_config_t * l1_cfg,
+                      void * l2_cache,
+                      const cache_config_t * l2_cfg,
+                      const uint8_t * bytes,
+                      size_t n){
 
-        //COPY IN MEMORY THE LINE
-        M_REQUIRE_NON_NULL(memcpy(mem_space + phy_to_uint32(*paddr), line_to_use , L2_CACHE_WORDS_PER_LINE * sizeof(word_t)));
+    M_REQUIRE_NON_NULL(mem_space);
+    M_REQUIRE_NON_NULL(paddr);
+    M_REQUIRE_NON_NULL(l1_cache);
+    M_REQUIRE_NON_NULL(l1_cfg);
+    M_REQUIRE_NON_NULL(l2_cache);
+    M_REQUIRE_NON_NULL(l2_cfg);
+    M_REQUIRE(n == 0 || bytes != NULL, ERR_BAD_PARAMETER, "%s", "NULL bytes");
+    M_REQUIRE(l1_cfg->type == L1_DCACHE, ERR_BAD_PARAMETER, "%s", "writes go to L1 DCACHE");
+    M_REQUIRE(l1_cfg->line_bytes == l2_cfg->line_bytes, ERR_SIZE, "%s", "L1 and L2 line sizes differ");
+    M_REQUIRE(paddr->page_offset + n <= PAGE_SIZE, ERR_BAD_PARAMETER, "%zu bytes: range crosses a page", n);
 
-        // CREATE AN ENTRY TO TRANSFER THE DATA FROM L2 TO L1D
-        l1_dcache_entry_t *  entry = malloc(sizeof(l1_dcache_entry_t));
-        M_REQUIRE_NON_NULL(entry);  
-        transfer_to_l1(l2_cache, entry, L1_DCACHE , *hit_way_l2, *hit_index_l2);//L1_DCACHE??
-        entry->v = 1;
-        entry->tag = (addr >> L1_DCACHE_TAG_REMAINING_BITS);
+    const cache_sim_t s = cache_sim_single(mem_space, l1_cache, l1_cfg, l2_cache, l2_cfg);
+    cache_write_range_at(&s, phy_to_uint32(*paddr), l1_cache, l1_cfg, bytes, n);
 
-        // FIND THE WAY WAY AND INDEX WHERE WE WILL INSERT THE ENTRY
-        uint16_t index_in_l1 = *hit_index_l2  & INDEX_L1_MASK;
-        uint8_t way_in_l1 = invalid_way(l1_cache, L1_DCACHE, index_in_l1);
-        cache = l1_cache;
+    return ERR_NONE;
+}
 
-        // CASE WE FIND AN AVAILABLE WAY IN L1
-        if (way_in_l1 != HIT_WAY_MISS){
 
-            M_REQUIRE(cache_insert(index_in_l1, way_in_l1, entry, l1_cache, L1_DCACHE) == ERR_NONE, ERR_BAD_PARAMETER, %s, " error in cache_insert");
-            LRU_age_increase(l1_dcache_entry_t, L1_DCACHE_WAYS, way_in_l1, index_in_l1);
-            return ERR_NONE;
-        }
 
-        // CASE WE NEED TO EVICT A EN ENTRY FRON L1 TO L2 BECAUSE THERE WAS NO PLACE 
-        else{
-
-            // FIND THE WAY OF THE ENTRY TO EVICT
-            uint8_t way_evicted = LRU_way(l1_cache, L1_DCACHE, index_in_l1);
-
-            //CREATE QN ENTRY THAHT WE SET TO THE ENTRY WE EVICT
-            l2_cache_entry_t * entry_evicted = malloc(sizeof(l2_cache_entry_t));
-            M_REQUIRE_NON_NULL(entry_evicted);
-            entry_evicted->age = 0;
-            entry_evicted->tag = (entry->tag >> (L2_CACHE_TAG_REMAINING_BITS - L1_DCACHE_TAG_REMAINING_BITS));
-            M_REQUIRE_NON_NULL(memcpy(entry_evicted->line, entry->line, L1_DCACHE_WORDS_PER_LINE*sizeof(word_t)));
-
-            //INSERT THE ORIGINAL ENTRY IN L1 AND UPDATE AGE
-            M_REQUIRE(cache_insert(index_in_l1, way_evicted, entry, l1_cache, L1_DCACHE) == ERR_NONE, ERR_BAD_PARAMETER, %s, " error in cache_insert");
-            LRU_age_update(l1_dcache_entry_t, L1_DCACHE_WAYS, way_evicted, index_in_l1);
-
-            //FIND THE WAY TO INSERT IN L2 FOR THE EVICTED
-            uint8_t way_for_l2 = invalid_way(l2_cache, L2_CACHE, *hit_index_l2);
-            cache = l2_cache;
-
-            //CASE THERE IS A PLACE IN L2
-            if (way_for_l2 != HIT_WAY_MISS){
-                //INSERT THE EVICTED ENTRY IN L2
-                M_REQUIRE(cache_insert(*hit_index_l2, way_for_l2, entry_evicted, l2_cache, L2_CACHE) == ERR_NONE, ERR_BAD_PARAMETER, %s, " error in cache_insert");
-                LRU_age_increase(l2_cache_entry_t, L2_CACHE_WAYS, way_for_l2, *hit_index_l2);
-
-            // CASE THERE IS NO PLACE IN L2 SO WE NEED TO DELETE ONE
-            } else {
-                // FIND THE WAY DEPENDING ON THE AGE TO INSERT THE EVICTED ENTRY
-                uint8_t way_evicted2 = LRU_way(l2_cache, L2_CACHE, *hit_index_l2);
-                M_REQUIRE(cache_insert(*hit_index_l2, way_evicted2, entry_evicted, l2_cache, L2_CACHE) == ERR_NONE, ERR_BAD_PARAMETER, %s, " error in cache_insert");
-                LRU_age_update(l2_cache_entry_t, L2_CACHE_WAYS, way_evicted2, *hit_index_l2);
-                }
-        }
+// Checks of a hierarchy, once per batch
+static int cache_sim_check(const cache_sim_t * sim)
+{
+    M_REQUIRE_NON_NULL(sim);
+    M_REQUIRE_NON_NULL(sim->mem_space);
+    M_REQUIRE_NON_NULL(sim->l1_icache);
+    M_REQUIRE_NON_NULL(sim->l1_icfg);
+    M_REQUIRE_NON_NULL(sim->l1_dcache);
+    M_REQUIRE_NON_NULL(sim->l1_dcfg);
+    M_REQUIRE_NON_NULL(sim->l2_cache);
+    M_REQUIRE_NON_NULL(sim->l2_cfg);
+    M_REQUIRE(sim->l1_icfg->type == L1_ICACHE && sim->l1_dcfg->type == L1_DCACHE,
+              ERR_BAD_PARAMETER, "%s", "L1 caches do not match their access types");
+    M_REQUIRE(sim->l1_icfg->line_bytes == sim->l2_cfg->line_bytes
+              && sim->l1_dcfg->line_bytes == sim->l2_cfg->line_bytes,
+              ERR_SIZE, "%s", "L1 and L2 line sizes differ");
+    M_REQUIRE(sim->l3_cache == NULL || (sim->l3_cfg != NULL && sim->l3_cfg->type == L3_CACHE
+                                        && sim->l3_cfg->line_bytes == sim->l2_cfg->line_bytes),
+              ERR_BAD_PARAMETER, "%s", "bad L3 cache");
 
     return ERR_NONE;
+}
 
-    // ################################################# CASE NOT FOUND IN L1 AND L2 #############################################
-    } else {
+// One access of a batch; ERR_BAD_PARAMETER on an unknown operation or a range crossing a page
+static inline int cache_access_at(const cache_sim_t * s, uint32_t addr, uint8_t op, word_t * out)
+{
+    const size_t span = CACHE_OP_SPAN(op);
+    uint8_t bytes[CACHE_MAX_LINE_BYTES];
+    if ((CACHE_OP_KIND(op) == CACHE_OP_READ_RANGE || CACHE_OP_KIND(op) == CACHE_OP_WRITE_RANGE)
+        && (span > CACHE_MAX_LINE_BYTES || (addr & (PAGE_SIZE - 1u)) + span > PAGE_SIZE))
+        return ERR_BAD_PARAMETER;
 
-        // GET LINE FROM MEMORY, MODIFY IT AND INSERT IT BACK
-        uint32_t * line_memory = calloc(L1_DCACHE_WORDS_PER_LINE, sizeof(word_t));
-        M_REQUIRE_NON_NULL(line_memory);
-        M_REQUIRE_NON_NULL(memcpy(line_memory, mem_space+addr, L1_DCACHE_WORDS_PER_LINE*sizeof(word_t)));
-        line_memory[w_select] = *word;
-        M_REQUIRE_NON_NULL(memcpy(mem_space+addr, line_memory, L1_DCACHE_WORDS_PER_LINE*sizeof(word_t)));
-        
-        // CREATE AN L1 ENTRY TO INSERT NEW LINE IN L1D
-        l1_dcache_entry_t * newd = malloc(sizeof(l1_dcache_entry_t));
-        M_REQUIRE_NON_NULL(newd);
-        M_REQUIRE(cache_entry_init(mem_space, paddr, newd, L1_DCACHE) == ERR_NONE, ERR_BAD_PARAMETER, %s, " error in cache_entry_init"); \
-
-        //FIND THE WAY WHERE TO INSERT LINE
-        uint16_t index_linel1 = (addr >> INDEX_OFFSET) & INDEX_L1_MASK;
-        uint8_t wayld = invalid_way(l1_cache, L1_DCACHE, index_linel1);
-
-        cache = l1_cache;
-
-        //CASE THERE IS PLACE IN L1D CACHE
-        if (wayld != HIT_WAY_MISS){
-            M_REQUIRE(cache_insert(index_linel1, wayld, newd, l1_cache, L1_DCACHE) == ERR_NONE, ERR_BAD_PARAMETER, %s, " error in cache_insert");
-            LRU_age_increase (l1_dcache_entry_t, L1_DCACHE_WAYS, wayld, index_linel1);
-        }
+    cache_timing_t * const timing = s->timing;
 
-        //CASE THERE IS NO PLACE, SO WE NEED TO EVICT ONE ENTRY AND PUT IT IN L2
-        else{
-            
-            //FIND THE WAY OF THE ENTRY TO EVICT
-            uint8_t way_evicted2 = LRU_way(l1_cache, L1_DCACHE, index_linel1);
-
-            //CREATE AN ENTRY TO COPY THE EVICTED ONE
-            l2_cache_entry_t * entry_evicted = malloc(sizeof(l2_cache_entry_t));
-            M_REQUIRE_NON_NULL(entry_evicted);
-            M_REQUIRE_NON_NULL(memcpy(entry_evicted->line, cache_line(l1_dcache_entry_t, L1_DCACHE_WAYS, index_linel1, way_evicted2), L1_DCACHE_WORDS_PER_LINE * sizeof(word_t)));
-            entry_evicted->age = 0;
-            entry_evicted->tag = (cache_tag(l1_dcache_entry_t, L1_DCACHE_WAYS, index_linel1, way_evicted2) >> (L1_DCACHE_TAG_REMAINING_BITS - L2_CACHE_WORDS_PER_LINE));
-
-            // INSERT THE NEW ENTRY IN L1 AND UPDATE AGE
-            M_REQUIRE(cache_insert(index_linel1, way_evicted2, newd, l1_cache, L1_DCACHE) == ERR_NONE, ERR_BAD_PARAMETER, %s, " error in cache_insert");
-            LRU_age_update(l1_dcache_entry_t, L1_DCACHE_WAYS, way_evicted2, index_linel1);
-
-            //FIND THE LINE AND WAY WHERE INSERT THE EVICTED ENTRY
-            uint16_t l2index = (phy_to_uint32(*paddr) >> INDEX_OFFSET) & INDEX_L2_MASK;
-            cache = l2_cache;
-            uint8_t way_l2 = invalid_way(l2_cache, L2_CACHE, l2index);
-
-            //CASE THERE IS A PLACE IN L2
-            if (way_l2 != HIT_WAY_MISS){ 
-                M_REQUIRE(cache_insert(l2index, way_l2, entry_evicted, l2_cache, L2_CACHE) == ERR_NONE, ERR_BAD_PARAMETER, %s, " error in cache_insert");
-                LRU_age_increase(l2_cache_entry_t, L2_CACHE_WAYS, way_l2, l2index);
-            } 
-
-            //CASE THERE IS NO PLACE, SO WE FIND THE ENTRY TO DELETE USING REPLACEMENT POLICY
-            else{
-                way_l2 = LRU_way(l2_cache, L2_CACHE, l2index);
-                M_REQUIRE(cache_insert(l2index, way_l2, entry_evicted, l2_cache, L2_CACHE) == ERR_NONE, ERR_BAD_PARAMETER, %s, " error in cache_insert");
-                LRU_age_update(l2_cache_entry_t, L2_CACHE_WAYS, way_l2, l2index);
-            }
-        }
+    //A DEPENDENT ACCESS ISSUES ONCE THE DATA OF THE PREVIOUS READ IS THERE
+    if (timing != NULL && (op & CACHE_OP_DEPENDENT) && timing->read_ready > timing->now) {
+        timing->dependence_stalls += timing->read_ready - timing->now;
+        timing->now = timing->read_ready;
+    }
 
-    return ERR_NONE;
+    int read = 1;
+    switch (CACHE_OP_KIND(op)) {
+    case CACHE_OP_READ_INSTR:
+        *out = cache_read_word_at(s, addr, s->l1_icache, s->l1_icfg);
+        break;
+    case CACHE_OP_READ_WORD:
+        *out = cache_read_word_at(s, addr, s->l1_dcache, s->l1_dcfg);
+        break;
+    case CACHE_OP_READ_BYTE:
+        *out = cache_read_byte_at(s, addr, s->l1_dcache, s->l1_dcfg);
+        break;
+    case CACHE_OP_WRITE_WORD:
+        cache_write_word_at(s, addr, s->l1_dcache, s->l1_dcfg, *out);
+        read = 0;
+        break;
+    case CACHE_OP_WRITE_BYTE:
+        cache_write_byte_at(s, addr, s->l1_dcache, s->l1_dcfg, (uint8_t) *out);
+        read = 0;
+        break;
+    case CACHE_OP_READ_RANGE:
+        cache_read_range_at(s, addr, s->l1_dcache, s->l1_dcfg, bytes, span);
+        *out = 0;
+        memcpy(out, bytes, span < sizeof(word_t) ? span : sizeof(word_t));
+        break;
+    case CACHE_OP_WRITE_RANGE:
+        //THE WORD REPEATED, IN PHASE WITH THE ADDRESSES
+        for (size_t i = 0; i < span; ++i)
+            bytes[i] = (uint8_t) (*out >> (BYTE_SIZE * ((addr + i) % sizeof(word_t))));
+        cache_write_range_at(s, addr, s->l1_dcache, s->l1_dcfg, bytes, span);
+        read = 0;
+        break;
+    default:
+        return ERR_BAD_PARAMETER;
+    }
 
+    //IN ORDER, ONE ACCESS PER CYCLE; STORES RETIRE WITHOUT WAITING FOR THEIR LINE
+    if (timing != NULL) {
+        if (read) timing->read_ready = timing->last_done;
+        timing->now += 1;
     }
+    return ERR_NONE;
+}
 
-return ERR_NONE;
+int cache_access_batch(const cache_sim_t * sim,
+                       const phy_addr_t * addrs,
+                       const uint8_t * ops,
+                       size_t n,
+                       word_t * out){
+
+    const int err = cache_sim_check(sim);
+    if (err != ERR_NONE) return err;
+    M_REQUIRE(n == 0 || (addrs != NULL && ops != NULL && out != NULL), ERR_BAD_PARAMETER,
+              "%s", "NULL access arrays");
+
+    // COPIES, SO THAT THE STORES INTO THE CACHES CANNOT FORCE RELOADING THEM (A SINGLE CORE)
+    cache_sim_t s = *sim;
+    s.cores = NULL;
+    s.nb_cores = 0;
+    s.coherence = NULL;
+
+    for (size_t i = 0; i < n; ++i) {
+        if (cache_access_at(&s, phy_to_uint32(addrs[i]), ops[i], &out[i]) != ERR_NONE)
+            M_EXIT(ERR_BAD_PARAMETER, "access %zu: bad operation %u", i, ops[i]);
+    }
 
+    return ERR_NONE;
 }
 
-int cache_write_byte(void * mem_space,
-                     phy_addr_t * paddr,
-                     void * l1_cache,
-                     void * l2_cache,
-                     uint8_t p_byte,
-                     cache_replace_t replace){
-    
-    M_REQUIRE_NON_NULL(paddr);
-    M_REQUIRE_NON_NULL(mem_space);
-    M_REQUIRE_NON_NULL(l2_cache);
-    M_REQUIRE_NON_NULL(p_byte);
-    M_REQUIRE_NON_NULL(l1_cache);
-
-    //INITIALISE WORD
-    word_t * word = malloc(sizeof(word_t));
-    M_REQUIRE_NON_NULL(word);
 
-    //INDEX OF THE BYTE TO GET
-    uint8_t index = phy_to_uint32(*paddr) % 4;
-    
-    M_REQUIRE(cache_read(mem_space, paddr, DATA, l1_cache, l2_cache, word, replace)== ERR_NONE, ERR_BAD_PARAMETER, %s, "error in cache read");
 
-    //GET BYTE
-    *word = *word | (p_byte << (BYTE_SIZE*index));
+int cache_cores_access_batch(const cache_sim_t * cores,
+                             uint8_t nb_cores,
+                             cache_coherence_stats_t * coherence,
+                             const uint8_t * core_ids,
+                             const phy_addr_t * addrs,
+                             const uint8_t * ops,
+                             size_t n,
+                             word_t * out){
+
+    M_REQUIRE_NON_NULL(cores);
+    M_REQUIRE_NON_NULL(coherence);
+    M_REQUIRE(nb_cores >= 1 && nb_cores <= CACHE_MAX_CORES, ERR_BAD_PARAMETER,
+              "%u: bad number of cores", nb_cores);
+    M_REQUIRE(n == 0 || (core_ids != NULL && addrs != NULL && ops != NULL && out != NULL),
+              ERR_BAD_PARAMETER, "%s", "NULL access arrays");
+
+    // COPIES THAT KNOW ALL THE CORES AND THEIR COUNTERS
+    cache_sim_t s[CACHE_MAX_CORES];
+    for (uint8_t c = 0; c < nb_cores; ++c) {
+        const int err = cache_sim_check(&cores[c]);
+        if (err != ERR_NONE) return err;
+        M_REQUIRE(cores[c].mem_space == cores[0].mem_space && cores[c].l3_cache == cores[0].l3_cache,
+                  ERR_BAD_PARAMETER, "core %u: the cores must share memory and L3", c);
+        s[c] = cores[c];
+        s[c].cores = s;
+        s[c].nb_cores = nb_cores;
+        s[c].coherence = &coherence[c];
+    }
 
-    M_REQUIRE(cache_write(mem_space, paddr, l1_cache, l2_cache, word, replace)== ERR_NONE, ERR_BAD_PARAMETER, %s, "error in cache write");
+    for (size_t i = 0; i < n; ++i) {
+        M_REQUIRE(core_ids[i] < nb_cores, ERR_BAD_PARAMETER, "access %zu: unknown core %u", i, core_ids[i]);
+        if (cache_access_at(&s[core_ids[i]], phy_to_uint32(addrs[i]), ops[i], &out[i]) != ERR_NONE)
+            M_EXIT(ERR_BAD_PARAMETER, "access %zu: bad operation %u", i, ops[i]);
+    }
 
     return ERR_NONE;
 }
-
@@ -11,12 +11,87 @@
 #include "cache.h"
 #include <stdio.h> // for FILE
 
-enum cache_replacement_policy { LRU };
-typedef enum cache_replacement_policy cache_replace_t;
-
 #define HIT_WAY_MISS   ((uint8_t)  -1)
 #define HIT_INDEX_MISS ((uint16_t) -1)
 
+/**
+ * @brief Coherence traffic of one core of a multi-core hierarchy
+ *        (see cache_cores_access_batch()).
+ */
+typedef struct cache_coherence_stats {
+    uint64_t invalidations; // lines this core lost to the writes of another core
+    uint64_t upgrades;      // writes of this core to a shared line (S -> M)
+    uint64_t c2c_transfers; // lines this core got from the modified copy of another core
+} cache_coherence_stats_t;
+
+#define CACHE_MAX_CORES 16
+
+/**
+ * @brief Clock of an in-order core over non-blocking levels (see cache_mshr_t), which
+ *        times its accesses when given in cache_sim_t. Accesses issue in order, one per
+ *        cycle; an access marked CACHE_OP_DEPENDENT waits for the data of the previous
+ *        read, and one that misses L1 waits for a free MSHR there. Zero it before the
+ *        first access. The cores of cache_cores_access_batch() have their own clocks,
+ *        which the MSHRs of a shared L3 compare as if they were in step.
+ */
+typedef struct cache_timing {
+    uint64_t now;               // issue cycle of the current (then next) access
+    uint64_t end;               // cycle at which all the demand accesses so far are complete
+    uint64_t read_ready;        // cycle at which the data of the last read is available
+    uint64_t last_done;         // completion cycle of the last lookup
+    uint64_t dependence_stalls; // cycles dependent accesses waited for their data
+    uint64_t mshr_stalls;       // cycles accesses waited for a free L1 MSHR
+    uint64_t miss_cycles;       // sum of the durations of the L1 demand misses
+    uint64_t miss_busy;         // cycles with at least one of them in flight
+    uint64_t miss_busy_until;   // end of the last of them so far
+} cache_timing_t;
+
+/**
+ * @brief A whole cache hierarchy with its memory space, as cache_access_batch()
+ *        takes it: the two L1 caches, the L2, the L3 (NULL if there is none) and
+ *        their configurations. All the levels must have the same line size.
+ *
+ * The L3 and the back-invalidation of both L1 caches are only available through
+ * cache_access_batch(): the single-access functions (cache_read() and friends) only
+ * know one L1 cache and the L2.
+ */
+typedef struct cache_sim {
+    void * mem_space;
+    void * l1_icache;
+    const cache_config_t * l1_icfg;
+    void * l1_dcache;
+    const cache_config_t * l1_dcfg;
+    void * l2_cache;
+    const cache_config_t * l2_cfg;
+    void * l3_cache;
+    const cache_config_t * l3_cfg;
+    cache_timing_t * timing; // clock of the core, NULL not to overlap the misses (see the latency model in cache.h)
+    // set by cache_cores_access_batch() only (leave them zeroed): all the cores, this one's counters
+    const struct cache_sim * cores;
+    uint8_t nb_cores;
+    cache_coherence_stats_t * coherence;
+} cache_sim_t;
+
+/**
+ * @brief Operations of cache_access_batch(), one uint8_t per access.
+ */
+enum cache_op {
+    CACHE_OP_READ_INSTR,  // cache_read() of an instruction word
+    CACHE_OP_READ_WORD,   // cache_read() of a data word
+    CACHE_OP_READ_BYTE,   // cache_read_byte() of data
+    CACHE_OP_WRITE_WORD,  // cache_write()
+    CACHE_OP_WRITE_BYTE,  // cache_write_byte()
+    CACHE_OP_READ_RANGE,  // cache_read_range() of data, of CACHE_OP_SIZE() bytes: out gets the first 4
+    CACHE_OP_WRITE_RANGE  // cache_write_range() of CACHE_OP_SIZE() bytes, out repeated over them
+                          // (the byte at address a is byte a % 4 of out)
+};
+#define CACHE_OP_KIND(OP) ((OP) & 0x0F)
+// ORed into a range operation: its span of 2^LOG2 bytes (at most CACHE_MAX_LINE_BYTES)
+#define CACHE_OP_SIZE(LOG2) ((uint8_t) ((LOG2) << 4))
+#define CACHE_OP_SPAN(OP) (1u << (((OP) >> 4) & 0x07))
+// ORed into an operation: its address comes from the data of the previous read (see cache_timing_t)
+#define CACHE_OP_DEPENDENT 0x80
+
 //=========================================================================
 /**
  * @brief Useful macro to loop over ways
@@ -25,16 +100,237 @@ typedef enum cache_replacement_policy cache_replace_t;
 #define foreach_way(var, ways) \
   for (uint8_t var = 0; var < (ways); var++)
 
+//=========================================================================
+/**
+ * @brief Initialize a cache geometry and compute its derived fields.
+ *
+ * @param cfg (modified) the configuration to initialize
+ * @param type the level described (used for dumps and messages)
+ * @param sets number of lines (sets), a power of 2
+ * @param ways associativity, between 1 and 255
+ * @param line_bytes bytes per line, a power of 2 between 4 and CACHE_MAX_LINE_BYTES
+ * @param policy replacement policy (PLRU needs a power-of-2 number of ways, at most 64);
+ *        RANDOM draws from cfg->seed, which may be changed afterwards
+ * @return error code (ERR_SIZE for an unsupported geometry, ERR_POLICY for an unsupported policy)
+ */
+int cache_config_init(cache_config_t * cfg, cache_t type, uint16_t sets,
+                      uint8_t ways, uint16_t line_bytes, cache_replace_t policy);
+
+//=========================================================================
+/**
+ * @brief Initialize a configuration with the default geometry of a level
+ *        (the L1_ICACHE_*, L1_DCACHE_* and L2_CACHE_* macros of cache.h).
+ *
+ * @param cfg (modified) the configuration to initialize
+ * @param type the level
+ * @return error code
+ */
+int cache_config_default(cache_config_t * cfg, cache_t type);
+
+//=========================================================================
+/**
+ * @brief Name of a replacement policy ("LRU", "PLRU", "SRRIP", "BRRIP", "FIFO", "RANDOM").
+ *
+ * @param policy the policy
+ * @return its name, NULL for an unknown policy
+ */
+const char * cache_policy_name(cache_replace_t policy);
+
+//=========================================================================
+/**
+ * @brief Find a replacement policy from its name (see cache_policy_name()).
+ *
+ * @param name the name of the policy
+ * @param policy (modified) the policy found
+ * @return error code (ERR_POLICY for an unknown name)
+ */
+int cache_policy_parse(const char * name, cache_replace_t * policy);
+
+//=========================================================================
+/**
+ * @brief Choose the storage layout of a cache (CACHE_LAYOUT_AOS after
+ *        cache_config_init()). Changes cache_size(): call it before allocating.
+ *
+ * @param cfg (modified) the configuration to update
+ * @param layout the new layout
+ * @return error code
+ */
+int cache_config_set_layout(cache_config_t * cfg, cache_layout_t layout);
+
+//=========================================================================
+/**
+ * @brief Choose the write policy of a cache (CACHE_WRITE_THROUGH after
+ *        cache_config_init()). Both policies can be mixed across levels: a dirty
+ *        line that moves to a write-through level is written to memory then.
+ *
+ * @param cfg (modified) the configuration to update
+ * @param write_policy the new write policy
+ * @return error code (ERR_POLICY for an unknown policy)
+ */
+int cache_config_set_write_policy(cache_config_t * cfg, cache_write_t write_policy);
+
+//=========================================================================
+/**
+ * @brief Choose the inclusion policy of L2 or L3 with respect to the levels above it
+ *        (after cache_config_init(): CACHE_EXCLUSIVE for L2, CACHE_INCLUSIVE for L3).
+ *
+ * @param cfg (modified) the configuration of L2 or L3 to update
+ * @param inclusion the new inclusion policy
+ * @return error code (ERR_BAD_PARAMETER if cfg is not an L2 or L3, ERR_POLICY for an unknown policy)
+ */
+int cache_config_set_inclusion(cache_config_t * cfg, cache_inclusion_t inclusion);
+
+//=========================================================================
+/**
+ * @brief Name of an inclusion policy ("EXCLUSIVE", "INCLUSIVE", "NINE").
+ *
+ * @param inclusion the inclusion policy
+ * @return its name, NULL for an unknown policy
+ */
+const char * cache_inclusion_name(cache_inclusion_t inclusion);
+
+//=========================================================================
+/**
+ * @brief Find an inclusion policy from its name (see cache_inclusion_name()).
+ *
+ * @param name the name of the policy
+ * @param inclusion (modified) the policy found
+ * @return error code (ERR_POLICY for an unknown name)
+ */
+int cache_inclusion_parse(const char * name, cache_inclusion_t * inclusion);
+
+//=========================================================================
+/**
+ * @brief Give L1 DCACHE or L2 a hardware prefetcher (CACHE_PREFETCH_NONE after
+ *        cache_config_init()). Changes cache_size(): call it before allocating.
+ *
+ * @param cfg (modified) the configuration of L1 DCACHE or L2 to update
+ * @param prefetch the prefetcher (see cache_prefetch_t)
+ * @param degree lines prefetched per trigger, 1 to CACHE_PREFETCH_MAX_DEGREE
+ * @param entries STRIDE: regions tracked (a power of 2), STREAM: streams tracked,
+ *        at most CACHE_PREFETCH_MAX_ENTRIES; ignored by the other prefetchers
+ * @return error code (ERR_BAD_PARAMETER if cfg is not L1 DCACHE or L2 or for a bad
+ *         degree, ERR_SIZE for a bad number of entries, ERR_POLICY for an unknown prefetcher)
+ */
+int cache_config_set_prefetch(cache_config_t * cfg, cache_prefetch_t prefetch,
+                              uint8_t degree, uint16_t entries);
+
+//=========================================================================
+/**
+ * @brief Name of a prefetcher ("NONE", "NEXT_LINE", "STRIDE", "STREAM").
+ *
+ * @param prefetch the prefetcher
+ * @return its name, NULL for an unknown prefetcher
+ */
+const char * cache_prefetch_name(cache_prefetch_t prefetch);
+
+//=========================================================================
+/**
+ * @brief Find a prefetcher from its name (see cache_prefetch_name()).
+ *
+ * @param name the name of the prefetcher
+ * @param prefetch (modified) the prefetcher found
+ * @return error code (ERR_POLICY for an unknown name)
+ */
+int cache_prefetch_parse(const char * name, cache_prefetch_t * prefetch);
+
+//=========================================================================
+/**
+ * @brief Set the latencies of a cache level (see the latency model in cache.h;
+ *        L1_CACHE_HIT_LATENCY, L2_CACHE_HIT_LATENCY or L3_CACHE_HIT_LATENCY
+ *        and CACHE_MEMORY_LATENCY after cache_config_init()).
+ *
+ * @param cfg (modified) the configuration to update
+ * @param hit_latency cycles of a lookup of the level
+ * @param memory_latency cycles of a memory access on a miss of the level, only
+ *        used when it is the last level of the hierarchy
+ * @return error code
+ */
+int cache_config_set_latency(cache_config_t * cfg, uint16_t hit_latency, uint16_t memory_latency);
+
+//=========================================================================
+/**
+ * @brief Set the number of MSHRs of a cache level, its misses in flight at most
+ *        (L1_CACHE_MSHRS, L2_CACHE_MSHRS or L3_CACHE_MSHRS after cache_config_init()).
+ *        They only matter to hierarchies timed by a core clock (see cache_timing_t).
+ *
+ * @param cfg (modified) the configuration to update
+ * @param mshrs the number of MSHRs, between 1 (a blocking level) and CACHE_MAX_MSHRS
+ * @return error code
+ */
+int cache_config_set_mshrs(cache_config_t * cfg, uint8_t mshrs);
+
+//=========================================================================
+/**
+ * @brief Give a cache a way predictor (none after cache_config_init(); see
+ *        cache_way_memo_t). Its demand lookups then check the predicted way before
+ *        scanning the set, and its stats count how often the prediction was right.
+ *        Changes cache_size(): call it before allocating.
+ *
+ * @param cfg (modified) the configuration to update
+ * @param enable 1 to predict ways, 0 not to
+ * @return error code
+ */
+int cache_config_set_way_prediction(cache_config_t * cfg, int enable);
+
+//=========================================================================
+/**
+ * @brief Force the instruction set of the SoA probe (CACHE_SIMD_AUTO after
+ *        cache_config_init() and cache_config_set_layout()). Has no effect
+ *        on the AoS layout.
+ *
+ * @param cfg (modified) the configuration to update
+ * @param simd the instruction set, which the host must support
+ * @return error code (ERR_BAD_PARAMETER for an unsupported instruction set)
+ */
+int cache_config_set_simd(cache_config_t * cfg, cache_simd_t simd);
+
+//=========================================================================
+/**
+ * @brief Number of bytes to allocate for a cache of the given geometry. They must be
+ *        zeroed (e.g. with calloc()): an all-zero cache is empty.
+ *
+ * @param cfg the cache configuration
+ * @return the size in bytes, 0 if cfg is NULL
+ */
+size_t cache_size(const cache_config_t * cfg);
+
 //=========================================================================
 /**
  * @brief Clean a cache (invalidate, reset...).
  *
- * This function erases all cache data.
+ * This function erases all cache data, but not the statistics (see cache_reset_stats()).
+ * It takes constant time: it starts a new flush epoch, and each set is emptied when it is
+ * next used (see cache_set_current() in cache.h).
  * @param cache pointer to the cache
- * @param cache_type an enum to distinguish between different caches
+ * @param cfg the cache configuration
  * @return error code
  */
-int cache_flush(void *cache, cache_t cache_type);
+int cache_flush(void *cache, const cache_config_t * cfg);
+
+//=========================================================================
+/**
+ * @brief Write all the dirty lines of a cache to memory; they stay valid and become clean.
+ *        Call it before cache_flush() on a write-back cache not to lose its stores.
+ *        The copies of these lines in the levels below are left as they are: use
+ *        cache_sim_writeback() for a whole hierarchy.
+ *
+ * @param mem_space starting address of the memory space
+ * @param cache pointer to the cache
+ * @param cfg the cache configuration
+ * @return error code
+ */
+int cache_writeback(void * mem_space, void * cache, const cache_config_t * cfg);
+
+//=========================================================================
+/**
+ * @brief Write all the dirty lines of a hierarchy down, from L1 to memory. All the
+ *        lines stay valid and become clean, and memory gets the newest data.
+ *
+ * @param sim the hierarchy (see cache_sim_t)
+ * @return error code
+ */
+int cache_sim_writeback(const cache_sim_t * sim);
 
 //=========================================================================
 /**
@@ -46,21 +342,21 @@ int cache_flush(void *cache, cache_t cache_type);
  *
  * @param mem_space starting address of the memory space
  * @param cache pointer to the beginning of the cache
+ * @param cfg the cache configuration
  * @param paddr pointer to physical address
  * @param p_line pointer to a cache-line-size chunk of data to return
  * @param hit_way (modified) cache way where hit was detected, HIT_WAY_MISS on miss
  * @param hit_index (modified) cache line index where hit was detected, HIT_INDEX_MISS on miss
- * @param cache_type to distinguish between different caches
  * @return error code
  */
 
 int cache_hit (const void * mem_space,
                void * cache,
+               const cache_config_t * cfg,
                phy_addr_t * paddr,
                const uint32_t ** p_line,
                uint8_t *hit_way,
-               uint16_t *hit_index,
-               cache_t cache_type);
+               uint16_t *hit_index);
 
 //=========================================================================
 /**
@@ -70,14 +366,14 @@ int cache_hit (const void * mem_space,
  * @param cache_way the number of the way where to insert
  * @param cache_line_in pointer to the cache line to insert
  * @param cache pointer to the cache
- * @param cache_type to distinguish between different caches
+ * @param cfg the cache configuration
  * @return error code
  */
 int cache_insert(uint16_t cache_line_index,
                  uint8_t cache_way,
                  const void * cache_line_in,
                  void * cache,
-                 cache_t cache_type);
+                 const cache_config_t * cfg);
 
 //=========================================================================
 /**
@@ -86,13 +382,13 @@ int cache_insert(uint16_t cache_line_index,
  * @param mem_space starting address of the memory space
  * @param paddr pointer to physical address, to extract the tag
  * @param cache_entry pointer to the entry to be initialized
- * @param cache_type to distinguish between different caches
+ * @param cfg the configuration of the cache the entry is meant for
  * @return error code
  */
 int cache_entry_init(const void * mem_space,
                      const phy_addr_t * paddr,
                      void * cache_entry,
-                     cache_t cache_type);
+                     const cache_config_t * cfg);
 
 //=========================================================================
 /**
@@ -108,23 +404,30 @@ int cache_entry_init(const void * mem_space,
  *      behaves like a victim cache. If the block is not found neither in L1 nor
  *      in L2, then it is fetched from main memory and placed just in L1 and not
  *      in L2.
+ *  This is the default, see cache_config_set_inclusion() for the others.
+ *
+ * Both levels must have the same line size. A read may write back to memory
+ * a dirty line leaving the hierarchy (see cache_write_t). See cache_access_batch()
+ * for a hierarchy with an L3.
  *
  * @param mem_space pointer to the memory space
  * @param paddr pointer to a physical address
  * @param access to distinguish between fetching instructions and reading/writing data
  * @param l1_cache pointer to the beginning of L1 CACHE
+ * @param l1_cfg configuration of L1 CACHE
  * @param l2_cache pointer to the beginning of L2 CACHE
+ * @param l2_cfg configuration of L2 CACHE
  * @param word pointer to the word of data that is returned by cache
- * @param replace replacement policy
  * @return error code
  */
-int cache_read(const void * mem_space,
+int cache_read(void * mem_space,
                phy_addr_t * paddr,
                mem_access_t access,
                void * l1_cache,
+               const cache_config_t * l1_cfg,
                void * l2_cache,
-               uint32_t * word,
-               cache_replace_t replace);
+               const cache_config_t * l2_cfg,
+               uint32_t * word);
 
 //=========================================================================
 /**
@@ -134,18 +437,20 @@ int cache_read(const void * mem_space,
  * @param p_addr pointer to a physical address
  * @param access to distinguish between fetching instructions and reading/writing data
  * @param l1_cache pointer to the beginning of L1 CACHE
+ * @param l1_cfg configuration of L1 CACHE
  * @param l2_cache pointer to the beginning of L2 CACHE
+ * @param l2_cfg configuration of L2 CACHE
  * @param byte pointer to the byte to be returned
- * @param replace replacement policy
  * @return error code
  */
-int cache_read_byte(const void * mem_space,
+int cache_read_byte(void * mem_space,
                     phy_addr_t * p_paddr,
                     mem_access_t access,
                     void * l1_cache,
+                    const cache_config_t * l1_cfg,
                     void * l2_cache,
-                    uint8_t * p_byte,
-                    cache_replace_t replace);
+                    const cache_config_t * l2_cfg,
+                    uint8_t * p_byte);
 
 //=========================================================================
 /**
@@ -155,43 +460,207 @@ int cache_read_byte(const void * mem_space,
  * @param mem_space pointer to the memory space
  * @param paddr pointer to a physical address
  * @param l1_cache pointer to the beginning of L1 CACHE
+ * @param l1_cfg configuration of L1 CACHE
  * @param l2_cache pointer to the beginning of L2 CACHE
+ * @param l2_cfg configuration of L2 CACHE
  * @param word const pointer to the word of data that is to be written to the cache
- * @param replace replacement policy
  * @return error code
  */
 int cache_write(void * mem_space,
                 phy_addr_t * paddr,
                 void * l1_cache,
+                const cache_config_t * l1_cfg,
                 void * l2_cache,
-                const uint32_t * word,
-                cache_replace_t replace);
+                const cache_config_t * l2_cfg,
+                const uint32_t * word);
 
 //=========================================================================
 /**
  * @brief Write to cache a byte of data. Endianess: LITTLE.
+ *        One write access of the line: the other bytes of its word are kept as they are.
+ *        (Halfwords and other small stores: see cache_write_range.)
  *
  * @param mem_space pointer to the memory space
  * @param paddr pointer to a physical address
- * @param l1_cache pointer to the beginning of L1 ICACHE
+ * @param l1_cache pointer to the beginning of L1 DCACHE
+ * @param l1_cfg configuration of L1 DCACHE
  * @param l2_cache pointer to the beginning of L2 CACHE
- * @param p_byte pointer to the byte to be returned
- * @param replace replacement policy
+ * @param l2_cfg configuration of L2 CACHE
+ * @param p_byte the byte to be written
  * @return error code
  */
 int cache_write_byte(void * mem_space,
                      phy_addr_t * paddr,
                      void * l1_cache,
+                     const cache_config_t * l1_cfg,
                      void * l2_cache,
-                     uint8_t p_byte,
-                     cache_replace_t replace);
+                     const cache_config_t * l2_cfg,
+                     uint8_t p_byte);
+
+//=========================================================================
+/**
+ * @brief Ask cache for a span of bytes, which may be unaligned and cross lines but
+ *        not pages. Each line of the span is accessed once and copied from directly,
+ *        so a 16-byte load is one access of each line it touches, not four word reads.
+ *
+ * @param mem_space pointer to the memory space
+ * @param paddr pointer to the physical address of the first byte
+ * @param access to distinguish between fetching instructions and reading/writing data
+ * @param l1_cache pointer to the beginning of L1 CACHE
+ * @param l1_cfg configuration of L1 CACHE
+ * @param l2_cache pointer to the beginning of L2 CACHE
+ * @param l2_cfg configuration of L2 CACHE
+ * @param bytes (modified) the n bytes read
+ * @param n number of bytes
+ * @return error code
+ */
+int cache_read_range(void * mem_space,
+                     phy_addr_t * paddr,
+                     mem_access_t access,
+                     void * l1_cache,
+                     const cache_config_t * l1_cfg,
+                     void * l2_cache,
+                     const cache_config_t * l2_cfg,
+                     uint8_t * bytes,
+                     size_t n);
+
+//=========================================================================
+/**
+ * @brief Write to cache a span of bytes, which may be unaligned and cross lines but
+ *        not pages. Each line of the span is accessed once and copied into directly.
+ *
+ * @param mem_space pointer to the memory space
+ * @param paddr pointer to the physical address of the first byte
+ * @param l1_cache pointer to the beginning of L1 DCACHE
+ * @param l1_cfg configuration of L1 DCACHE
+ * @param l2_cache pointer to the beginning of L2 CACHE
+ * @param l2_cfg configuration of L2 CACHE
+ * @param bytes the n bytes to write
+ * @param n number of bytes
+ * @return error code
+ */
+int cache_write_range(void * mem_space,
+                      phy_addr_t * paddr,
+                      void * l1_cache,
+                      const cache_config_t * l1_cfg,
+                      void * l2_cache,
+                      const cache_config_t * l2_cfg,
+                      const uint8_t * bytes,
+                      size_t n);
+
+//=========================================================================
+/**
+ * @brief Run a block of accesses, in order, as the single-access functions would.
+ *
+ * The arguments are checked once for the whole block instead of once per access.
+ * An L2 miss goes to the L3 of sim, if any, before memory.
+ *
+ * @param sim the hierarchy to access
+ * @param addrs the physical address of each access
+ * @param ops the operation of each access (see enum cache_op)
+ * @param n number of accesses
+ * @param out for reads, (modified) the word or byte read; for writes, the word
+ *        or byte (in the low 8 bits) to write (see enum cache_op for ranges)
+ * @return error code; on an unknown operation or a range crossing a page, the accesses
+ *         before it have been done
+ */
+int cache_access_batch(const cache_sim_t * sim,
+                       const phy_addr_t * addrs,
+                       const uint8_t * ops,
+                       size_t n,
+                       word_t * out);
+
+//=========================================================================
+/**
+ * @brief Run a block of accesses, in order, on a multi-core hierarchy: each core has
+ *        its own L1 caches and L2, and they share the L3 (if any) and memory.
+ *
+ * The private levels are kept coherent with MESI (see cache_mesi_t), by snooping the
+ * other cores: a miss of all the private levels of a core downgrades the copies of
+ * the others to shared (a modified one is written down first, a cache-to-cache
+ * transfer), a write invalidates them. An inclusive L3 back-invalidates all the cores.
+ *
+ * @param cores the private hierarchy of each core, all with the same memory space and L3
+ * @param nb_cores number of cores, at most CACHE_MAX_CORES
+ * @param coherence (modified) the coherence counters of each core, added to
+ * @param core_ids the core issuing each access
+ * @param addrs, ops, n, out: see cache_access_batch()
+ * @return error code; on an unknown operation or core, the accesses before it have been done
+ */
+int cache_cores_access_batch(const cache_sim_t * cores,
+                             uint8_t nb_cores,
+                             cache_coherence_stats_t * coherence,
+                             const uint8_t * core_ids,
+                             const phy_addr_t * addrs,
+                             const uint8_t * ops,
+                             size_t n,
+                             word_t * out);
 
 //=========================================================================
 /**
  * @brief Print the contents of a cache to a stream.
  * @param output the stream to print to.
  * @param cache pointer to the cache
- * @param cache_type to distinguish between different caches
+ * @param cfg the cache configuration
+ * @return error code
+ */
+int cache_dump(FILE* output, const void* cache, const cache_config_t * cfg);
+
+//=========================================================================
+/**
+ * @brief Get the event counters of a cache level. They are counted from the
+ *        allocation of the cache (which must be zeroed) or the last cache_reset_stats().
+ *
+ * @param cache pointer to the cache
+ * @param cfg the cache configuration
+ * @param stats (modified) the counters
+ * @return error code
+ */
+int cache_get_stats(const void * cache, const cache_config_t * cfg, cache_stats_t * stats);
+
+//=========================================================================
+/**
+ * @brief Set the event counters of a cache level to 0.
+ *
+ * @param cache pointer to the cache
+ * @param cfg the cache configuration
+ * @return error code
+ */
+int cache_reset_stats(void * cache, const cache_config_t * cfg);
+
+//=========================================================================
+/**
+ * @brief Print the event counters of a cache level, with its miss ratios, to a stream.
+ *
+ * @param output the stream to print to
+ * @param cache pointer to the cache
+ * @param cfg the cache configuration
+ * @return error code
+ */
+int cache_stats_dump(FILE * output, const void * cache, const cache_config_t * cfg);
+
+//=========================================================================
+/**
+ * @brief Print the coherence counters of a core to a stream.
+ *
+ * @param output the stream to print to
+ * @param core the core number, for the label
+ * @param coherence the counters
+ * @return error code
+ */
+int cache_coherence_stats_dump(FILE * output, uint8_t core, const cache_coherence_stats_t * coherence);
+
+//=========================================================================
+/**
+ * @brief Print the latency report of a hierarchy to a stream: for each L1 cache,
+ *        then both, the demand accesses, their total cycles and average memory
+ *        access time (AMAT), and for each L1 cache the histogram of the latencies.
+ *        With a core clock (see cache_timing_t), also the secondary misses and
+ *        MSHR waits of each level, the cycles of the run, the issue stalls and the
+ *        memory-level parallelism (MLP: L1 misses in flight on average, when any is).
+ *
+ * @param output the stream to print to
+ * @param sim the hierarchy (see cache_sim_t)
  * @return error code
  */
-int cache_dump(FILE* output, const void* cache, cache_t cache_type);
+int cache_sim_latency_dump(FILE * output, const cache_sim_t * sim);
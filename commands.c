@@ -36,6 +36,32 @@ int program_read(const char* filename, program_t* program){
             fscanf(open,"%c",&currentChar);
         }
 
+//============================OPTIONAL CORE ID (C<n>), CORE 0 IF THERE IS NONE=================
+        currentCommand.core = 0;
+        if(currentChar == 'C'){
+            unsigned int core = 0;
+            if(fscanf(open, "%u", &core) != 1 || core > UINT8_MAX) return ERR_BAD_PARAMETER;
+            currentCommand.core = (uint8_t) core;
+
+            fscanf(open, "%c", &currentChar);
+            if(!isspace(currentChar)) return ERR_BAD_PARAMETER;
+            while(isspace(currentChar)){
+                fscanf(open,"%c",&currentChar);
+            }
+        }
+
+//============================OPTIONAL DEPENDENCE MARK (D) ON THE PREVIOUS READ=================
+        currentCommand.dependent = 0;
+        if(currentChar == 'D'){
+            currentCommand.dependent = 1;
+
+            fscanf(open, "%c", &currentChar);
+            if(!isspace(currentChar)) return ERR_BAD_PARAMETER;
+            while(isspace(currentChar)){
+                fscanf(open,"%c",&currentChar);
+            }
+        }
+
 //============================CHECK IF WE ARE IN A READ OR WRITE=================================
         if(currentChar != 'W' && currentChar != 'R') return ERR_BAD_PARAMETER;
         else currentCommand.order = (currentChar == 'W') ? WRITE : READ;
@@ -58,11 +84,17 @@ int program_read(const char* filename, program_t* program){
             if(currentChar == 'D'){
                 currentCommand.type = DATA;
 
-                //Check if type of data is Word(size 4) or Byte and add it to the command
+                //Check if type of data is Word(size 4) or Byte, or a number of bytes (8, 16 or 32), and add it to the command
                 fscanf(open, "%c", &currentChar);
                 if(currentChar == 'W' || currentChar == 'B') {
                     currentCommand.data_size = (currentChar == 'B') ? 1 : sizeof(word_t);
                 }
+                else if(isdigit(currentChar)) {
+                    unsigned int size = 0;
+                    ungetc(currentChar, open);
+                    if(fscanf(open, "%u", &size) != 1 || (size != 8 && size != 16 && size != 32)) return ERR_BAD_PARAMETER;
+                    currentCommand.data_size = size;
+                }
                 else return ERR_BAD_PARAMETER;
             }
             else return ERR_BAD_PARAMETER;
@@ -167,7 +199,9 @@ int program_print(FILE* file, const program_t* program){
         
         //DATA_SIZE
         size_t size = line->data_size;
-        char data_size = (size == 1) ? 'B' : 'W';
+        char data_size[4] = "W";
+        if(size == 1) data_size[0] = 'B';
+        else if(size > sizeof(word_t)) snprintf(data_size, sizeof(data_size), "%u", (uint8_t) size);
 
         //VADDR
         uint64_t vaddr = virt_addr_t_to_uint64_t(&line->vaddr);
@@ -175,16 +209,24 @@ int program_print(FILE* file, const program_t* program){
         //WRITE_DATA
         int charErr = 0;
 
+        //CORE, ONLY PRINTED IF IT IS NOT THE DEFAULT ONE
+        if(line->core != 0 && fprintf(file, "C%" PRIu8 " ", line->core) < 0){
+            return _IO_ERR_SEEN;
+        }
+        if(line->dependent && fputs("D ", file) < 0){
+            return _IO_ERR_SEEN;
+        }
+
         //Depending of the type of command (read instrcution, write data etc...) print the appropriate thing
         if(type == 'I'){ 
             charErr = fprintf(file, "%c " "%c " "@0x%016"PRIX64 "\n",order, type, vaddr);
         }
         else if (order == 'R'){
-            charErr = fprintf(file, "%c " "%c%c " "@0x%016"PRIX64 "\n",order, type, data_size, vaddr);
+            charErr = fprintf(file, "%c " "%c%s " "@0x%016"PRIX64 "\n",order, type, data_size, vaddr);
         }
-        else if (order == 'W' && data_size == 'B'){
-            charErr = fprintf(file, "%c " "%c" "%c " "0x%02"PRIX32 " @0x%016"PRIX64 "\n",order, type ,data_size,line->write_data, vaddr);
-        } else charErr = fprintf(file, "%c " "%c" "%c " "0x%08"PRIX32 " @0x%016"PRIX64 "\n",order, type ,data_size,line->write_data, vaddr); 
+        else if (order == 'W' && size == 1){
+            charErr = fprintf(file, "%c " "%c" "%s " "0x%02"PRIX32 " @0x%016"PRIX64 "\n",order, type ,data_size,line->write_data, vaddr);
+        } else charErr = fprintf(file, "%c " "%c" "%s " "0x%08"PRIX32 " @0x%016"PRIX64 "\n",order, type ,data_size,line->write_data, vaddr); 
 
         //Check that prnting has been corretly executed
         if(charErr < 0){
@@ -235,8 +277,8 @@ int program_add_command(program_t* program, const command_t* command){
                 return ERR_BAD_PARAMETER;
             }
 
-            // Un test pour vérifier que write_data ne dépasse pas la taille maximale (0xff) lors d'un WRITE
-            if (command->order == WRITE) {
+            // Un test pour vérifier que write_data ne dépasse pas la taille maximale (0xff) lors d'un WRITE d'un byte
+            if (command->order == WRITE && command->data_size == 1) {
                 if(command->write_data > 0xff) {
                     return ERR_BAD_PARAMETER;
                 }
@@ -18,9 +18,11 @@ typedef enum command_word_type command_word_t;
 
 typedef struct{
 
+    uint8_t core; // core issuing the command (optional "C<n>" prefix, 0 by default)
+    uint8_t dependent; // its address comes from the data of the previous read (optional "D" prefix)
     command_word_t order;
     mem_access_t type;
-    size_t data_size;
+    size_t data_size; // bytes: 1, 4, 8, 16 or 32 for data, 0 for instructions
     word_t write_data;
     virt_addr_t vaddr;
 
@@ -81,6 +83,11 @@ int program_print(FILE* output, const program_t* program);
 
 /**
  * @brief Read a program (list of commands) from a file.
+ * A command may start with the core issuing it, e.g. "C1 W DW 0x00000001 @0x...";
+ * without one it is issued by core 0. A "D" before the order marks a command whose
+ * address depends on the previous read, e.g. "D R DW @0x..." when chasing pointers.
+ * Besides bytes (DB) and words (DW), data accesses may span 8, 16 or 32 bytes
+ * (D8, D16, D32, e.g. "R D16 @0x..."); such a write stores its word repeated.
  * @param filename the name of the file to read from.
  * @param program the program to be filled from file.
  * @return ERR_NONE if ok, appropriate error code otherwise.
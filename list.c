@@ -302,7 +302,7 @@ int print_list(FILE* stream, const list_t* this){
             M_REQUIRE(print == 1, ERR_BAD_PARAMETER,"%s", "the fprintf return a bad value");
         } else {
             print = fprintf(stream, ", ");
-            M_REQUIRE(print == 1, ERR_BAD_PARAMETER,"%s", "the fprintf return a bad value");
+            M_REQUIRE(print == 2, ERR_BAD_PARAMETER,"%s", "the fprintf return a bad value");
         }
     }
 
@@ -331,11 +331,237 @@ int print_reverse_list(FILE* stream, const list_t* this){
 
         } else {
             print = fprintf(stream, ", ");
-            M_REQUIRE(print == 1, ERR_BAD_PARAMETER,"%s", "the fprintf return a bad value");
+            M_REQUIRE(print == 2, ERR_BAD_PARAMETER,"%s", "the fprintf return a bad value");
+
+        }
+    }
+
+    return counter;
+
+}
+
+//=========================================================================
+// Fixed-capacity lists, in an array of nodes
+
+int init_array_list(array_list_t* this, array_node_t* nodes, size_t capacity){
+
+    M_REQUIRE_NON_NULL(this);
+    M_REQUIRE_NON_NULL(nodes);
+    M_REQUIRE(capacity > 0 && capacity <= ARRAY_LIST_MAX_CAPACITY, ERR_SIZE, "%s", "The capacity is not in the bound");
+
+    this->nodes = nodes;
+    this->capacity = (array_index_t) capacity;
+    clear_array_list(this);
+
+    return ERR_NONE;
+}
+
+
+int is_empty_array_list(const array_list_t* this){
+
+    M_REQUIRE_NON_NULL(this);
+
+    if(this->back == ARRAY_LIST_NONE && this->front == ARRAY_LIST_NONE){
+        return 1;
+    }
+    else if(this->back == ARRAY_LIST_NONE || this->front == ARRAY_LIST_NONE){
+        return ERR_BAD_PARAMETER;
+    }
+    else{
+        return 0;
+    }
+}
+
+
+void clear_array_list(array_list_t* this){
+
+    if(this != NULL){
+
+        //Chain all the nodes, first to last, as free ones
+        for(array_index_t i = 0; i < this->capacity; i++){
+            this->nodes[i].value = 0;
+            this->nodes[i].previous = ARRAY_LIST_NONE;
+            this->nodes[i].next = i + 1 < this->capacity ? (array_index_t) (i + 1) : ARRAY_LIST_NONE;
+        }
+        this->free = 0;
+        this->front = ARRAY_LIST_NONE;
+        this->back = ARRAY_LIST_NONE;
+    }
+}
+
+
+//Take the first free node, NULL if the list is full
+static array_node_t* array_take_free(array_list_t* this, const list_content_t* value){
+
+    if(this->free == ARRAY_LIST_NONE){
+        return NULL;
+    }
+    array_node_t* added = &this->nodes[this->free];
+    this->free = added->next;
+    added->value = *value;
+    return added;
+}
+
+
+//Give back an unlinked node to the free ones
+static void array_give_free(array_list_t* this, array_index_t index){
+
+    this->nodes[index].value = 0;
+    this->nodes[index].previous = ARRAY_LIST_NONE;
+    this->nodes[index].next = this->free;
+    this->free = index;
+}
+
+
+array_node_t* array_push_back(array_list_t* this, const list_content_t* value){
+
+    M_REQUIRE_NON_NULL_CUSTOM_ERR(this, NULL);
+    M_REQUIRE_NON_NULL_CUSTOM_ERR(value, NULL);
+
+    array_node_t* added = array_take_free(this, value);
+    if(added == NULL){
+        return NULL;
+    }
+    const array_index_t index = (array_index_t) (added - this->nodes);
+
+    added->next = ARRAY_LIST_NONE;
+    added->previous = this->back;
+    // CASE OF EMPTY LIST
+    if(this->back == ARRAY_LIST_NONE){
+        this->front = index;
+    } else {
+        this->nodes[this->back].next = index;
+    }
+    this->back = index;
+
+    return added;
+}
+
+
+array_node_t* array_push_front(array_list_t* this, const list_content_t* value){
+
+    M_REQUIRE_NON_NULL_CUSTOM_ERR(this, NULL);
+    M_REQUIRE_NON_NULL_CUSTOM_ERR(value, NULL);
 
+    array_node_t* added = array_take_free(this, value);
+    if(added == NULL){
+        return NULL;
+    }
+    const array_index_t index = (array_index_t) (added - this->nodes);
+
+    added->previous = ARRAY_LIST_NONE;
+    added->next = this->front;
+    // CASE OF EMPTY LIST
+    if(this->front == ARRAY_LIST_NONE){
+        this->back = index;
+    } else {
+        this->nodes[this->front].previous = index;
+    }
+    this->front = index;
+
+    return added;
+}
+
+
+void array_pop_front(array_list_t* this){
+
+    if(this != NULL && this->front != ARRAY_LIST_NONE){
+
+        const array_index_t old_front = this->front;
+        this->front = this->nodes[old_front].next;
+        // CASE OF A SINGLE NODE
+        if(this->front == ARRAY_LIST_NONE){
+            this->back = ARRAY_LIST_NONE;
+        } else {
+            this->nodes[this->front].previous = ARRAY_LIST_NONE;
         }
+        array_give_free(this, old_front);
+    }
+}
+
+
+void array_pop_back(array_list_t* this){
+
+    if(this != NULL && this->back != ARRAY_LIST_NONE){
+
+        const array_index_t old_back = this->back;
+        this->back = this->nodes[old_back].previous;
+        // CASE OF A SINGLE NODE
+        if(this->back == ARRAY_LIST_NONE){
+            this->front = ARRAY_LIST_NONE;
+        } else {
+            this->nodes[this->back].next = ARRAY_LIST_NONE;
+        }
+        array_give_free(this, old_back);
+    }
+}
+
+
+void array_move_back(array_list_t* this, array_node_t* node){
+
+    //Nothing to do if the node is already the last one (or the list is empty)
+    if(this == NULL || node == NULL || node->next == ARRAY_LIST_NONE){
+        return;
+    }
+
+    const array_index_t index = (array_index_t) (node - this->nodes);
+
+    //Unlink the node (it has a next one)
+    if(node->previous == ARRAY_LIST_NONE){
+        this->front = node->next;
+    } else {
+        this->nodes[node->previous].next = node->next;
+    }
+    this->nodes[node->next].previous = node->previous;
+
+    //Link it at the end
+    node->previous = this->back;
+    node->next = ARRAY_LIST_NONE;
+    this->nodes[this->back].next = index;
+    this->back = index;
+}
+
+
+int print_array_list(FILE* stream, const array_list_t* this){
+
+    M_REQUIRE_NON_NULL(this);
+    M_REQUIRE_NON_NULL_CUSTOM_ERR(stream,ERR_IO);
+
+    int counter = 0;
+
+    int print = fprintf(stream, "(");
+    M_REQUIRE(print == 1, ERR_BAD_PARAMETER,"%s", "the fprintf return a bad value");
+
+    for_all_array_nodes(current, this){
+        counter += 1;
+        print_node(stream, current->value);
+
+        //Close the brackets when we reach the last node, otherwise print a separation
+        print = fputs(current->next == ARRAY_LIST_NONE ? ")" : ", ", stream);
+        M_REQUIRE(print >= 0, ERR_BAD_PARAMETER,"%s", "the fputs return a bad value");
     }
 
     return counter;
+}
+
 
-}
\ No newline at end of file
+int print_reverse_array_list(FILE* stream, const array_list_t* this){
+
+    M_REQUIRE_NON_NULL(this);
+    M_REQUIRE_NON_NULL_CUSTOM_ERR(stream,ERR_IO);
+
+    int counter = 0;
+
+    int print = fprintf(stream, "(");
+    M_REQUIRE(print == 1, ERR_BAD_PARAMETER,"%s", "the fprintf return a bad value");
+
+    for_all_array_nodes_reverse(current, this){
+        counter += 1;
+        print_node(stream, current->value);
+
+        print = fputs(current->previous == ARRAY_LIST_NONE ? ")" : ", ", stream);
+        M_REQUIRE(print >= 0, ERR_BAD_PARAMETER,"%s", "the fputs return a bad value");
+    }
+
+    return counter;
+}
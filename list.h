@@ -123,3 +123,118 @@ int print_reverse_list(FILE* stream, const list_t* this);
  */
 #define for_all_nodes(X, L)         for (node_t* X = (L)->front; X != NULL; X = X->next    )
 #define for_all_nodes_reverse(X, L) for (node_t* X = (L)->back ; X != NULL; X = X->previous)
+
+
+/**
+ * @brief Fixed-capacity doubly linked lists, stored in one array of nodes given by the
+ * caller and linked by 16-bit indices: no operation allocates, and the bookkeeping of
+ * a list of a few hundred nodes stays within a few host cache lines. The nodes that are
+ * not in the list are chained through their next index, and reused first to last.
+ * Same operations as the lists above, with array in their names.
+ *
+ */
+typedef uint16_t array_index_t;
+#define ARRAY_LIST_NONE         UINT16_MAX
+#define ARRAY_LIST_MAX_CAPACITY UINT16_MAX // ARRAY_LIST_NONE is not a node
+
+typedef struct {
+    list_content_t value;
+    array_index_t previous;
+    array_index_t next;
+} array_node_t;
+
+typedef struct {
+    array_node_t* nodes;
+    array_index_t capacity;
+    array_index_t front;
+    array_index_t back;
+    array_index_t free; // first node not in the list
+} array_list_t;
+
+/**
+ * @brief node of an array list at an index, NULL for ARRAY_LIST_NONE
+ */
+#define array_list_at(L, I) ((I) == ARRAY_LIST_NONE ? NULL : &(L)->nodes[I])
+
+/**
+ * @brief initialize an array list to the empty list
+ * @param this list to initialize
+ * @param nodes the storage of the list, of capacity nodes
+ * @param capacity the maximal number of values, at most ARRAY_LIST_MAX_CAPACITY
+ * @return error code (ERR_SIZE for a bad capacity)
+ */
+int init_array_list(array_list_t* this, array_node_t* nodes, size_t capacity);
+
+/**
+ * @brief check whether an array list is empty or not
+ * @param this list to check
+ * @return 0 if the list is (well-formed and) not empty
+ */
+int is_empty_array_list(const array_list_t* this);
+
+/**
+ * @brief clear the whole array list (make it empty)
+ * @param this list to clear
+ */
+void clear_array_list(array_list_t* this);
+
+/**
+ * @brief add a new value at the end of an array list
+ * @param this list where to add to
+ * @param value value to be added
+ * @return a pointer to the newly inserted element or NULL in case of error (or if full)
+ */
+array_node_t* array_push_back(array_list_t* this, const list_content_t* value);
+
+/**
+ * @brief add a new value at the begining of an array list
+ * @param this list where to add to
+ * @param value value to be added
+ * @return a pointer to the newly inserted element or NULL in case of error (or if full)
+ */
+array_node_t* array_push_front(array_list_t* this, const list_content_t* value);
+
+/**
+ * @brief remove the last value of an array list
+ * @param this list to remove from
+ */
+void array_pop_back(array_list_t* this);
+
+/**
+ * @brief remove the first value of an array list
+ * @param this list to remove from
+ */
+void array_pop_front(array_list_t* this);
+
+/**
+ * @brief move a node a the end of an array list
+ * @param this list to modify
+ * @param node pointer to the node to be moved, which must be in the list
+ */
+void array_move_back(array_list_t* this, array_node_t* node);
+
+/**
+ * @brief print an array list (on one single line, no newline), as print_list()
+ * @param stream where to print to
+ * @param this the list to be printed
+ * @return number of printed characters
+ */
+int print_array_list(FILE* stream, const array_list_t* this);
+
+/**
+ * @brief print an array list reversed way, as print_reverse_list()
+ * @param stream where to print to
+ * @param this the list to be printed
+ * @return number of printed characters
+ */
+int print_reverse_array_list(FILE* stream, const array_list_t* this);
+
+/**
+ * @brief The loops of for_all_nodes() and for_all_nodes_reverse() over an array list:
+ * X will be of type `array_node_t*` and L has to be of type `array_list_t*`.
+ *
+ */
+#define for_all_array_nodes(X, L) \
+    for (array_node_t* X = array_list_at(L, (L)->front); X != NULL; X = array_list_at(L, X->next))
+#define for_all_array_nodes_reverse(X, L) \
+    for (array_node_t* X = array_list_at(L, (L)->back); X != NULL; X = array_list_at(L, X->previous))
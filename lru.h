@@ -1,13 +1,132 @@
 #pragma once
 
-#define LRU_age_increase(TYPE, WAYS, WAYS_INDEX, LINE_INDEX)\
-foreach_way(i, WAYS)\
-    if(cache_entry(TYPE, WAYS, LINE_INDEX, i)->age <= WAYS-1) cache_entry(TYPE, WAYS, LINE_INDEX, i)->age += 1;\
-cache_entry(TYPE, WAYS, LINE_INDEX, WAYS_INDEX)->age=0;\
+#include <stdint.h>
 
+/*
+ * LRU (and FIFO) ages of sets of at most LRU_PACKED_MAX_WAYS ways are packed in the
+ * per-set state word (see cache_set_state() in cache.h): way w owns bits
+ * [w * age_bits, (w + 1) * age_bits). The ages are the same as in the entries'
+ * age field (which is then unused), so the updates below are exact LRU, done
+ * with a few SWAR operations on the whole set.
+ * Building with -DCACHE_NO_PACKED_LRU keeps them in the entries.
+ */
+#define LRU_PACKED_MAX_WAYS 16
 
-#define LRU_age_update(TYPE, WAYS,WAY_INDEX, LINE_INDEX) \
-int max =(cache_entry(TYPE, WAYS, LINE_INDEX, WAY_INDEX)->age);\
-foreach_way(i,WAYS)\
-    if(cache_entry(TYPE, WAYS, LINE_INDEX, i)->age<max) cache_entry(TYPE, WAYS, LINE_INDEX, i)->age += 1;\
-cache_entry(TYPE, WAYS, LINE_INDEX, WAY_INDEX)->age=0
+/*
+ * The policies (here and in replacement.h) reach the per-entry ages and the per-set
+ * state word through these two accessors, those of the caches by default (cache.h).
+ * Other set-associative structures (the TLBs, see tlb_hrchy.h) define their own
+ * before including this file.
+ */
+#ifndef replacement_age
+#define replacement_age(CFG, CACHE, LINE_INDEX, WAY) cache_age(CFG, CACHE, LINE_INDEX, WAY)
+#endif
+#ifndef replacement_state
+#define replacement_state(CFG, CACHE, LINE_INDEX) cache_set_state(CFG, CACHE, LINE_INDEX)
+#endif
+
+// bits per packed age (ages are below ways)
+#define LRU_AGE_BITS(WAYS) ((WAYS) <= 2 ? 1 : (WAYS) <= 4 ? 2 : (WAYS) <= 8 ? 3 : 4)
+
+// a 1 at the lowest bit of each of the NB lanes of BITS bits
+#define LRU_AGE_LANES(BITS, NB) \
+    (((NB) * (BITS) >= 64 ? ~0ull : (1ull << ((NB) * (BITS))) - 1) / ((1ull << (BITS)) - 1))
+
+#ifdef CACHE_NO_PACKED_LRU
+#define LRU_PACKED_AGE_BITS(POLICY, WAYS) 0
+#else
+#define LRU_PACKED_AGE_BITS(POLICY, WAYS) \
+    (((POLICY) == LRU || (POLICY) == FIFO) && (WAYS) <= LRU_PACKED_MAX_WAYS ? LRU_AGE_BITS(WAYS) : 0)
+#endif
+
+#define LRU_INLINE static inline __attribute__((always_inline))
+
+// age of one way
+LRU_INLINE uint8_t lru_packed_age(uint64_t ages, uint8_t bits, uint8_t way)
+{
+    return (uint8_t) ((ages >> (way * bits)) & ((1u << bits) - 1));
+}
+
+// a 1 at the lowest bit of each lane that is not 0 (LANES: see LRU_AGE_LANES)
+LRU_INLINE uint64_t lru_nonzero_lanes(uint64_t x, uint8_t bits, uint64_t lanes)
+{
+    uint64_t any = x;
+    for (uint8_t i = 1; i < bits; ++i) any |= x >> i;
+    return any & lanes;
+}
+
+// adds 1 to the lanes below M, in a word with one free lane above each used one
+// (GUARDS: the lowest bit of each free lane, EVEN: the lowest bit of each used lane)
+LRU_INLINE uint64_t lru_increment_below(uint64_t x, uint8_t bits, uint64_t even, uint64_t guards, uint8_t m)
+{
+    const uint64_t not_below = ((x | guards) - m * even) & guards;
+    return x + ((~not_below & guards) >> bits);
+}
+
+// LRU_age_increase: the ages below ways - 1 grow, WAY becomes the most recent
+LRU_INLINE uint64_t lru_packed_increase(uint64_t ages, uint8_t bits, uint64_t lanes, uint8_t ways, uint8_t way)
+{
+    ages += lru_nonzero_lanes(ages ^ ((uint64_t) (ways - 1) * lanes), bits, lanes);
+    return ages & ~((((uint64_t) 1 << bits) - 1) << (way * bits));
+}
+
+// LRU_age_update: the ages below the one of WAY grow, WAY becomes the most recent.
+// The even and odd lanes are split so that each has a free lane above it for the borrow.
+LRU_INLINE uint64_t lru_packed_update(uint64_t ages, uint8_t bits, uint64_t lanes, uint8_t ways, uint8_t way)
+{
+    const uint8_t m = lru_packed_age(ages, bits, way);
+    const uint64_t even = LRU_AGE_LANES(2u * bits, (ways + 1u) / 2u);
+    const uint64_t guards = even << bits;
+    const uint64_t field = ((uint64_t) 1 << bits) - 1;
+    const uint64_t all = lanes * field;
+
+    uint64_t lo = lru_increment_below(ages & even * field, bits, even, guards, m);
+    uint64_t hi = lru_increment_below((ages >> bits) & even * field, bits, even, guards, m);
+    ages = (lo | hi << bits) & all;
+    return ages & ~(field << (way * bits));
+}
+
+// LRU_victim: the last way of the oldest age
+LRU_INLINE uint8_t lru_packed_victim(uint64_t ages, uint8_t bits, uint64_t lanes, uint8_t ways)
+{
+    for (int age = ways - 1; age > 0; --age) {
+        const uint64_t equal = lanes & ~lru_nonzero_lanes(ages ^ ((uint64_t) age * lanes), bits, lanes);
+        if (equal != 0) return (uint8_t) ((63 - __builtin_clzll(equal)) / bits);
+    }
+    return (uint8_t) (ways - 1);
+}
+
+//=========================================================================
+// Age of a way, wherever it is stored
+#define LRU_age(CFG, CACHE, WAY_INDEX, LINE_INDEX) \
+    ((CFG)->age_bits \
+        ? lru_packed_age(replacement_state(CFG, CACHE, LINE_INDEX), (CFG)->age_bits, WAY_INDEX) \
+        : replacement_age(CFG, CACHE, LINE_INDEX, WAY_INDEX))
+
+#define LRU_age_increase(CFG, CACHE, WAY_INDEX, LINE_INDEX)\
+do {\
+    const uint8_t ways_ = (CFG)->ways;\
+    if ((CFG)->age_bits) {\
+        uint64_t * ages_ = &replacement_state(CFG, CACHE, LINE_INDEX);\
+        *ages_ = lru_packed_increase(*ages_, (CFG)->age_bits, (CFG)->age_lanes, ways_, WAY_INDEX);\
+        break;\
+    }\
+    for (uint8_t i_ = 0; i_ < ways_; i_++)\
+        if(replacement_age(CFG, CACHE, LINE_INDEX, i_) < ways_ - 1) replacement_age(CFG, CACHE, LINE_INDEX, i_) += 1;\
+    replacement_age(CFG, CACHE, LINE_INDEX, WAY_INDEX) = 0;\
+} while(0)
+
+
+#define LRU_age_update(CFG, CACHE, WAY_INDEX, LINE_INDEX) \
+do {\
+    const uint8_t ways_ = (CFG)->ways;\
+    if ((CFG)->age_bits) {\
+        uint64_t * ages_ = &replacement_state(CFG, CACHE, LINE_INDEX);\
+        *ages_ = lru_packed_update(*ages_, (CFG)->age_bits, (CFG)->age_lanes, ways_, WAY_INDEX);\
+        break;\
+    }\
+    const uint8_t max_ = replacement_age(CFG, CACHE, LINE_INDEX, WAY_INDEX);\
+    for (uint8_t i_ = 0; i_ < ways_; i_++)\
+        if(replacement_age(CFG, CACHE, LINE_INDEX, i_) < max_) replacement_age(CFG, CACHE, LINE_INDEX, i_) += 1;\
+    replacement_age(CFG, CACHE, LINE_INDEX, WAY_INDEX) = 0;\
+} while(0)
@@ -3,6 +3,7 @@
 #include "error.h"
 #include "inttypes.h"
 #include <stdlib.h>
+#include <string.h> // for memset()
 #include "addr_mng.h"
 
 static inline pte_t read_page_entry(const pte_t * start, 
@@ -12,29 +13,174 @@ static inline pte_t read_page_entry(const pte_t * start,
 
 int page_walk(const void* mem_space, const virt_addr_t* vaddr, phy_addr_t* paddr){
 
+    page_size_t page_size = PAGE_4K;
+    return page_walk_sized(mem_space, vaddr, paddr, &page_size);
+}
+
+
+int page_walk_sized(const void* mem_space, const virt_addr_t* vaddr, phy_addr_t* paddr, page_size_t* page_size){
+
+    return page_walk_cached(mem_space, NULL, vaddr, paddr, page_size, NULL);
+}
+
+
+//Indexes of vaddr from the PGD one down to that of the given level: the tag of its cache
+static inline uint64_t pwc_tag(const virt_addr_t* vaddr, pwc_level_t level){
+
+    const uint64_t indexes = ((uint64_t) vaddr->pgd_entry << (PUD_ENTRY + PMD_ENTRY))
+                             | ((uint64_t) vaddr->pud_entry << PMD_ENTRY) | vaddr->pmd_entry;
+    return indexes >> ((PWC_PMD - level) * PMD_ENTRY);
+}
+
+//Set of the cache of a level where a tag is
+static inline pwc_entry_t* pwc_set(page_walk_cache_t* walk_cache, pwc_level_t level, uint64_t tag){
+
+    const uint16_t set = (uint16_t) (tag & (walk_cache->sets[level] - 1u));
+    return &walk_cache->lines[walk_cache->first[level] + (size_t) set * walk_cache->ways[level]];
+}
+
+//Page table the cache of a level maps a tag to, if it has it (the lookup is counted)
+static int pwc_lookup(page_walk_cache_t* walk_cache, pwc_level_t level, uint64_t tag, pte_t* next_table){
+
+    if(walk_cache->entries[level] == 0) return 0;
+
+    pwc_entry_t* set = pwc_set(walk_cache, level, tag);
+    for(uint8_t way = 0; way < walk_cache->ways[level]; way++){
+        if(set[way].v && set[way].tag == tag){
+            set[way].stamp = ++walk_cache->clock;
+            *next_table = set[way].next_table;
+            walk_cache->stats.hits[level]++;
+            return 1;
+        }
+    }
+    walk_cache->stats.misses[level]++;
+    return 0;
+}
+
+//Cache the page table a tag leads to at a level, in place of an invalid or the least recently used entry
+static void pwc_fill(page_walk_cache_t* walk_cache, pwc_level_t level, uint64_t tag, pte_t next_table){
+
+    if(walk_cache->entries[level] == 0) return;
+
+    pwc_entry_t* set = pwc_set(walk_cache, level, tag);
+    pwc_entry_t* victim = &set[0];
+    for(uint8_t way = 0; way < walk_cache->ways[level] && victim->v; way++){
+        if(!set[way].v || set[way].stamp < victim->stamp) victim = &set[way];
+    }
+    victim->tag = tag;
+    victim->next_table = next_table;
+    victim->stamp = ++walk_cache->clock;
+    victim->v = 1;
+}
+
+
+int page_walk_cached(const void* mem_space, page_walk_cache_t* walk_cache, const virt_addr_t* vaddr,
+                     phy_addr_t* paddr, page_size_t* page_size, uint32_t* reads){
+
     M_REQUIRE_NON_NULL(mem_space);
     M_REQUIRE_NON_NULL(vaddr);
     M_REQUIRE_NON_NULL(paddr);
+    M_REQUIRE_NON_NULL(page_size);
+
+    const uint16_t indexes[PAGE_WALK_LEVELS] = {vaddr->pgd_entry, vaddr->pud_entry, vaddr->pmd_entry, vaddr->pte_entry};
+
+    //The walk starts from the deepest page table cached, else from the PGD (at 0)
+    pte_t table = 0;
+    int level = 0;
+    if(walk_cache != NULL){
+        for(int cached = PWC_PMD; cached >= PWC_PGD && level == 0; cached--){
+            if(pwc_lookup(walk_cache, (pwc_level_t) cached, pwc_tag(vaddr, (pwc_level_t) cached), &table)){
+                level = cached + 1;
+            }
+        }
+    }
 
     //Walk through pages
-    pte_t pudTabAddress = read_page_entry(mem_space, 0, vaddr->pgd_entry);
-    M_REQUIRE(pudTabAddress%4096 == 0, ERR_BAD_PARAMETER, "%s", "Address of the page pud is false");
+    uint32_t nb_reads = 0;
+    *page_size = PAGE_4K;
+    for(; level < PAGE_WALK_LEVELS; level++){
+        pte_t entry = read_page_entry(mem_space, table, indexes[level]);
+        nb_reads++;
 
-    pte_t pmdTabAddress = read_page_entry(mem_space, pudTabAddress, vaddr->pud_entry);
-    M_REQUIRE(pmdTabAddress%4096 == 0, ERR_BAD_PARAMETER, "%s", "Address of the page pmd is false");
+        //CASE HUGE PAGE: A PUD (1 GiB) OR PMD (2 MiB) ENTRY MAPS IT, THE LOWER INDEXES ARE PART OF THE OFFSET IN IT
+        if((level == 1 || level == 2) && (entry & PTE_PAGE_SIZE_FLAG)){
+            *page_size = level == 1 ? PAGE_1G : PAGE_2M;
+            table = entry & ~(pte_t) PTE_PAGE_SIZE_FLAG;
+            M_REQUIRE(table % (level == 1 ? HUGE_PAGE_1G_SIZE : HUGE_PAGE_2M_SIZE) == 0, ERR_BAD_PARAMETER, "%s",
+                      level == 1 ? "Address of the 1 GiB page is false" : "Address of the 2 MiB page is false");
+            const uint64_t virt_page_num = virt_addr_t_to_virtual_page_number(vaddr);
+            table += (pte_t) (virt_page_num & ((1u << page_size_shift(*page_size)) - 1)) << PAGE_OFFSET;
+            break;
+        }
+        M_REQUIRE(entry%4096 == 0, ERR_BAD_PARAMETER, "Address of the page read at level %d (PGD = 0) is false", level);
 
-    pte_t pteTabAddress = read_page_entry(mem_space, pmdTabAddress, vaddr->pmd_entry);
-    M_REQUIRE(pteTabAddress%4096 == 0, ERR_BAD_PARAMETER, "%s", "Address of the page pte is false");
+        //The page tables the walk goes through are cached (the physical page is not)
+        if(walk_cache != NULL && level < NB_PWC_LEVELS){
+            pwc_fill(walk_cache, (pwc_level_t) level, pwc_tag(vaddr, (pwc_level_t) level), entry);
+        }
+        table = entry;
+    }
 
-    pte_t physical = read_page_entry(mem_space, pteTabAddress, vaddr->pte_entry);
-    M_REQUIRE(physical%4096 == 0, ERR_BAD_PARAMETER, "%s", "Address of the physcal page is false");
+    if(walk_cache != NULL){
+        walk_cache->stats.walks++;
+        walk_cache->stats.walks_by_reads[nb_reads]++;
+    }
+    if(reads != NULL) *reads = nb_reads;
 
     //Init physical address (+ no need to check the return value because we actually directly return it)
-    return init_phy_addr(paddr, physical, vaddr->page_offset);
+    return init_phy_addr(paddr, table, vaddr->page_offset);
     
 }
 
 
+size_t page_walk_cache_size(const uint16_t entries[NB_PWC_LEVELS]){
+
+    size_t lines = 0;
+    for(pwc_level_t level = PWC_PGD; entries != NULL && level < NB_PWC_LEVELS; level++){
+        lines += entries[level];
+    }
+    return sizeof(page_walk_cache_t) + lines * sizeof(pwc_entry_t);
+}
+
+
+int page_walk_cache_init(page_walk_cache_t* walk_cache, const uint16_t entries[NB_PWC_LEVELS],
+                         const uint8_t ways[NB_PWC_LEVELS]){
+
+    M_REQUIRE_NON_NULL(walk_cache);
+    M_REQUIRE_NON_NULL(entries);
+    M_REQUIRE_NON_NULL(ways);
+
+    size_t first = 0;
+    for(pwc_level_t level = PWC_PGD; level < NB_PWC_LEVELS; level++){
+        const uint16_t sets = entries[level] == 0 ? 0 : (uint16_t) (entries[level] / (ways[level] ? ways[level] : 1));
+        M_REQUIRE(entries[level] == 0 || (ways[level] > 0 && entries[level] % ways[level] == 0 && (sets & (sets - 1)) == 0),
+                  ERR_SIZE, "%u entries in %u-way sets: bad paging-structure cache geometry", entries[level], ways[level]);
+
+        walk_cache->entries[level] = entries[level];
+        walk_cache->ways[level] = entries[level] == 0 ? 0 : ways[level];
+        walk_cache->sets[level] = sets;
+        walk_cache->first[level] = first;
+        first += entries[level];
+    }
+    memset(&walk_cache->stats, 0, sizeof(walk_cache->stats));
+
+    return page_walk_cache_flush(walk_cache);
+}
+
+
+int page_walk_cache_flush(page_walk_cache_t* walk_cache){
+
+    M_REQUIRE_NON_NULL(walk_cache);
+
+    //An all-zero entry is invalid
+    const size_t lines = walk_cache->first[PWC_PMD] + walk_cache->entries[PWC_PMD];
+    memset(walk_cache->lines, 0, lines * sizeof(pwc_entry_t));
+    walk_cache->clock = 0;
+
+    return ERR_NONE;
+}
+
+
 static inline pte_t read_page_entry(const pte_t * start, 
                                     pte_t page_start,
                                     uint16_t index){ 
@@ -7,6 +7,53 @@
 
 #include "addr.h"
 
+#include <stddef.h> // for size_t
+
+#define PAGE_WALK_LEVELS 4 // PGD, PUD, PMD and PTE entries
+
+/*
+ * Paging-structure caches (see page_walk_cached()): the PGD cache maps the PGD index of a
+ * virtual address to the PUD table it leads to, the PUD cache its PGD and PUD indexes to
+ * the PMD table, and the PMD cache its PGD, PUD and PMD indexes to the page table. A walk
+ * starts from the deepest of them that hits, so it reads one to three fewer entries. Only
+ * the entries pointing to a page table are cached, not those of huge pages.
+ *
+ * Each cache has `entries` entries (0 for none) in sets of `ways` ways, a power of 2 of
+ * sets, and replaces its least recently used entry. They are allocated by the caller in
+ * one block of page_walk_cache_size() bytes.
+ */
+typedef enum {PWC_PGD, PWC_PUD, PWC_PMD, NB_PWC_LEVELS} pwc_level_t;
+
+typedef struct
+{
+    uint64_t tag;      // the indexes of the virtual address, from the PGD one to that of the level
+    uint64_t stamp;    // last use, for LRU
+    pte_t next_table;  // physical address of the page table they lead to
+    uint8_t v;
+
+} pwc_entry_t;
+
+typedef struct
+{
+    uint64_t walks;
+    uint64_t walks_by_reads[PAGE_WALK_LEVELS + 1]; // by the number of entries read, the walk depth
+    uint64_t hits[NB_PWC_LEVELS];   // walks that started from the cache of each level
+    uint64_t misses[NB_PWC_LEVELS]; // lookups that missed, probed from the PMD cache up
+
+} pwc_stats_t;
+
+typedef struct
+{
+    uint16_t entries[NB_PWC_LEVELS];
+    uint8_t ways[NB_PWC_LEVELS];
+    uint16_t sets[NB_PWC_LEVELS];
+    size_t first[NB_PWC_LEVELS]; // index in lines of the first entry of each cache
+    uint64_t clock;              // LRU stamps
+    pwc_stats_t stats;
+    pwc_entry_t lines[];         // set after set, the PGD cache first
+
+} page_walk_cache_t;
+
 /**
  * @brief Page walker: virtual address to physical address conversion.
  *
@@ -16,3 +63,59 @@
  * @return error code
  */
 int page_walk(const void* mem_space, const virt_addr_t* vaddr, phy_addr_t* paddr);
+
+/**
+ * @brief Page walker that also tells the size of the page: the walk stops at a PUD entry
+ *        (1 GiB page) or at a PMD entry (2 MiB page) that has PTE_PAGE_SIZE_FLAG set.
+ *        page_walk() is this walk, for callers that do not need the size.
+ *
+ * @param mem_space starting address of our simulated memory space
+ * @param vaddr virtual address to be converted
+ * @param paddr (SET) physical address
+ * @param page_size (SET) the size of the page that vaddr is in
+ * @return error code
+ */
+int page_walk_sized(const void* mem_space, const virt_addr_t* vaddr, phy_addr_t* paddr, page_size_t* page_size);
+
+/**
+ * @brief Page walker that may start from a paging-structure cache (see page_walk_cache_t),
+ *        and that fills it with the page tables it goes through.
+ *
+ * @param mem_space starting address of our simulated memory space
+ * @param walk_cache the paging-structure caches, NULL for none (page_walk_sized() is then this walk)
+ * @param vaddr virtual address to be converted
+ * @param paddr (SET) physical address
+ * @param page_size (SET) the size of the page that vaddr is in
+ * @param reads (SET, may be NULL) the number of page-table entries read, from 1 to PAGE_WALK_LEVELS
+ * @return error code
+ */
+int page_walk_cached(const void* mem_space, page_walk_cache_t* walk_cache, const virt_addr_t* vaddr,
+                     phy_addr_t* paddr, page_size_t* page_size, uint32_t* reads);
+
+/**
+ * @brief Number of bytes to allocate for paging-structure caches.
+ *
+ * @param entries the number of entries of the cache of each level (see pwc_level_t), 0 for none
+ * @return the size in bytes
+ */
+size_t page_walk_cache_size(const uint16_t entries[NB_PWC_LEVELS]);
+
+/**
+ * @brief Initialize empty paging-structure caches, with zeroed statistics.
+ *
+ * @param walk_cache (modified) the caches, of at least page_walk_cache_size(entries) bytes
+ * @param entries the number of entries of the cache of each level, 0 for none
+ * @param ways the number of ways of the cache of each level (ignored for none)
+ * @return error code (ERR_SIZE for a bad geometry)
+ */
+int page_walk_cache_init(page_walk_cache_t* walk_cache, const uint16_t entries[NB_PWC_LEVELS],
+                         const uint8_t ways[NB_PWC_LEVELS]);
+
+/**
+ * @brief Clean paging-structure caches, e.g. after the page tables changed: all their
+ *        entries become invalid, their statistics are kept.
+ *
+ * @param walk_cache the caches
+ * @return error code
+ */
+int page_walk_cache_flush(page_walk_cache_t* walk_cache);
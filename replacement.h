@@ -0,0 +1,137 @@
+#pragma once
+
+/**
+ * @file replacement.h
+ * @brief replacement policies of the caches (LRU itself is in lru.h)
+ *
+ * Every policy provides three operations on a set:
+ *  - HIT:    WAY_INDEX has just been accessed
+ *  - FILL:   a line has just been installed in WAY_INDEX
+ *  - VICTIM: store in WAY_OUT the way to evict from a full set
+ * Their state lives in the per-entry age field and/or in the per-set state
+ * word (see cache_set_state() in cache.h), both cleared by cache_flush().
+ */
+
+#include "lru.h"
+
+#define RRIP_MAX           3  // 2-bit re-reference prediction values: 3 = distant
+#define RRIP_LONG          2
+#define BRRIP_LONG_PERIOD 32  // BRRIP inserts with RRIP_LONG once every BRRIP_LONG_PERIOD fills of a set
+
+//=========================================================================
+// LRU: exact ages (0 = most recent), packed in the set state word for up to
+// LRU_PACKED_MAX_WAYS ways (see lru.h)
+#define LRU_hit(CFG, CACHE, WAY_INDEX, LINE_INDEX)  LRU_age_update(CFG, CACHE, WAY_INDEX, LINE_INDEX)
+#define LRU_fill(CFG, CACHE, WAY_INDEX, LINE_INDEX) LRU_age_increase(CFG, CACHE, WAY_INDEX, LINE_INDEX)
+
+#define LRU_victim(CFG, CACHE, LINE_INDEX, WAY_OUT) \
+do { \
+    const uint8_t ways_ = (CFG)->ways; \
+    if ((CFG)->age_bits) { \
+        WAY_OUT = lru_packed_victim(replacement_state(CFG, CACHE, LINE_INDEX), \
+                                    (CFG)->age_bits, (CFG)->age_lanes, ways_); \
+        break; \
+    } \
+    uint8_t age_max_ = 0; \
+    WAY_OUT = 0; \
+    for (uint8_t i_ = 0; i_ < ways_; i_++) { \
+        const uint8_t age_ = replacement_age(CFG, CACHE, LINE_INDEX, i_); \
+        if (age_ >= age_max_) { \
+            WAY_OUT = i_; \
+            age_max_ = age_; \
+        } \
+    } \
+} while(0)
+
+//=========================================================================
+// FIFO: the ages count fills only, hits leave them untouched (packed as for LRU)
+#define FIFO_hit(CFG, CACHE, WAY_INDEX, LINE_INDEX)  do { } while(0)
+#define FIFO_fill(CFG, CACHE, WAY_INDEX, LINE_INDEX) LRU_age_increase(CFG, CACHE, WAY_INDEX, LINE_INDEX)
+#define FIFO_victim(CFG, CACHE, LINE_INDEX, WAY_OUT) LRU_victim(CFG, CACHE, LINE_INDEX, WAY_OUT)
+
+//=========================================================================
+// Tree-PLRU (power-of-2 ways, at most 64): bit n of the set state is node n of
+// the tree (node 1 is the root, the children of n are 2n and 2n+1, the leaves
+// ways + w). A set bit means that the victim is in the right subtree.
+#define PLRU_hit(CFG, CACHE, WAY_INDEX, LINE_INDEX) \
+do { \
+    uint64_t * state_ = &replacement_state(CFG, CACHE, LINE_INDEX); \
+    uint64_t bits_ = *state_; \
+    unsigned node_ = 1; \
+    for (unsigned half_ = (CFG)->ways >> 1; half_ > 0; half_ >>= 1) { \
+        const unsigned right_ = ((WAY_INDEX) & half_) != 0; \
+        /*POINT AWAY FROM THE WAY JUST ACCESSED*/ \
+        if (right_) bits_ &= ~(1ull << node_); \
+        else        bits_ |= 1ull << node_; \
+        node_ = 2 * node_ + right_; \
+    } \
+    *state_ = bits_; \
+} while(0)
+
+#define PLRU_fill(CFG, CACHE, WAY_INDEX, LINE_INDEX) PLRU_hit(CFG, CACHE, WAY_INDEX, LINE_INDEX)
+
+#define PLRU_victim(CFG, CACHE, LINE_INDEX, WAY_OUT) \
+do { \
+    const uint64_t bits_ = replacement_state(CFG, CACHE, LINE_INDEX); \
+    unsigned node_ = 1; \
+    while (node_ < (CFG)->ways) node_ = 2 * node_ + ((bits_ >> node_) & 1); \
+    WAY_OUT = (uint8_t) (node_ - (CFG)->ways); \
+} while(0)
+
+//=========================================================================
+// SRRIP / BRRIP (Jaleel et al., ISCA 2010): the age field holds the RRPV.
+// BRRIP only differs by inserting most lines as distant; the set state counts its fills.
+#define RRIP_hit(CFG, CACHE, WAY_INDEX, LINE_INDEX) \
+    replacement_age(CFG, CACHE, LINE_INDEX, WAY_INDEX) = 0
+
+#define SRRIP_hit(CFG, CACHE, WAY_INDEX, LINE_INDEX) RRIP_hit(CFG, CACHE, WAY_INDEX, LINE_INDEX)
+#define BRRIP_hit(CFG, CACHE, WAY_INDEX, LINE_INDEX) RRIP_hit(CFG, CACHE, WAY_INDEX, LINE_INDEX)
+
+#define SRRIP_fill(CFG, CACHE, WAY_INDEX, LINE_INDEX) \
+    replacement_age(CFG, CACHE, LINE_INDEX, WAY_INDEX) = RRIP_LONG
+
+#define BRRIP_fill(CFG, CACHE, WAY_INDEX, LINE_INDEX) \
+do { \
+    uint64_t * fills_ = &replacement_state(CFG, CACHE, LINE_INDEX); \
+    replacement_age(CFG, CACHE, LINE_INDEX, WAY_INDEX) = \
+        (++*fills_ % BRRIP_LONG_PERIOD == 0) ? RRIP_LONG : RRIP_MAX; \
+} while(0)
+
+// first way predicted distant; if there is none, the whole set is aged
+// as if the search had been repeated until one became distant
+#define RRIP_victim(CFG, CACHE, LINE_INDEX, WAY_OUT) \
+do { \
+    const uint8_t ways_ = (CFG)->ways; \
+    uint8_t rrpv_max_ = 0; \
+    WAY_OUT = 0; \
+    for (uint8_t i_ = 0; i_ < ways_; i_++) { \
+        if (replacement_age(CFG, CACHE, LINE_INDEX, i_) > rrpv_max_) { \
+            WAY_OUT = i_; \
+            rrpv_max_ = replacement_age(CFG, CACHE, LINE_INDEX, i_); \
+        } \
+    } \
+    if (rrpv_max_ < RRIP_MAX) { \
+        for (uint8_t i_ = 0; i_ < ways_; i_++) \
+            replacement_age(CFG, CACHE, LINE_INDEX, i_) += RRIP_MAX - rrpv_max_; \
+    } \
+} while(0)
+
+#define SRRIP_victim(CFG, CACHE, LINE_INDEX, WAY_OUT) RRIP_victim(CFG, CACHE, LINE_INDEX, WAY_OUT)
+#define BRRIP_victim(CFG, CACHE, LINE_INDEX, WAY_OUT) RRIP_victim(CFG, CACHE, LINE_INDEX, WAY_OUT)
+
+//=========================================================================
+// RANDOM: splitmix64 of (SEED, set, number of evictions of the set), so that
+// runs are reproducible for a given seed
+#define RANDOM_hit(CFG, CACHE, WAY_INDEX, LINE_INDEX)  do { } while(0)
+#define RANDOM_fill(CFG, CACHE, WAY_INDEX, LINE_INDEX) do { } while(0)
+
+#define RANDOM_victim(CFG, CACHE, LINE_INDEX, SEED, WAY_OUT) \
+do { \
+    uint64_t * evictions_ = &replacement_state(CFG, CACHE, LINE_INDEX); \
+    uint64_t z_ = (SEED) ^ ((uint64_t) (LINE_INDEX) << 32); \
+    z_ += ++*evictions_ * 0x9E3779B97F4A7C15ull; \
+    z_ = (z_ ^ (z_ >> 30)) * 0xBF58476D1CE4E5B9ull; \
+    z_ = (z_ ^ (z_ >> 27)) * 0x94D049BB133111EBull; \
+    z_ ^= z_ >> 31; \
+    WAY_OUT = (uint8_t) (z_ % (CFG)->ways); \
+} while(0)
@@ -13,7 +13,7 @@
 #include "error.h"
 // #include "memory.h"
 // #include "util.h"  // for zero_init_var()
-// #include "addr_mng.h" // for init_virt_addr64()
+#include "addr_mng.h" // for init_virt_addr64()
 
 #include "cache_mng.h"
 #include "commands.h"
@@ -22,7 +22,10 @@
 
 // #include <stdio.h>
 #include <assert.h>
+#include <stdlib.h>
 #include <string.h>
+
+#define MAX_BATCH 4096 // commands per cache_access_batch() call
 // #include <ctype.h> // for isspace()
 // #include <inttypes.h> // for SCNx macro
 
@@ -32,45 +35,189 @@ static void error(const char* pgm, const char* msg)
     assert(msg != NULL);
     fputs("ERROR: ", stderr);
     fputs(msg, stderr);
-    fprintf(stderr, "\nusage:    %s (dump|desc) mem_filename command_filename\n", pgm);
+    fprintf(stderr, "\nusage:    %s (dump|desc) mem_filename command_filename [--soa] [--stats] [--write-back] [--way-prediction] [--inclusion EXCLUSIVE|INCLUSIVE|NINE] [--l3-inclusion EXCLUSIVE|INCLUSIVE|NINE] [--policy LRU|PLRU|SRRIP|BRRIP|FIFO|RANDOM] [--seed N] [--batch N] [--flush N] [--epoch E] [--cores N] [--l1d-prefetch|--l2-prefetch NAME[:DEGREE[:ENTRIES]]] [--latency L1:L2:L3:MEMORY] [--mshrs L1:L2:L3] [--l1i|--l1d|--l2|--l3 SETS:WAYS:LINE_BYTES]...\n", pgm);
     fprintf(stderr, "examples: %s dump memory_dump.bin commands01.txt\n", pgm);
     fprintf(stderr, "          %s desc memory_description.txt commands01.txt\n", pgm);
+    fprintf(stderr, "          %s dump memory_dump.bin commands01.txt --l1d 64:8:64 --l1i 64:8:64 --l2 1024:4:64\n", pgm);
+    fprintf(stderr, "          %s dump memory_dump.bin commands01.txt --policy PLRU\n", pgm);
+    fprintf(stderr, "--stats prints the hits, misses, evictions and fills of each level at the end\n");
+    fprintf(stderr, "--write-back makes all levels write-back; their dirty lines are written back at the end\n");
+    fprintf(stderr, "--way-prediction makes all levels check a predicted way first; --stats then reports its accuracy\n");
+    fprintf(stderr, "--inclusion sets the inclusion policy of L2 with respect to L1 (default: EXCLUSIVE)\n");
+    fprintf(stderr, "--l3 adds an L3 (default geometry: --l3 %u:%u:%u), --l3-inclusion sets its inclusion policy (default: INCLUSIVE)\n",
+            L3_CACHE_LINES, L3_CACHE_WAYS, L3_CACHE_LINE);
+    fprintf(stderr, "--batch N runs N commands per call and dumps the caches after each N (default: 1)\n");
+    fprintf(stderr, "--flush N writes back and flushes all the caches after every N batches, once they are dumped;\n"
+            "          --epoch E starts their flush epochs at E, so that a flush can wrap them around to 0\n");
+    fprintf(stderr, "--l1d-prefetch and --l2-prefetch add a NEXT_LINE, STRIDE or STREAM prefetcher (default: degree %u, %u entries)\n",
+            CACHE_PREFETCH_DEFAULT_DEGREE, CACHE_PREFETCH_DEFAULT_ENTRIES);
+    fprintf(stderr, "--latency sets the hit latencies of the levels and that of memory, in cycles (default: %u:%u:%u:%u);\n"
+            "          --stats then also reports the cycles, AMAT and latency histogram of the L1 caches\n",
+            L1_CACHE_HIT_LATENCY, L2_CACHE_HIT_LATENCY, L3_CACHE_HIT_LATENCY, CACHE_MEMORY_LATENCY);
+    fprintf(stderr, "--mshrs sets the MSHRs of the levels (default: %u:%u:%u) and times the accesses of an in-order core,\n"
+            "          whose misses overlap; a \"D\" command prefix makes an access wait for the previous read\n",
+            L1_CACHE_MSHRS, L2_CACHE_MSHRS, L3_CACHE_MSHRS);
+    fprintf(stderr, "--cores N gives each of N cores (at most %u) its own L1 caches and L2, kept coherent with MESI;\n"
+            "          commands name their core with a \"C<n> \" prefix (default: core 0)\n", CACHE_MAX_CORES);
+    fprintf(stderr, "data commands may load or store 8, 16 or 32 bytes (\"R D16 @0x...\", \"W D32 0x... @0x...\"),\n"
+            "          in one access of each line they touch; a store repeats its word over the bytes\n");
+}
+
+// ======================================================================
+// parses "SETS:WAYS:LINE_BYTES" into cfg
+static int parse_geometry(const char* spec, cache_t type, cache_config_t* cfg)
+{
+    unsigned int sets = 0, ways = 0, line = 0;
+    char trailing = '\0';
+    if (sscanf(spec, "%u:%u:%u%c", &sets, &ways, &line, &trailing) != 3
+        || sets > UINT16_MAX || ways > UINT8_MAX || line > UINT16_MAX) {
+        return ERR_BAD_PARAMETER;
+    }
+    return cache_config_init(cfg, type, (uint16_t) sets, (uint8_t) ways, (uint16_t) line, LRU);
+}
+
+// ======================================================================
+// parses "NAME[:DEGREE[:ENTRIES]]" into the prefetcher of cfg
+static int parse_prefetch(const char* spec, cache_config_t* cfg)
+{
+    char name[16] = "";
+    unsigned int degree = CACHE_PREFETCH_DEFAULT_DEGREE, entries = CACHE_PREFETCH_DEFAULT_ENTRIES;
+    char trailing = '\0';
+    cache_prefetch_t prefetch = CACHE_PREFETCH_NONE;
+    if (sscanf(spec, "%15[^:]:%u:%u%c", name, &degree, &entries, &trailing) > 3
+        || cache_prefetch_parse(name, &prefetch) != ERR_NONE
+        || degree > UINT8_MAX || entries > UINT16_MAX) {
+        return ERR_BAD_PARAMETER;
+    }
+    return cache_config_set_prefetch(cfg, prefetch, (uint8_t) degree, (uint16_t) entries);
 }
 
 // ======================================================================
-void execute_command(void *mem_space,
-                     const command_t* command,
-                     l1_icache_entry_t *l1_icache,
-                     l1_icache_entry_t *l1_dcache,
-                     l2_cache_entry_t *l2_cache)
+// parses "L1:L2:L3:MEMORY" into the latencies of the levels (see cache_config_set_latency())
+static int parse_latency(const char* spec, cache_config_t* const cfgs[4])
 {
-    phy_addr_t paddr;
-    assert(page_walk(mem_space, &command->vaddr, &paddr) == ERR_NONE);
-    uint8_t byte;
-    uint32_t word;
-    void *l1_cache;
-
-    switch (command->order) {
-    case READ:
-        l1_cache = (command->type == INSTRUCTION)? l1_icache: l1_dcache;
-        if(command->data_size == 4)
-            cache_read(mem_space, &paddr, command->type, l1_cache,
-                       l2_cache, &word, LRU);
-        else
-            cache_read_byte(mem_space, &paddr, command->type, l1_cache,
-                            l2_cache, &byte, LRU);
-        break;
-    case WRITE:
-        if(command->data_size == 4)
-            cache_write(mem_space, &paddr, l1_dcache,
-                        l2_cache, &command->write_data, LRU);
-        else
-            cache_write_byte(mem_space, &paddr, l1_dcache,
-                             l2_cache, (uint8_t)command->write_data, LRU);
-        break;
-    default:
-        assert(0);
+    unsigned int hit[3] = { 0, 0, 0 }, memory = 0;
+    char trailing = '\0';
+    if (sscanf(spec, "%u:%u:%u:%u%c", &hit[0], &hit[1], &hit[2], &memory, &trailing) != 4
+        || hit[0] > UINT16_MAX || hit[1] > UINT16_MAX || hit[2] > UINT16_MAX || memory > UINT16_MAX) {
+        return ERR_BAD_PARAMETER;
     }
+    // CFGS: L1 ICACHE, L1 DCACHE, L2, L3
+    int err = ERR_NONE;
+    for (size_t i = 0; i < 4 && err == ERR_NONE; ++i)
+        err = cache_config_set_latency(cfgs[i], (uint16_t) hit[i == 0 ? 0 : i - 1], (uint16_t) memory);
+    return err;
+}
+
+// ======================================================================
+// parses "L1:L2:L3" into the numbers of MSHRs of the levels (see cache_config_set_mshrs())
+static int parse_mshrs(const char* spec, cache_config_t* const cfgs[4])
+{
+    unsigned int mshrs[3] = { 0, 0, 0 };
+    char trailing = '\0';
+    if (sscanf(spec, "%u:%u:%u%c", &mshrs[0], &mshrs[1], &mshrs[2], &trailing) != 3
+        || mshrs[0] > UINT8_MAX || mshrs[1] > UINT8_MAX || mshrs[2] > UINT8_MAX) {
+        return ERR_BAD_PARAMETER;
+    }
+    // CFGS: L1 ICACHE, L1 DCACHE, L2, L3
+    int err = ERR_NONE;
+    for (size_t i = 0; i < 4 && err == ERR_NONE; ++i)
+        err = cache_config_set_mshrs(cfgs[i], (uint8_t) mshrs[i == 0 ? 0 : i - 1]);
+    return err;
+}
+
+// ======================================================================
+// accesses of one batch call; a command gives several when its range crosses a page
+typedef struct {
+    phy_addr_t paddrs[MAX_BATCH];
+    uint8_t ops[MAX_BATCH];
+    word_t data[MAX_BATCH];
+    uint8_t core_ids[MAX_BATCH];
+    size_t n;
+} accesses_t;
+
+static void run_accesses(accesses_t *a, const cache_sim_t *sims, uint8_t nb_cores,
+                         cache_coherence_stats_t *coherence)
+{
+    if (nb_cores == 1)
+        assert(cache_access_batch(sims, a->paddrs, a->ops, a->n, a->data) == ERR_NONE);
+    else
+        assert(cache_cores_access_batch(sims, nb_cores, coherence, a->core_ids, a->paddrs,
+                                        a->ops, a->n, a->data) == ERR_NONE);
+    a->n = 0;
+}
+
+static void add_access(accesses_t *a, void *mem_space, const virt_addr_t *vaddr, uint8_t op,
+                       const command_t *command, const cache_sim_t *sims, uint8_t nb_cores,
+                       cache_coherence_stats_t *coherence)
+{
+    if (a->n == MAX_BATCH) run_accesses(a, sims, nb_cores, coherence);
+    assert(page_walk(mem_space, vaddr, &a->paddrs[a->n]) == ERR_NONE);
+    a->ops[a->n] = op;
+    a->data[a->n] = command->write_data;
+    a->core_ids[a->n] = command->core;
+    ++a->n;
+}
+
+// a range of more than a word, cut into pieces of 2^k bytes that do not cross a page
+static void add_range(accesses_t *a, void *mem_space, const command_t *command, uint8_t kind,
+                      const cache_sim_t *sims, uint8_t nb_cores, cache_coherence_stats_t *coherence)
+{
+    uint64_t vaddr64 = virt_addr_t_to_uint64_t(&command->vaddr);
+    size_t left = command->data_size;
+    uint8_t dependent = command->dependent ? CACHE_OP_DEPENDENT : 0;
+    while (left > 0) {
+        const size_t room = PAGE_SIZE - (vaddr64 & (PAGE_SIZE - 1));
+        uint8_t log2 = 0;
+        while ((2u << log2) <= left && (2u << log2) <= room) ++log2;
+
+        virt_addr_t vaddr;
+        assert(init_virt_addr64(&vaddr, vaddr64) == ERR_NONE);
+        add_access(a, mem_space, &vaddr, (uint8_t) (kind | CACHE_OP_SIZE(log2) | dependent),
+                   command, sims, nb_cores, coherence);
+        dependent = 0;
+        vaddr64 += 1u << log2;
+        left -= 1u << log2;
+    }
+}
+
+// runs n commands in cache_access_batch() calls (cache_cores_access_batch() for several cores)
+void execute_commands(void *mem_space,
+                      const command_t* commands, size_t n,
+                      const cache_sim_t *sims, uint8_t nb_cores,
+                      cache_coherence_stats_t *coherence)
+{
+    static accesses_t a;
+    a.n = 0;
+
+    for (size_t i = 0; i < n; ++i) {
+        const command_t* command = &commands[i];
+        uint8_t op = 0;
+
+        switch (command->order) {
+        case READ:
+            if (command->type == DATA && command->data_size > sizeof(word_t)) {
+                add_range(&a, mem_space, command, CACHE_OP_READ_RANGE, sims, nb_cores, coherence);
+                continue;
+            }
+            op = command->type == INSTRUCTION ? CACHE_OP_READ_INSTR
+                 : command->data_size == 4 ? CACHE_OP_READ_WORD : CACHE_OP_READ_BYTE;
+            break;
+        case WRITE:
+            if (command->data_size > sizeof(word_t)) {
+                add_range(&a, mem_space, command, CACHE_OP_WRITE_RANGE, sims, nb_cores, coherence);
+                continue;
+            }
+            op = command->data_size == 4 ? CACHE_OP_WRITE_WORD : CACHE_OP_WRITE_BYTE;
+            break;
+        default:
+            assert(0);
+        }
+        if (command->dependent) op |= CACHE_OP_DEPENDENT;
+        add_access(&a, mem_space, &command->vaddr, op, command, sims, nb_cores, coherence);
+    }
+
+    run_accesses(&a, sims, nb_cores, coherence);
 }
 
 // ======================================================================
@@ -89,6 +236,172 @@ int main(int argc, char *argv[])
         dump = 0;
     }
 
+    cache_config_t l1_icfg, l1_dcfg, l2_cfg, l3_cfg;
+    assert(cache_config_default(&l1_icfg, L1_ICACHE) == ERR_NONE);
+    assert(cache_config_default(&l1_dcfg, L1_DCACHE) == ERR_NONE);
+    assert(cache_config_default(&l2_cfg, L2_CACHE) == ERR_NONE);
+    assert(cache_config_default(&l3_cfg, L3_CACHE) == ERR_NONE);
+    int with_l3 = 0;
+    cache_layout_t layout = CACHE_LAYOUT_AOS;
+    cache_replace_t policy = LRU;
+    unsigned long long seed = CACHE_DEFAULT_SEED;
+    size_t batch = 1;
+    size_t flush_every = 0;
+    unsigned long epoch = 0;
+    unsigned long nb_cores = 1;
+    int stats = 0;
+    int way_prediction = 0;
+    cache_write_t write_policy = CACHE_WRITE_THROUGH;
+    cache_inclusion_t inclusion = CACHE_EXCLUSIVE;
+    cache_inclusion_t l3_inclusion = CACHE_INCLUSIVE;
+    const char* l1d_prefetch = NULL;
+    const char* l2_prefetch = NULL;
+    const char* latency = NULL;
+    const char* mshrs = NULL;
+    for (int i = 4; i < argc; i += 2) {
+        cache_config_t *cfg = NULL;
+        cache_t type = L1_ICACHE;
+        if (!strcmp(argv[i], "--soa")) {
+            layout = CACHE_LAYOUT_SOA;
+            --i;
+            continue;
+        } else if (!strcmp(argv[i], "--write-back")) {
+            write_policy = CACHE_WRITE_BACK;
+            --i;
+            continue;
+        } else if (!strcmp(argv[i], "--stats")) {
+            stats = 1;
+            --i;
+            continue;
+        } else if (!strcmp(argv[i], "--way-prediction")) {
+            way_prediction = 1;
+            --i;
+            continue;
+        } else if (!strcmp(argv[i], "--policy")) {
+            if (i + 1 >= argc || cache_policy_parse(argv[i + 1], &policy) != ERR_NONE) {
+                error(argv[0], "bad replacement policy.");
+                return 1;
+            }
+            continue;
+        } else if (!strcmp(argv[i], "--inclusion")) {
+            if (i + 1 >= argc || cache_inclusion_parse(argv[i + 1], &inclusion) != ERR_NONE) {
+                error(argv[0], "bad inclusion policy.");
+                return 1;
+            }
+            continue;
+        } else if (!strcmp(argv[i], "--l3-inclusion")) {
+            if (i + 1 >= argc || cache_inclusion_parse(argv[i + 1], &l3_inclusion) != ERR_NONE) {
+                error(argv[0], "bad L3 inclusion policy.");
+                return 1;
+            }
+            continue;
+        } else if (!strcmp(argv[i], "--seed")) {
+            if (i + 1 >= argc) {
+                error(argv[0], "missing seed.");
+                return 1;
+            }
+            seed = strtoull(argv[i + 1], NULL, 0);
+            continue;
+        } else if (!strcmp(argv[i], "--batch")) {
+            batch = i + 1 < argc ? strtoul(argv[i + 1], NULL, 0) : 0;
+            if (batch == 0 || batch > MAX_BATCH) {
+                error(argv[0], "bad batch size.");
+                return 1;
+            }
+            continue;
+        } else if (!strcmp(argv[i], "--flush")) {
+            flush_every = i + 1 < argc ? strtoul(argv[i + 1], NULL, 0) : 0;
+            if (flush_every == 0) {
+                error(argv[0], "bad flush period.");
+                return 1;
+            }
+            continue;
+        } else if (!strcmp(argv[i], "--epoch")) {
+            if (i + 1 >= argc || (epoch = strtoul(argv[i + 1], NULL, 0)) > UINT32_MAX) {
+                error(argv[0], "bad flush epoch.");
+                return 1;
+            }
+            continue;
+        } else if (!strcmp(argv[i], "--l1d-prefetch") || !strcmp(argv[i], "--l2-prefetch")) {
+            if (i + 1 >= argc) {
+                error(argv[0], "missing prefetcher.");
+                return 1;
+            }
+            if (!strcmp(argv[i], "--l1d-prefetch")) l1d_prefetch = argv[i + 1];
+            else l2_prefetch = argv[i + 1];
+            continue;
+        } else if (!strcmp(argv[i], "--latency")) {
+            if (i + 1 >= argc) {
+                error(argv[0], "missing latencies.");
+                return 1;
+            }
+            latency = argv[i + 1];
+            continue;
+        } else if (!strcmp(argv[i], "--mshrs")) {
+            if (i + 1 >= argc) {
+                error(argv[0], "missing MSHRs.");
+                return 1;
+            }
+            mshrs = argv[i + 1];
+            continue;
+        } else if (!strcmp(argv[i], "--cores")) {
+            nb_cores = i + 1 < argc ? strtoul(argv[i + 1], NULL, 0) : 0;
+            if (nb_cores == 0 || nb_cores > CACHE_MAX_CORES) {
+                error(argv[0], "bad number of cores.");
+                return 1;
+            }
+            continue;
+        } else if (!strcmp(argv[i], "--l1i")) {
+            cfg = &l1_icfg; type = L1_ICACHE;
+        } else if (!strcmp(argv[i], "--l1d")) {
+            cfg = &l1_dcfg; type = L1_DCACHE;
+        } else if (!strcmp(argv[i], "--l2")) {
+            cfg = &l2_cfg; type = L2_CACHE;
+        } else if (!strcmp(argv[i], "--l3")) {
+            cfg = &l3_cfg; type = L3_CACHE;
+            with_l3 = 1;
+        }
+        if (cfg == NULL || i + 1 >= argc || parse_geometry(argv[i + 1], type, cfg) != ERR_NONE) {
+            error(argv[0], "bad cache geometry option.");
+            return 1;
+        }
+    }
+    if (l1_icfg.line_bytes != l2_cfg.line_bytes || l1_dcfg.line_bytes != l2_cfg.line_bytes
+        || (with_l3 && l3_cfg.line_bytes != l2_cfg.line_bytes)) {
+        error(argv[0], "all cache levels must have the same line size.");
+        return 1;
+    }
+    cache_config_t *all_cfgs[] = { &l1_icfg, &l1_dcfg, &l2_cfg, &l3_cfg };
+    for (size_t i = 0; i < sizeof(all_cfgs) / sizeof(all_cfgs[0]); ++i) {
+        cache_config_t *cfg = all_cfgs[i];
+        if (cache_config_init(cfg, cfg->type, cfg->sets, cfg->ways, cfg->line_bytes, policy) != ERR_NONE) {
+            error(argv[0], "replacement policy not supported by this geometry.");
+            return 1;
+        }
+        cfg->seed = seed;
+        assert(cache_config_set_write_policy(cfg, write_policy) == ERR_NONE);
+        assert(cache_config_set_way_prediction(cfg, way_prediction) == ERR_NONE);
+    }
+    assert(cache_config_set_inclusion(&l2_cfg, inclusion) == ERR_NONE);
+    assert(cache_config_set_inclusion(&l3_cfg, l3_inclusion) == ERR_NONE);
+    if ((l1d_prefetch != NULL && parse_prefetch(l1d_prefetch, &l1_dcfg) != ERR_NONE)
+        || (l2_prefetch != NULL && parse_prefetch(l2_prefetch, &l2_cfg) != ERR_NONE)) {
+        error(argv[0], "bad prefetcher.");
+        return 1;
+    }
+    if (latency != NULL && parse_latency(latency, all_cfgs) != ERR_NONE) {
+        error(argv[0], "bad latencies.");
+        return 1;
+    }
+    if (mshrs != NULL && parse_mshrs(mshrs, all_cfgs) != ERR_NONE) {
+        error(argv[0], "bad MSHRs.");
+        return 1;
+    }
+    assert(cache_config_set_layout(&l1_icfg, layout) == ERR_NONE);
+    assert(cache_config_set_layout(&l1_dcfg, layout) == ERR_NONE);
+    assert(cache_config_set_layout(&l2_cfg, layout) == ERR_NONE);
+    assert(cache_config_set_layout(&l3_cfg, layout) == ERR_NONE);
+
     void* mem_space = NULL;
     size_t mem_size = 0;
     int err = ERR_NONE;
@@ -101,28 +414,110 @@ int main(int argc, char *argv[])
     program_t pgm;
     if (err == ERR_NONE) {
         if(program_read(argv[3], &pgm) == ERR_NONE) {
-            l1_icache_entry_t l1_icache[L1_ICACHE_LINES * L1_ICACHE_WAYS];
-            l1_icache_entry_t l1_dcache[L1_DCACHE_LINES * L1_DCACHE_WAYS];
-            l2_cache_entry_t l2_cache[L2_CACHE_LINES * L2_CACHE_WAYS];
-            memset(l1_icache, 0, sizeof(l1_icache));
-            memset(l1_dcache, 0, sizeof(l1_dcache));
-            memset(l2_cache,  0, sizeof(l2_cache));
-
-            /* Flush caches before use */
-            assert(cache_flush(l1_icache, L1_ICACHE) == ERR_NONE);
-            assert(cache_flush(l1_dcache, L1_DCACHE) == ERR_NONE);
-            assert(cache_flush(l2_cache, L2_CACHE) == ERR_NONE);
-
             for_all_lines(line, &pgm) {
-                execute_command(mem_space, line, l1_icache, l1_dcache, l2_cache);
-
-                printf("L1_ICACHE: \n\n");
-                cache_dump(stdout, l1_icache, L1_ICACHE);
-                printf("L1_DCACHE: \n\n");
-                cache_dump(stdout, l1_dcache, L1_DCACHE);
-                printf("L2_CACHE: \n\n");
-                cache_dump(stdout, l2_cache, L2_CACHE);
+                if (line->core >= nb_cores) {
+                    error(argv[0], "command for a core beyond --cores.");
+                    return 3;
+                }
+            }
+
+            // PRIVATE L1 CACHES AND L2 OF EACH CORE, SHARED L3
+            void *l1_icache[CACHE_MAX_CORES], *l1_dcache[CACHE_MAX_CORES], *l2_cache[CACHE_MAX_CORES];
+            cache_sim_t sims[CACHE_MAX_CORES];
+            cache_coherence_stats_t coherence[CACHE_MAX_CORES];
+            memset(coherence, 0, sizeof(coherence));
+            cache_timing_t timing[CACHE_MAX_CORES];
+            memset(timing, 0, sizeof(timing));
+            void *l3_cache = with_l3 ? calloc(1, cache_size(&l3_cfg)) : NULL;
+            assert(l3_cache != NULL || !with_l3);
+            if (with_l3) {
+                cache_epoch(&l3_cfg, l3_cache) = (uint32_t) epoch;
+                assert(cache_flush(l3_cache, &l3_cfg) == ERR_NONE);
+            }
+            for (uint8_t c = 0; c < nb_cores; ++c) {
+                l1_icache[c] = calloc(1, cache_size(&l1_icfg));
+                l1_dcache[c] = calloc(1, cache_size(&l1_dcfg));
+                l2_cache[c]  = calloc(1, cache_size(&l2_cfg));
+                assert(l1_icache[c] != NULL && l1_dcache[c] != NULL && l2_cache[c] != NULL);
+
+                /* Flush caches before use (--epoch: from the given epoch) */
+                cache_epoch(&l1_icfg, l1_icache[c]) = (uint32_t) epoch;
+                cache_epoch(&l1_dcfg, l1_dcache[c]) = (uint32_t) epoch;
+                cache_epoch(&l2_cfg, l2_cache[c]) = (uint32_t) epoch;
+                assert(cache_flush(l1_icache[c], &l1_icfg) == ERR_NONE);
+                assert(cache_flush(l1_dcache[c], &l1_dcfg) == ERR_NONE);
+                assert(cache_flush(l2_cache[c], &l2_cfg) == ERR_NONE);
+
+                const cache_sim_t sim = { mem_space, l1_icache[c], &l1_icfg, l1_dcache[c], &l1_dcfg,
+                                          l2_cache[c], &l2_cfg, l3_cache, &l3_cfg };
+                sims[c] = sim;
+                // --mshrs: THE CORE HAS A CLOCK, ITS MISSES OVERLAP
+                if (mshrs != NULL) sims[c].timing = &timing[c];
+            }
+
+            // WITH A SINGLE CORE, THE LEVELS ARE NOT LABELLED WITH IT
+            char label[CACHE_MAX_CORES][16];
+            for (uint8_t c = 0; c < nb_cores; ++c) {
+                if (nb_cores == 1) label[c][0] = '\0';
+                else snprintf(label[c], sizeof(label[c]), "CORE %u ", c);
+            }
+
+            for (size_t first = 0; first < pgm.nb_lines; first += batch) {
+                const size_t n = pgm.nb_lines - first < batch ? pgm.nb_lines - first : batch;
+                execute_commands(mem_space, &pgm.listing[first], n, sims, (uint8_t) nb_cores, coherence);
+
+                for (uint8_t c = 0; c < nb_cores; ++c) {
+                    printf("%sL1_ICACHE: \n\n", label[c]);
+                    cache_dump(stdout, l1_icache[c], &l1_icfg);
+                    printf("%sL1_DCACHE: \n\n", label[c]);
+                    cache_dump(stdout, l1_dcache[c], &l1_dcfg);
+                    printf("%sL2_CACHE: \n\n", label[c]);
+                    cache_dump(stdout, l2_cache[c], &l2_cfg);
+                }
+                if (with_l3) {
+                    printf("L3_CACHE: \n\n");
+                    cache_dump(stdout, l3_cache, &l3_cfg);
+                }
                 printf("\n=======================================\n\n");
+
+                // --flush: ALL THE LEVELS ARE EMPTIED, THEIR DIRTY LINES WRITTEN BACK FIRST
+                if (flush_every != 0 && (first / batch + 1) % flush_every == 0) {
+                    for (uint8_t c = 0; c < nb_cores; ++c)
+                        assert(cache_sim_writeback(&sims[c]) == ERR_NONE);
+                    for (uint8_t c = 0; c < nb_cores; ++c) {
+                        assert(cache_flush(l1_icache[c], &l1_icfg) == ERR_NONE);
+                        assert(cache_flush(l1_dcache[c], &l1_dcfg) == ERR_NONE);
+                        assert(cache_flush(l2_cache[c], &l2_cfg) == ERR_NONE);
+                    }
+                    if (with_l3) assert(cache_flush(l3_cache, &l3_cfg) == ERR_NONE);
+                }
+            }
+
+            // EXPLICIT FLUSH OF THE DIRTY LINES (NO-OP IN WRITE-THROUGH). THE LAST CALL
+            // WRITES L3 BACK ONCE ALL THE PRIVATE LEVELS HAVE BEEN
+            for (uint8_t c = 0; c < nb_cores; ++c)
+                assert(cache_sim_writeback(&sims[c]) == ERR_NONE);
+
+            if (stats) {
+                for (uint8_t c = 0; c < nb_cores; ++c) {
+                    if (nb_cores > 1) printf("CORE %u:\n", c);
+                    cache_stats_dump(stdout, l1_icache[c], &l1_icfg);
+                    cache_stats_dump(stdout, l1_dcache[c], &l1_dcfg);
+                    cache_stats_dump(stdout, l2_cache[c], &l2_cfg);
+                    if (nb_cores > 1) cache_coherence_stats_dump(stdout, c, &coherence[c]);
+                }
+                if (with_l3) cache_stats_dump(stdout, l3_cache, &l3_cfg);
+                for (uint8_t c = 0; c < nb_cores; ++c) {
+                    if (nb_cores > 1) printf("CORE %u LATENCY:\n", c);
+                    cache_sim_latency_dump(stdout, &sims[c]);
+                }
+            }
+
+            free(l3_cache);
+            for (uint8_t c = 0; c < nb_cores; ++c) {
+                free(l2_cache[c]);
+                free(l1_dcache[c]);
+                free(l1_icache[c]);
             }
         } else {
             error(argv[0], "problem initializing program from provided file.");
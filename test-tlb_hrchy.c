@@ -1,6 +1,6 @@
 /**
- * @test-tlb_simple.c
- * @brief Test for full-associative TLB
+ * @file test-tlb_hrchy.c
+ * @brief Test for the TLB hierarchy (fixed direct-mapped or runtime-configured set-associative)
  *
  * @author Mirjana Stojilovic & J.-C. Chappelier
  * @date 2018-19
@@ -20,6 +20,7 @@
 #include "tlb_hrchy_mng.h"
 
 #include <inttypes.h> // for PRIx macros
+#include <string.h>
 
 // --------------------------------------------------
 #define print_all_tlb_entries(tlb, TYPE, N)                                      \
@@ -45,6 +46,48 @@ static void usage()
     fputs("\t- one (txt) to read commands from;\n", stderr);
     fputs("\t- one (bin) to memory content from;\n", stderr);
     fputs("\t- one to write output to.\n", stderr);
+    fputs("then, optionally, [--l1i|--l1d|--l2 ENTRIES:WAYS]... [--l1i-2m|--l1i-1g|--l1d-2m|--l1d-1g|--l2-2m|--l2-1g ENTRIES:WAYS|none|unified]...\n", stderr);
+    fputs("[--pwc-pgd|--pwc-pud|--pwc-pmd ENTRIES:WAYS|none]... [--policy LRU|PLRU|SRRIP|BRRIP|FIFO|RANDOM] [--stats]\n", stderr);
+    fputs("to use runtime-configured set-associative TLBs instead of the direct-mapped ones: the 4 kiB arrays of\n", stderr);
+    fputs("the levels, and their huge-page arrays (none: the pages are splintered, unified: in the array of the smaller size)\n", stderr);
+    fprintf(stderr, "(default: --l1i %u:%u --l1d %u:%u --l2 %u:%u --l1i-2m %u:%u --l1i-1g none --l1d-2m %u:%u --l1d-1g %u:%u\n",
+            TLB_KBL_L1_ITLB_ENTRIES, TLB_KBL_L1_ITLB_WAYS, TLB_KBL_L1_DTLB_ENTRIES, TLB_KBL_L1_DTLB_WAYS,
+            TLB_KBL_L2_TLB_ENTRIES, TLB_KBL_L2_TLB_WAYS, TLB_KBL_L1_ITLB_2M_ENTRIES, TLB_KBL_L1_ITLB_2M_WAYS,
+            TLB_KBL_L1_DTLB_2M_ENTRIES, TLB_KBL_L1_DTLB_2M_WAYS, TLB_KBL_L1_DTLB_1G_ENTRIES, TLB_KBL_L1_DTLB_1G_WAYS);
+    fprintf(stderr, "--l2-2m unified --l2-1g %u:%u, as on Kaby Lake, --pwc-pgd %u:%u --pwc-pud %u:%u --pwc-pmd %u:%u, LRU);\n",
+            TLB_KBL_L2_TLB_1G_ENTRIES, TLB_KBL_L2_TLB_1G_WAYS, TLB_PWC_PGD_ENTRIES, TLB_PWC_PGD_WAYS,
+            TLB_PWC_PUD_ENTRIES, TLB_PWC_PUD_WAYS, TLB_PWC_PMD_ENTRIES, TLB_PWC_PMD_WAYS);
+    fputs("the --pwc-* options size the paging-structure caches of the page walks; only the 4 kiB arrays are printed to the output file;\n", stderr);
+    fputs("--policy PLRU needs a power-of-2 number of ways in every array, which the default L2 has not (e.g. add --l2 1024:8);\n", stderr);
+    fputs("--stats prints the translations and their cycles, by access type, at the end, and with runtime-configured\n", stderr);
+    fputs("TLBs the hits and misses by page size, fills, evictions and back-invalidations of each array,\n", stderr);
+    fputs("and the walk depths and paging-structure cache hits\n", stderr);
+}
+
+// ======================================================================
+// parses "ENTRIES:WAYS", or for a huge-page array or a paging-structure cache "none" (0 entries),
+// or for a huge-page array "unified" (0 ways)
+static int parse_geometry(const char* spec, page_size_t size, unsigned int* entries, unsigned int* ways)
+{
+    if (size != PAGE_4K && (!strcmp(spec, "none") || !strcmp(spec, "unified"))) {
+        *entries = !strcmp(spec, "unified");
+        *ways = 0;
+        return ERR_NONE;
+    }
+    char trailing = '\0';
+    if (sscanf(spec, "%u:%u%c", entries, ways, &trailing) != 2 || *entries > UINT16_MAX || *ways > UINT8_MAX) {
+        return ERR_BAD_PARAMETER;
+    }
+    return ERR_NONE;
+}
+
+// ======================================================================
+static int parse_policy(const char* name, cache_replace_t* policy)
+{
+#define POLICY_PARSE(POLICY, ARG) if (!strcmp(ARG, #POLICY)) { *policy = POLICY; return ERR_NONE; }
+    CACHE_POLICIES(POLICY_PARSE, name)
+#undef POLICY_PARSE
+    return ERR_BAD_PARAMETER;
 }
 
 // ======================================================================
@@ -55,6 +98,112 @@ int main(int argc, char* argv[])
         return 1;
     }
 
+    // RUNTIME-CONFIGURED TLBS IF ANY OPTION OTHER THAN --stats IS GIVEN
+    int configured = 0;
+    int with_stats = 0;
+    cache_replace_t policy = LRU;
+    // by level then page size; a huge-page array has 0 entries if none, 0 ways if unified
+    static const char* const options[3][NB_PAGE_SIZES] = {
+        { "--l1i", "--l1i-2m", "--l1i-1g" }, { "--l1d", "--l1d-2m", "--l1d-1g" }, { "--l2", "--l2-2m", "--l2-1g" }
+    };
+    unsigned int entries[3][NB_PAGE_SIZES] = {
+        { TLB_KBL_L1_ITLB_ENTRIES, TLB_KBL_L1_ITLB_2M_ENTRIES, 0 },
+        { TLB_KBL_L1_DTLB_ENTRIES, TLB_KBL_L1_DTLB_2M_ENTRIES, TLB_KBL_L1_DTLB_1G_ENTRIES },
+        { TLB_KBL_L2_TLB_ENTRIES, 1, TLB_KBL_L2_TLB_1G_ENTRIES }
+    };
+    unsigned int ways[3][NB_PAGE_SIZES] = {
+        { TLB_KBL_L1_ITLB_WAYS, TLB_KBL_L1_ITLB_2M_WAYS, 0 },
+        { TLB_KBL_L1_DTLB_WAYS, TLB_KBL_L1_DTLB_2M_WAYS, TLB_KBL_L1_DTLB_1G_WAYS },
+        { TLB_KBL_L2_TLB_WAYS, 0, TLB_KBL_L2_TLB_1G_WAYS }
+    };
+    static const char* const pwc_options[NB_PWC_LEVELS] = { "--pwc-pgd", "--pwc-pud", "--pwc-pmd" };
+    unsigned int pwc_entries[NB_PWC_LEVELS] = { TLB_PWC_PGD_ENTRIES, TLB_PWC_PUD_ENTRIES, TLB_PWC_PMD_ENTRIES };
+    unsigned int pwc_ways[NB_PWC_LEVELS] = { TLB_PWC_PGD_WAYS, TLB_PWC_PUD_WAYS, TLB_PWC_PMD_WAYS };
+    for (int i = 4; i < argc; ++i) {
+        int parsed = 0;
+        if (!strcmp(argv[i], "--stats")) {
+            with_stats = parsed = 1;
+        } else if (!strcmp(argv[i], "--policy") && i + 1 < argc) {
+            parsed = configured = parse_policy(argv[++i], &policy) == ERR_NONE;
+        } else {
+            for (tlb_t type = L1_ITLB; type <= L2_TLB; ++type) {
+                for (page_size_t size = PAGE_4K; size < NB_PAGE_SIZES; ++size) {
+                    if (!strcmp(argv[i], options[type][size]) && i + 1 < argc) {
+                        parsed = configured = parse_geometry(argv[++i], size, &entries[type][size], &ways[type][size]) == ERR_NONE;
+                    }
+                }
+            }
+            for (pwc_level_t level = PWC_PGD; level < NB_PWC_LEVELS; ++level) {
+                if (!strcmp(argv[i], pwc_options[level]) && i + 1 < argc) {
+                    // as a huge-page array, but "unified" means nothing here
+                    parsed = configured = parse_geometry(argv[++i], PAGE_2M, &pwc_entries[level], &pwc_ways[level]) == ERR_NONE
+                             && (pwc_entries[level] == 0 || pwc_ways[level] != 0);
+                }
+            }
+        }
+        if (!parsed) {
+            usage();
+            return 1;
+        }
+    }
+    tlb_config_t cfgs[3][NB_PAGE_SIZES];
+    void* levels[3][NB_PAGE_SIZES] = { { NULL } };
+    const tlb_config_t* level_cfgs[3][NB_PAGE_SIZES] = { { NULL } };
+    if (configured) {
+        for (tlb_t type = L1_ITLB; type <= L2_TLB; ++type) {
+            for (page_size_t size = PAGE_4K; size < NB_PAGE_SIZES; ++size) {
+                //CASE UNIFIED: THE ARRAY OF THE SMALLER SIZE, IF ANY
+                if (entries[type][size] == 0 || ways[type][size] == 0) {
+                    if (entries[type][size] != 0) {
+                        levels[type][size] = levels[type][size - 1];
+                        level_cfgs[type][size] = level_cfgs[type][size - 1];
+                    }
+                    continue;
+                }
+                const int err = tlb_config_init(&cfgs[type][size], type, (uint16_t) entries[type][size],
+                                                (uint8_t) ways[type][size], policy);
+                //CASE BAD CONFIGURATION: ITS CAUSE IS REPORTED (E.G. --policy PLRU WITH THE 12-WAY DEFAULT L2)
+                if (err == ERR_POLICY) {
+                    fprintf(stderr, "bad TLB configuration %s %u:%u: PLRU needs a power-of-2 number of ways\n",
+                            options[type][size], entries[type][size], ways[type][size]);
+                    return 1;
+                } else if (err != ERR_NONE) {
+                    fprintf(stderr, "bad TLB configuration %s %u:%u: the sets must be a power of 2, of at most %u ways\n",
+                            options[type][size], entries[type][size], ways[type][size], TLB_MAX_WAYS);
+                    return 1;
+                }
+                level_cfgs[type][size] = &cfgs[type][size];
+                levels[type][size] = calloc(1, tlb_level_size(&cfgs[type][size]));
+                if (levels[type][size] == NULL) {
+                    fputs("cannot allocate the TLBs\n", stderr);
+                    return 1;
+                }
+            }
+        }
+    }
+    page_walk_cache_t* walk_cache = NULL;
+    if (configured) {
+        const uint16_t entries16[NB_PWC_LEVELS] = { (uint16_t) pwc_entries[PWC_PGD], (uint16_t) pwc_entries[PWC_PUD],
+                                                    (uint16_t) pwc_entries[PWC_PMD] };
+        const uint8_t ways8[NB_PWC_LEVELS] = { (uint8_t) pwc_ways[PWC_PGD], (uint8_t) pwc_ways[PWC_PUD],
+                                               (uint8_t) pwc_ways[PWC_PMD] };
+        walk_cache = malloc(page_walk_cache_size(entries16));
+        if (walk_cache == NULL || page_walk_cache_init(walk_cache, entries16, ways8) != ERR_NONE) {
+            fputs("bad paging-structure cache configuration\n", stderr);
+            return 1;
+        }
+    }
+    tlb_hrchy_t hrchy;
+    hrchy.walk_cache = walk_cache;
+    for (page_size_t size = PAGE_4K; size < NB_PAGE_SIZES; ++size) {
+        hrchy.l1_itlb[size] = levels[L1_ITLB][size];
+        hrchy.l1_icfg[size] = level_cfgs[L1_ITLB][size];
+        hrchy.l1_dtlb[size] = levels[L1_DTLB][size];
+        hrchy.l1_dcfg[size] = level_cfgs[L1_DTLB][size];
+        hrchy.l2_tlb[size] = levels[L2_TLB][size];
+        hrchy.l2_cfg[size] = level_cfgs[L2_TLB][size];
+    }
+
     program_t pgm;
     if (program_read(argv[1], &pgm) != ERR_NONE) {
         fprintf(stderr, "Cannot open \"%s\" for reading commands.\n", argv[1]);
@@ -95,22 +244,46 @@ int main(int argc, char* argv[])
     phy_addr_t paddr;
     zero_init_var(paddr);
 
+    // translations and their cycles, per access type (see the latency model in tlb_hrchy.h)
+    uint64_t translations[2] = { 0, 0 };
+    uint64_t cycles[2] = { 0, 0 };
+
     for (size_t prog_line_index = 0; prog_line_index < pgm.nb_lines; prog_line_index++) {
 
         int hit = 0;
-        fprintf(f_out, "\n" SIZE_T_FMT ": DATA/INSTRUCTION = %d\n", prog_line_index, pgm.listing[prog_line_index].type == DATA ? DATA : INSTRUCTION);
-        tlb_search(mem_space, &(pgm.listing[prog_line_index].vaddr), &paddr, pgm.listing[prog_line_index].type == DATA ? DATA : INSTRUCTION, l1_itlb, l1_dtlb, l2_tlb, &hit);
+        uint32_t latency = 0;
+        const mem_access_t access = pgm.listing[prog_line_index].type == DATA ? DATA : INSTRUCTION;
+        fprintf(f_out, "\n" SIZE_T_FMT ": DATA/INSTRUCTION = %d\n", prog_line_index, access);
+        const int err = configured
+                        ? tlb_hrchy_search(mem_space, &hrchy, &(pgm.listing[prog_line_index].vaddr), &paddr, access, &hit, &latency)
+                        : tlb_search_timed(mem_space, &(pgm.listing[prog_line_index].vaddr), &paddr, access, l1_itlb, l1_dtlb, l2_tlb, &hit, &latency);
+        if (err == ERR_NONE) {
+            translations[access == DATA] += 1;
+            cycles[access == DATA] += latency;
+        }
 
         fprintf(f_out, "-------------------------------------------------------------------\n");
         fprintf(f_out, "After program line " SIZE_T_FMT "...\n\n", prog_line_index);
         fprintf(f_out, "VA = ");
         print_virtual_address(f_out, &(pgm.listing[prog_line_index].vaddr));
-        fprintf(f_out, "; PA  = ");
-        print_physical_address(f_out, &paddr);
-        fprintf(f_out, "\n\n");
-        if (hit) fprintf(f_out, "HIT...\n\n");
-        else fprintf(f_out, "MISS...\n\n");
+        if (err == ERR_NONE) {
+            fprintf(f_out, "; PA  = ");
+            print_physical_address(f_out, &paddr);
+            fprintf(f_out, "\n\n");
+            if (hit) fprintf(f_out, "HIT...\n\n");
+            else fprintf(f_out, "MISS...\n\n");
+        } else {
+            fprintf(f_out, "\nerror with %s(): %s\n", configured ? "tlb_hrchy_search" : "tlb_search",
+                    ERR_MESSAGES[err - ERR_NONE]);
+        }
 
+        if (configured) {
+            const char* const names[3] = { "L1_ITLB", "L1_DTLB", "L2_TLB" };
+            for (tlb_t type = L1_ITLB; type <= L2_TLB; ++type) {
+                fprintf(f_out, "\n\n%s:\n\n", names[type]);
+                tlb_level_dump(f_out, levels[type][PAGE_4K], level_cfgs[type][PAGE_4K]);
+            }
+        } else {
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wconversion"
         fprintf(f_out, "\n\nL1_ITLB:");
@@ -120,15 +293,64 @@ int main(int argc, char* argv[])
         fprintf(f_out, "\n\nL2_TLB:");
         print_all_tlb_entries(l2_tlb, l2_tlb_entry_t, L2_TLB_LINES);
 #pragma GCC diagnostic pop
+        }
 
         fprintf(f_out, "-------------------------------------------------------------------\n");
     }
 
+    // TRANSLATION LATENCY REPORT, ON STDOUT (THE OUTPUT FILE IS COMPARED WITH REFERENCES)
+    if (with_stats) {
+        for (int data = 0; data <= 1; ++data) {
+            printf("%s: translations: %" PRIu64 ", cycles: %" PRIu64 ", average: %.2f cycles\n",
+                   data ? "DATA" : "INSTRUCTION", translations[data], cycles[data],
+                   translations[data] ? (double) cycles[data] / (double) translations[data] : 0.0);
+        }
+    }
+
+    // STATISTICS OF THE RUNTIME-CONFIGURED TLBS, BY ARRAY (THE L2 MISSES ARE THE PAGE WALKS)
+    if (configured && with_stats) {
+        const char* const names[3] = { "L1 ITLB", "L1 DTLB", "L2 TLB" };
+        const char* const sizes[NB_PAGE_SIZES] = { "4K", "2M", "1G" };
+        for (tlb_t type = L1_ITLB; type <= L2_TLB; ++type) {
+            for (page_size_t size = PAGE_4K; size < NB_PAGE_SIZES; ++size) {
+                if (level_cfgs[type][size] != &cfgs[type][size]) continue;
+                // a unified array is named by all its page sizes
+                char label[16] = "";
+                for (page_size_t unified = size; unified < NB_PAGE_SIZES && levels[type][unified] == levels[type][size]; ++unified) {
+                    strcat(strcat(label, unified == size ? "" : "+"), sizes[unified]);
+                }
+                tlb_stats_t stats;
+                tlb_level_get_stats(levels[type][size], level_cfgs[type][size], &stats);
+                printf("%s %s (%u entries, %u ways): hits (4K/2M/1G): %" PRIu64 "/%" PRIu64 "/%" PRIu64
+                       ", misses: %" PRIu64 "/%" PRIu64 "/%" PRIu64 ", fills: %" PRIu64
+                       ", evictions: %" PRIu64 ", back-invalidations: %" PRIu64 "\n",
+                       names[type], label,
+                       cfgs[type][size].entries, cfgs[type][size].ways,
+                       stats.hits[PAGE_4K], stats.hits[PAGE_2M], stats.hits[PAGE_1G],
+                       stats.misses[PAGE_4K], stats.misses[PAGE_2M], stats.misses[PAGE_1G],
+                       stats.fills, stats.evictions, stats.back_invalidations);
+            }
+        }
+        const pwc_stats_t* walks = &walk_cache->stats;
+        printf("page walks: %" PRIu64 ", by entries read (1/2/3/4): %" PRIu64 "/%" PRIu64 "/%" PRIu64 "/%" PRIu64
+               ", paging-structure cache hits (PGD/PUD/PMD): %" PRIu64 "/%" PRIu64 "/%" PRIu64
+               ", misses: %" PRIu64 "/%" PRIu64 "/%" PRIu64 "\n",
+               walks->walks, walks->walks_by_reads[1], walks->walks_by_reads[2], walks->walks_by_reads[3],
+               walks->walks_by_reads[4], walks->hits[PWC_PGD], walks->hits[PWC_PUD], walks->hits[PWC_PMD],
+               walks->misses[PWC_PGD], walks->misses[PWC_PUD], walks->misses[PWC_PMD]);
+    }
+
     /**
      * Garbage collecting
      */
     fclose(f_out);
     free(mem_space);
+    for (tlb_t type = L1_ITLB; type <= L2_TLB; ++type) {
+        for (page_size_t size = PAGE_4K; size < NB_PAGE_SIZES; ++size) {
+            if (level_cfgs[type][size] == &cfgs[type][size]) free(levels[type][size]);
+        }
+    }
+    free(walk_cache);
 
     return EXIT_SUCCESS;
 }
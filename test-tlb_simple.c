@@ -21,14 +21,18 @@
 #include "tlb_mng.h"
 
 #include <inttypes.h> // for PRIx macros
+#include <stdlib.h>
+#include <string.h>
 
 int main(int argc, char* argv[])
 {
-    if (argc < 4) {
+    const int with_index = argc == 5 && !strcmp(argv[4], "--index");
+    if (argc < 4 || (argc > 4 && !with_index)) {
         fprintf(stderr, "please provide 3 filenames:\n");
         fprintf(stderr, "\t- one (txt) to read commands from;\n");
         fprintf(stderr, "\t- one (bin) to memory content from;\n");
         fprintf(stderr, "\t- one to write output to.\n");
+        fprintf(stderr, "then, optionally, --index to look the TLB up through a hash index (see tlb_index_t).\n");
         return 1;
     }
 
@@ -60,11 +64,12 @@ int main(int argc, char* argv[])
     tlb_flush(tlb);
 
     // fill in the linked-list with all tlb line indices
-    list_t ll;
-    init_list(&ll);
+    array_node_t nodes[TLB_LINES];
+    array_list_t ll;
+    (void)init_array_list(&ll, nodes, TLB_LINES);
     
     for (list_content_t line_index = 0; line_index < TLB_LINES; line_index++) {
-        (void)push_back(&ll, &line_index);
+        (void)array_push_back(&ll, &line_index);
     }
     
     /*
@@ -73,10 +78,21 @@ int main(int argc, char* argv[])
     */
     replacement_policy_t replacement_policy = {
         .ll             = &ll,
-        .move_back      = move_back,
-        .push_back      = push_back
+        .move_back      = array_move_back,
+        .push_back      = array_push_back
     };
 
+    // --index: the index replaces the list, with the same LRU order
+    if (with_index) {
+        replacement_policy.index = malloc(tlb_index_size(TLB_LINES));
+        if (replacement_policy.index == NULL || tlb_index_init(replacement_policy.index, TLB_LINES) != ERR_NONE) {
+            fclose(f_out);
+            free(mem_space);
+            fprintf(stderr, "Cannot allocate the TLB index.");
+            return 5;
+        }
+    }
+
     phy_addr_t paddr;
     zero_init_var(paddr);
 
@@ -103,7 +119,7 @@ int main(int argc, char* argv[])
                         tlb[tlb_line_index].phy_page_num
                        );
             }
-            print_list(f_out, &ll);
+            print_array_list(f_out, with_index ? &replacement_policy.index->order : &ll);
         } else {
             fprintf(f_out, "error with tlb_search(): %s\n", ERR_MESSAGES[err - ERR_NONE]);
         }
@@ -114,7 +130,8 @@ int main(int argc, char* argv[])
      * Garbage collecting
      */
     fclose(f_out);
-    clear_list(&ll);
+    clear_array_list(&ll);
+    free(replacement_policy.index);
     free(mem_space);
 
     return EXIT_SUCCESS;
@@ -58,5 +58,25 @@ R I @0x000000000000001C
 R DW @0x0000000040000004 
 R I @0x0000000000000020"
 
+printf "Test %1d (test-command 3): " $((++test))
+check_output test-commands commands04.txt \
+"W DW 0x00001111 @0x0000000000000000 
+C1 R DW @0x0000000000000000 
+C1 W DW 0x00002222 @0x0000000000000004 
+R DW @0x0000000000000000 
+R DW @0x0000000000000010 
+C1 R DW @0x0000000000000010 
+C1 W DB 0xAA @0x0000000000000011 
+R DB @0x0000000000000011"
+
+printf "Test %1d (test-command 4): " $((++test))
+check_output test-commands commands05.txt \
+"R D8 @0x000000000000000C 
+W D16 0x55AA55AA @0x0000000000000018 
+R D32 @0x0000000000000028 
+D R DW @0x0000000000000030 
+W D8 0x0000BEEF @0x0000000000000044 
+D R D16 @0x0000000000000048"
+
 # ======================================================================
 echo "SUCCESS"
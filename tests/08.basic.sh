@@ -24,7 +24,7 @@ check_output_with_file() {
     
     mytmp1="$(new_tmp_file)"
     mytmp2="$(new_tmp_file)"
-    "$1" "$cmdfile" "$memfile" "$mytmp1" 2>"$mytmp2"
+    "$1" "$cmdfile" "$memfile" "$mytmp1" "${@:5}" 2>"$mytmp2"
     # we don't do anything with stderr yet, but may be useful sometime
 
     diff -w "$mytmp1" "$refoutput" \
@@ -38,5 +38,17 @@ check_output_with_file() {
 printf "Test %1d (test-tlb_simple 1): " $((++test))
 check_output_with_file test-tlb_simple commands02.txt memory-dump-01.mem output/tlb-simple-01-out.txt
 
+# the same through the hash index, which must keep the same entries in the same LRU order
+printf "Test %1d (test-tlb_simple 1, --index): " $((++test))
+check_output_with_file test-tlb_simple commands02.txt memory-dump-01.mem output/tlb-simple-01-out.txt --index
+
+# 2 MiB and 1 GiB pages, each cached by one entry, and two misaligned ones that fail the walk
+printf "Test %1d (test-tlb_simple huge pages): " $((++test))
+check_output_with_file test-tlb_simple commands07.txt memory-dump-02.mem output/tlb-simple-02-out.txt
+
+# the same through the hash index
+printf "Test %1d (test-tlb_simple huge pages, --index): " $((++test))
+check_output_with_file test-tlb_simple commands07.txt memory-dump-02.mem output/tlb-simple-02-out.txt --index
+
 # ======================================================================
 echo "SUCCESS"
@@ -24,7 +24,7 @@ check_output_with_file() {
     
     mytmp1="$(new_tmp_file)"
     mytmp2="$(new_tmp_file)"
-    "$1" "$cmdfile" "$memfile" "$mytmp1" 2>"$mytmp2"
+    "$1" "$cmdfile" "$memfile" "$mytmp1" "${@:5}" 2>"$mytmp2"
     # we don't do anything with stderr yet, but may be useful sometime
 
     diff -w "$mytmp1" "$refoutput" \
@@ -33,10 +33,121 @@ check_output_with_file() {
             exit 1)
 }
 
+# same, with the --stats report of stdout compared with the file $5 (options from $6 on)
+check_output_and_stats_with_file() {
+
+    checkX "Test TLB hierarchy" "$1"
+
+    ref='tests/files'
+    cmdfile="${ref}/$2"
+    [ -f "$cmdfile" ] || error "Expected command file \"$cmdfile\" not found."
+
+    memfile="${ref}/$3"
+    [ -f "$memfile" ] || error "Expected mem dump file \"$memfile\" not found."
+
+    refoutput="${ref}/$4"
+    [ -f "$refoutput" ] || error "Expected output file \"$refoutput\" not found."
+
+    refstats="${ref}/$5"
+    [ -f "$refstats" ] || error "Expected stats file \"$refstats\" not found."
+
+    mytmp1="$(new_tmp_file)"
+    mytmp2="$(new_tmp_file)"
+    mytmp3="$(new_tmp_file)"
+    "$1" "$cmdfile" "$memfile" "$mytmp1" "${@:6}" --stats >"$mytmp3" 2>"$mytmp2"
+    diff -w "$mytmp1" "$refoutput" && diff -w "$mytmp3" "$refstats" \
+        && echo "PASS" \
+        || (echo "FAIL"; \
+            exit 1)
+}
+
+# same, with only the --stats report of stdout compared with the file $4 (options from $5 on)
+check_stats_with_file() {
+
+    checkX "Test TLB hierarchy" "$1"
+
+    ref='tests/files'
+    cmdfile="${ref}/$2"
+    [ -f "$cmdfile" ] || error "Expected command file \"$cmdfile\" not found."
+
+    memfile="${ref}/$3"
+    [ -f "$memfile" ] || error "Expected mem dump file \"$memfile\" not found."
+
+    refstats="${ref}/$4"
+    [ -f "$refstats" ] || error "Expected stats file \"$refstats\" not found."
+
+    mytmp1="$(new_tmp_file)"
+    mytmp2="$(new_tmp_file)"
+    mytmp3="$(new_tmp_file)"
+    "$1" "$cmdfile" "$memfile" "$mytmp1" "${@:5}" --stats >"$mytmp3" 2>"$mytmp2"
+    diff -w "$mytmp3" "$refstats" \
+        && echo "PASS" \
+        || (echo "FAIL"; \
+            exit 1)
+}
+
 # ======================================================================
 # test test-tlb_simple on a few provided files
 printf "Test %1d (test-tlb_hrchy 1): " $((++test))
 check_output_with_file test-tlb_hrchy commands02.txt memory-dump-01.mem output/tlb-hrchy-01-out.txt
 
+# the same, with the translation cycles of each access type
+printf "Test %1d (test-tlb_hrchy --stats): " $((++test))
+check_output_and_stats_with_file test-tlb_hrchy commands02.txt memory-dump-01.mem \
+    output/tlb-hrchy-01-out.txt output/tlb-hrchy-01-stats.txt
+
+# direct-mapped runtime-configured TLBs must behave as the fixed ones
+printf "Test %1d (test-tlb_hrchy 2): " $((++test))
+check_output_with_file test-tlb_hrchy commands02.txt memory-dump-01.mem output/tlb-hrchy-01-out.txt --l1i 16:1 --l1d 16:1 --l2 64:1
+
+# two data pages of the same L1 line but of different L2 lines (0x00 and 0x10)
+printf "Test %1d (test-tlb_hrchy 3): " $((++test))
+check_output_with_file test-tlb_hrchy commands13.txt memory-dump-01.mem output/tlb-hrchy-13-out.txt
+
+# the same with runtime-configured direct-mapped TLBs
+printf "Test %1d (test-tlb_hrchy 4): " $((++test))
+check_output_with_file test-tlb_hrchy commands13.txt memory-dump-01.mem output/tlb-hrchy-13-out.txt --l1i 16:1 --l1d 16:1 --l2 64:1
+
+# huge pages (memory-dump-02.mem maps 2 MiB and 1 GiB pages, two of them misaligned):
+# the Kaby Lake hierarchy (--policy LRU alone selects its defaults), whose large 4 kiB
+# arrays are only checked through --stats,
+# then small 4 kiB arrays with the Kaby Lake huge-page ones, with and without the 2 MiB
+# L2 array (the pages are splintered), then all the arrays unified, and small arrays
+# whose L2 evictions back-invalidate the parts of the pages splintered in L1
+printf "Test %1d (test-tlb_hrchy huge pages): " $((++test))
+check_stats_with_file test-tlb_hrchy commands07.txt memory-dump-02.mem output/tlb-hrchy-02-stats.txt --policy LRU
+
+printf "Test %1d (test-tlb_hrchy huge pages, small): " $((++test))
+check_output_and_stats_with_file test-tlb_hrchy commands07.txt memory-dump-02.mem \
+    output/tlb-hrchy-02-small-out.txt output/tlb-hrchy-02-small-stats.txt --l1i 8:2 --l1d 8:2 --l2 16:4
+
+printf "Test %1d (test-tlb_hrchy huge pages, small, --l2-2m none): " $((++test))
+check_output_and_stats_with_file test-tlb_hrchy commands07.txt memory-dump-02.mem \
+    output/tlb-hrchy-02-small-l2-2m-none-out.txt output/tlb-hrchy-02-small-l2-2m-none-stats.txt \
+    --l1i 8:2 --l1d 8:2 --l2 16:4 --l2-2m none
+
+printf "Test %1d (test-tlb_hrchy huge pages, unified): " $((++test))
+check_output_and_stats_with_file test-tlb_hrchy commands07.txt memory-dump-02.mem \
+    output/tlb-hrchy-02-unified-out.txt output/tlb-hrchy-02-unified-stats.txt \
+    --l1i 8:2 --l1d 8:2 --l2 16:4 --l1i-2m unified --l1i-1g unified --l1d-2m unified --l1d-1g unified \
+    --l2-2m unified --l2-1g unified
+
+printf "Test %1d (test-tlb_hrchy huge pages, splintered): " $((++test))
+check_output_and_stats_with_file test-tlb_hrchy commands07.txt memory-dump-02.mem \
+    output/tlb-hrchy-02-splintered-out.txt output/tlb-hrchy-02-splintered-stats.txt \
+    --l1i 16:4 --l1d 16:4 --l1i-2m none --l1d-2m none --l1d-1g none --l2 8:2 --l2-2m 2:2 --l2-1g 1:1
+
+# walks of pages that share their PGD, PUD and PMD entries: the paging-structure caches
+# shorten them, without them all the walks read the four entries, and the translations
+# are the same
+printf "Test %1d (test-tlb_hrchy paging-structure caches): " $((++test))
+check_output_and_stats_with_file test-tlb_hrchy commands08.txt memory-dump-02.mem \
+    output/tlb-hrchy-03-out.txt output/tlb-hrchy-03-stats.txt --l1i 8:2 --l1d 8:2 --l2 16:4
+
+printf "Test %1d (test-tlb_hrchy no paging-structure caches): " $((++test))
+check_output_and_stats_with_file test-tlb_hrchy commands08.txt memory-dump-02.mem \
+    output/tlb-hrchy-03-out.txt output/tlb-hrchy-03-pwc-none-stats.txt --l1i 8:2 --l1d 8:2 --l2 16:4 \
+    --pwc-pgd none --pwc-pud none --pwc-pmd none
+
 # ======================================================================
 echo "SUCCESS"
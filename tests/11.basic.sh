@@ -24,7 +24,7 @@ check_output_with_file() {
     
     mytmp="$(new_tmp_file)"
     # gets stdout in case of success, stderr in case of error
-    ACTUAL_OUTPUT="$("$1" "$2" "$memfile" "$cmdfile" 2>"$mytmp" || cat "$mytmp")"
+    ACTUAL_OUTPUT="$("$1" "$2" "$memfile" "$cmdfile" "${@:6}" 2>"$mytmp" || cat "$mytmp")"
 
     diff -w <(echo "$ACTUAL_OUTPUT") <(cat "$refoutput") \
         && echo "PASS" \
@@ -37,5 +37,94 @@ check_output_with_file() {
 printf "Test %1d (test-cache 1): " $((++test))
 check_output_with_file test-cache dump memory-dump-01.mem commands01.txt output/cache-01-out.txt
 
+# ======================================================================
+# replacement policies on one set of 4 ways, refilled with re-references
+for policy in LRU PLRU SRRIP BRRIP FIFO RANDOM; do
+    printf "Test %1d (test-cache --policy $policy): " $((++test))
+    check_output_with_file test-cache dump memory-dump-01.mem commands09.txt \
+        output/cache-09-${policy,,}-out.txt \
+        --l1i 1:1:16 --l1d 1:4:16 --l2 1:4:16 --policy $policy --seed 7 --stats
+done
+
+# ======================================================================
+# inclusion policies of L2 on a tiny hierarchy where every line conflicts
+for inclusion in EXCLUSIVE INCLUSIVE NINE; do
+    printf "Test %1d (test-cache --inclusion $inclusion): " $((++test))
+    check_output_with_file test-cache dump memory-dump-01.mem commands03.txt \
+        output/cache-03-${inclusion,,}-out.txt \
+        --l1i 2:1:16 --l1d 2:1:16 --l2 2:2:16 --inclusion $inclusion --batch 3 --stats
+done
+
+# ======================================================================
+# shared L3 as small as L2, whose evictions back-invalidate the private levels
+for inclusion in INCLUSIVE EXCLUSIVE NINE; do
+    printf "Test %1d (test-cache --l3-inclusion $inclusion): " $((++test))
+    check_output_with_file test-cache dump memory-dump-01.mem commands03.txt \
+        output/cache-03-l3-${inclusion,,}-out.txt \
+        --l1i 2:1:16 --l1d 2:1:16 --l2 2:2:16 --l3 2:2:16 --inclusion NINE \
+        --l3-inclusion $inclusion --batch 3 --stats
+done
+
+# ======================================================================
+# two cores writing and reading the same lines, kept coherent with MESI
+printf "Test %1d (test-cache --cores 2): " $((++test))
+check_output_with_file test-cache dump memory-dump-01.mem commands04.txt output/cache-04-cores-out.txt \
+    --cores 2 --l1i 2:1:16 --l1d 2:2:16 --l2 2:2:16 --batch 1 --stats
+
+# ======================================================================
+# prefetchers of degree 2 on sequential, then strided, reads: their prefetches are
+# useful, late (hit before they could have arrived) or useless (evicted unused)
+for level in l1d l2; do
+    for prefetch in NEXT_LINE STRIDE STREAM; do
+        printf "Test %1d (test-cache --$level-prefetch $prefetch): " $((++test))
+        check_output_with_file test-cache dump memory-dump-01.mem commands10.txt \
+            output/cache-10-$level-${prefetch,,}-out.txt \
+            --l1i 2:1:16 --l1d 4:2:16 --l2 8:2:16 --$level-prefetch $prefetch:2 --batch 5 --stats
+    done
+done
+
+# ======================================================================
+# misses of an in-order core with 1 and 4 MSHRs per level: the second access to a
+# line being filled merges into its MSHR, and "D" accesses wait for the previous read
+for mshrs in 1 4; do
+    printf "Test %1d (test-cache --mshrs $mshrs:$mshrs:$mshrs): " $((++test))
+    check_output_with_file test-cache dump memory-dump-01.mem commands11.txt \
+        output/cache-11-mshrs-$mshrs-out.txt \
+        --l1i 2:1:16 --l1d 4:2:16 --l2 8:2:16 --mshrs $mshrs:$mshrs:$mshrs --batch 5 --stats
+done
+
+# ======================================================================
+# 8, 16 and 32-byte loads and stores that cross 16-byte lines
+printf "Test %1d (test-cache D8/D16/D32): " $((++test))
+check_output_with_file test-cache dump memory-dump-01.mem commands05.txt output/cache-05-sizes-out.txt \
+    --l1i 2:1:16 --l1d 4:2:16 --l2 4:2:16 --batch 2 --stats
+
+# ======================================================================
+# bytes stored over nonzero bytes replace them, in the caches and in memory
+for write in write-through write-back; do
+    printf "Test %1d (test-cache byte stores, $write): " $((++test))
+    check_output_with_file test-cache dump memory-dump-01.mem commands06.txt output/cache-06-${write}-out.txt \
+        --l1i 2:1:16 --l1d 2:1:16 --l2 2:1:16 --batch 3 --stats $([ $write = write-back ] && echo --write-back)
+done
+
+# ======================================================================
+# way prediction, hit by the memo of the last line and by the MRU way of a set, or
+# mispredicted; both layouts predict the same ways
+for layout in aos soa; do
+    printf "Test %1d (test-cache --way-prediction, $layout): " $((++test))
+    check_output_with_file test-cache dump memory-dump-01.mem commands12.txt output/cache-12-way-prediction-out.txt \
+        --l1i 2:1:16 --l1d 2:2:16 --l2 2:2:16 --way-prediction --batch 6 --stats $([ $layout = soa ] && echo --soa)
+done
+
+# ======================================================================
+# flushes after every batch: the next batch refills the emptied levels. From epoch
+# 2^32 - 2, the second flush wraps the epochs around to 0 and clears the whole caches,
+# which must leave them as the lazy flushes of the other epochs do
+for epoch in 0 4294967294; do
+    printf "Test %1d (test-cache --flush 1 --epoch $epoch): " $((++test))
+    check_output_with_file test-cache dump memory-dump-01.mem commands03.txt output/cache-03-flush-out.txt \
+        --l1i 2:1:16 --l1d 2:2:16 --l2 2:2:16 --batch 3 --flush 1 --epoch $epoch --write-back --stats
+done
+
 # ======================================================================
 echo "SUCCESS"
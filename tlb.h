@@ -9,16 +9,58 @@
  */
 
 #include "addr.h"
+#include "list.h"
 
 #include <stdint.h>
 
 #define TLB_LINES 128 // the number of entries
 
 //Definition of a tlb entry
+//(an entry of a huge page holds the numbers of its first 4 kiB virtual and physical pages)
 typedef struct 
 {
     uint64_t tag : VIRT_PAGE_NUM;
     uint32_t phy_page_num : PHY_PAGE_NUM;
     uint8_t v : 1;
+    uint8_t page_size : 2; // page_size_t
     
 } tlb_entry_t;
+
+//Bits of a virtual (or physical) page number that are part of the offset in a page of the given size
+#define tlb_page_mask(SIZE) ((1u << page_size_shift(SIZE)) - 1)
+
+//Hits and misses of a TLB by the size of the page translated (see replacement_policy_t)
+typedef struct
+{
+    uint64_t hits[NB_PAGE_SIZES];
+    uint64_t misses[NB_PAGE_SIZES];
+
+} tlb_page_stats_t;
+
+
+/*
+ * Hash index of a fully-associative TLB of `lines` entries (a power of 2, at most
+ * TLB_INDEX_MAX_LINES), allocated by the caller next to the TLB (see tlb_index_size()):
+ *  - an open-addressing (linear probing) table of 2 * lines slots, from the virtual page
+ *    number of each valid entry to the entry, TLB_INDEX_NONE for an empty slot;
+ *  - the LRU order of the entries, an array list (see array_list_t) whose node i holds
+ *    entry i, from the least recently used to the most recent.
+ * Hits and misses then take constant time instead of a walk of the replacement list. An
+ * entry is hashed by its tag, so a lookup probes once per page size, skipping the huge
+ * page sizes that no entry has.
+ */
+#define TLB_INDEX_MAX_LINES 4096
+#define TLB_INDEX_NONE      UINT16_MAX
+
+typedef struct
+{
+    uint16_t lines;
+    uint8_t slot_bits;  // log2 of the number of slots
+    uint16_t sized_entries[NB_PAGE_SIZES]; // valid entries of each page size
+    array_list_t order; // LRU order, its front is the next victim
+    uint16_t slots[];   // hash slots, then the nodes of order
+
+} tlb_index_t;
+
+#define tlb_index_slots(INDEX) ((INDEX)->slots)
+#define tlb_index_nodes(INDEX) ((array_node_t *) ((INDEX)->slots + 2 * (size_t) (INDEX)->lines))
@@ -9,8 +9,11 @@
  */
 
 #include "addr.h"
+#include "cache.h" // for cache_replace_t
+#include "page_walk.h" // for page_walk_cache_t
 
 #include <stdint.h>
+#include <stddef.h> // for size_t
 
 #define L1_ITLB_WAYS    1   // Direct mapped
 // Do not modify the number of lines.
@@ -50,4 +53,129 @@ typedef struct l2_tlb_entry {
     uint8_t v : 1;
 } l2_tlb_entry_t;
 
-typedef enum {L1_ITLB, L1_DTLB, L2_TLB} tlb_t;
\ No newline at end of file
+typedef enum {L1_ITLB, L1_DTLB, L2_TLB} tlb_t;
+
+/**
+ * Latency model of a translation (see tlb_search_timed()), in cycles: a lookup of each
+ * level down to the one that translates, plus a page walk of TLB_WALK_READS dependent
+ * page-table reads if none does. With the runtime-configured TLBs, the walk reads one less
+ * entry for a 2 MiB page and two less for a 1 GiB page, and starts from the paging-structure
+ * caches if any (see page_walk_cached()).
+ */
+#define L1_TLB_HIT_LATENCY     1u
+#define L2_TLB_HIT_LATENCY     7u
+#define TLB_WALK_READ_LATENCY  42u // a page-table read, which mostly hits the data caches
+#define TLB_WALK_READS         4u  // PGD, PUD, PMD and PTE entries
+
+//=========================================================================
+/**
+ * Runtime-configured TLBs (see tlb_config_init() and tlb_hrchy_search()): an L1 ITLB and
+ * an L1 DTLB, backed by a unified L2 TLB that includes them. Each level has `entries`
+ * entries in sets of `ways` ways (sets = entries / ways, a power of 2), indexed by the
+ * low bits of the virtual page number, and one of the replacement policies of the caches
+ * (see replacement.h). The TLB_KBL_* geometry is that of Kaby Lake.
+ *
+ * Each level has one such array per page size (see tlb_hrchy_t): the 4 kiB one, and
+ * optionally a 2 MiB one and a 1 GiB one, probed together. A huge page is cached in the
+ * array of its size, or if the level has none in the array of the largest smaller size,
+ * by the part of the page that is accessed (it is splintered). The same array may be
+ * given for several sizes: it is then unified, and each entry records its page size.
+ * Kaby Lake has a 2 MiB L1 ITLB array, 2 MiB and 1 GiB L1 DTLB arrays, and a 1 GiB L2
+ * array, its 4 kiB L2 array also caching the 2 MiB pages.
+ *
+ * A level is one block: each set is its replacement state word followed by its
+ * tlb_way_t, then come the statistics, then the flush epochs (see tlb_set_current()).
+ */
+#define TLB_KBL_L1_ITLB_ENTRIES 128
+#define TLB_KBL_L1_ITLB_WAYS    8
+#define TLB_KBL_L1_DTLB_ENTRIES 64
+#define TLB_KBL_L1_DTLB_WAYS    4
+#define TLB_KBL_L2_TLB_ENTRIES  1536
+#define TLB_KBL_L2_TLB_WAYS     12
+#define TLB_KBL_L1_ITLB_2M_ENTRIES 8
+#define TLB_KBL_L1_ITLB_2M_WAYS    8
+#define TLB_KBL_L1_DTLB_2M_ENTRIES 32
+#define TLB_KBL_L1_DTLB_2M_WAYS    4
+#define TLB_KBL_L1_DTLB_1G_ENTRIES 4
+#define TLB_KBL_L1_DTLB_1G_WAYS    4
+#define TLB_KBL_L2_TLB_1G_ENTRIES  16
+#define TLB_KBL_L2_TLB_1G_WAYS     4
+
+// Default paging-structure caches of the page walks (see page_walk_cache_t), sized as
+// the small PML4, PDPT and PDE caches of Intel cores
+#define TLB_PWC_PGD_ENTRIES 2
+#define TLB_PWC_PGD_WAYS    2
+#define TLB_PWC_PUD_ENTRIES 4
+#define TLB_PWC_PUD_WAYS    4
+#define TLB_PWC_PMD_ENTRIES 32
+#define TLB_PWC_PMD_WAYS    4
+
+#define TLB_MAX_WAYS 64
+#define TLB_WAY_MISS UINT8_MAX
+
+typedef struct {
+    uint64_t tag;           // page number (in pages of page_size) without its set index bits
+    uint32_t phy_page_num;  // first 4 kiB physical page of the page
+    uint8_t v;
+    uint8_t age;            // replacement state of the way (see replacement.h)
+    uint8_t page_size;      // page_size_t
+} tlb_way_t;
+
+typedef struct {
+    uint64_t hits[NB_PAGE_SIZES];   // by the size of the page of the entry that hits
+    uint64_t misses[NB_PAGE_SIZES]; // by the size of the page of the entry then filled
+    uint64_t fills;
+    uint64_t evictions;          // valid entries replaced by a fill
+    uint64_t back_invalidations; // L1 entries invalidated because the L2 TLB evicted them
+} tlb_stats_t;
+
+typedef struct {
+    tlb_t type;
+    uint16_t entries;
+    uint8_t ways;
+    uint16_t sets;
+    uint8_t index_bits;      // log2(sets)
+    cache_replace_t policy;
+    uint64_t seed;           // RANDOM policy, CACHE_DEFAULT_SEED after tlb_config_init()
+    uint8_t age_bits;        // LRU/FIFO: ages packed in the set state word, as for the caches
+    uint64_t age_lanes;
+    size_t set_size;
+    size_t stats_offset;     // tlb_stats_t, after the sets
+    size_t epoch_offset;     // flush epoch of the level, then of each set, last
+} tlb_config_t;
+
+#define tlb_set(CFG, TLB, SET) \
+        ((char *) (TLB) + (size_t) (SET) * (CFG)->set_size)
+
+#define tlb_set_state(CFG, TLB, SET) \
+        (*(uint64_t *) tlb_set(CFG, TLB, SET))
+
+#define tlb_way(CFG, TLB, SET, WAY) \
+        (((tlb_way_t *) (tlb_set(CFG, TLB, SET) + sizeof(uint64_t)))[WAY])
+
+#define tlb_stats(CFG, TLB) \
+        ((tlb_stats_t *) ((char *) (TLB) + (CFG)->stats_offset))
+
+// Flush epochs, as those of the caches: tlb_level_flush() only starts a new epoch of the
+// level. A set whose epoch is an older one holds no valid entry, whatever its ways say,
+// and is emptied when it is next filled.
+#define tlb_epoch(CFG, TLB) \
+        (*(uint32_t *) ((char *) (TLB) + (CFG)->epoch_offset))
+
+#define tlb_set_epoch(CFG, TLB, SET) \
+        (((uint32_t *) ((char *) (TLB) + (CFG)->epoch_offset + sizeof(uint64_t)))[SET])
+
+#define tlb_set_current(CFG, TLB, SET) \
+        (tlb_set_epoch(CFG, TLB, SET) == tlb_epoch(CFG, TLB))
+
+// The levels of a hierarchy and their configurations, by page size: the PAGE_4K arrays
+// are required, the others are NULL for none; then the caches of its page walks
+typedef struct {
+    void * l1_itlb[NB_PAGE_SIZES];
+    const tlb_config_t * l1_icfg[NB_PAGE_SIZES];
+    void * l1_dtlb[NB_PAGE_SIZES];
+    const tlb_config_t * l1_dcfg[NB_PAGE_SIZES];
+    void * l2_tlb[NB_PAGE_SIZES];
+    const tlb_config_t * l2_cfg[NB_PAGE_SIZES];
+    page_walk_cache_t * walk_cache; // NULL for none
+} tlb_hrchy_t;
@@ -11,6 +11,11 @@
 #include <string.h> // for memset()
 #include <inttypes.h> // for SCNx macros
 
+// The replacement policies of the caches work on the sets of the runtime-configured TLBs
+#define replacement_age(CFG, TLB, SET, WAY) (tlb_way(CFG, TLB, SET, WAY).age)
+#define replacement_state(CFG, TLB, SET)    tlb_set_state(CFG, TLB, SET)
+#include "replacement.h"
+
 // Define mask 
 #define mask6bit 63
 #define mask4bit 15
@@ -39,22 +44,17 @@ int invalidation(l1_itlb_entry_t * l1_itlb,
                 VAR->tag = (virtual_page_number >> LINES);
     
 #define flush(TYPE,LINES) \
-   TYPE* VAR = (TYPE*) tlb;\
-        for(size_t i = 0; i < LINES; i++){ \
-            VAR[i].v = 0; \
-            VAR[i].tag = 0; \
-            VAR[i].phy_page_num = 0; \
-        }
+        memset(tlb, 0, (LINES) * sizeof(TYPE));
 
 #define insert(TYPE, LINES) \
     TYPE* VAR_TLB = (TYPE*) tlb; \
         TYPE* VAR_ENTRY = (TYPE*) tlb_entry; \
         VAR_TLB[line_index] = *VAR_ENTRY; 
     
-#define hit(TYPE, LINES) \
+#define hit(TYPE, LINES_BITS, LINES) \
   TYPE* VAR = (TYPE*) tlb; \
-        uint32_t tag = addr >> LINES; \
-        uint32_t index = addr & mask4bit; \
+        uint32_t tag = addr >> LINES_BITS; \
+        uint32_t index = addr & ((LINES) - 1); \
         if ((tag == VAR[index].tag) && (1 == VAR[index].v)) { \
             paddr->phy_page_num = VAR[index].phy_page_num; \
             paddr->page_offset = offset; \
@@ -101,11 +101,11 @@ int tlb_flush(void *tlb, tlb_t tlb_type){
 
         // Find the correct type of tlb and put every value of the tlb_entries in there to 0
         if(tlb_type == L1_DTLB){
-            flush(l1_dtlb_entry_t, L1_DTLB_LINES_BITS);
+            flush(l1_dtlb_entry_t, L1_DTLB_LINES);
         } else if(tlb_type == L1_ITLB){
-            flush(l1_itlb_entry_t, L1_ITLB_LINES_BITS);
+            flush(l1_itlb_entry_t, L1_ITLB_LINES);
         } else if(tlb_type == L2_TLB){
-            flush(l2_tlb_entry_t, L2_TLB_LINES_BITS);
+            flush(l2_tlb_entry_t, L2_TLB_LINES);
         } else{
             return ERR_BAD_PARAMETER;
         }
@@ -157,11 +157,11 @@ int tlb_hit( const virt_addr_t * vaddr,
         uint32_t offset = vaddr->page_offset;
 
         if(tlb_type == L1_DTLB){
-            hit(l1_dtlb_entry_t, L1_DTLB_LINES_BITS);
+            hit(l1_dtlb_entry_t, L1_DTLB_LINES_BITS, L1_DTLB_LINES);
         } else if(tlb_type == L1_ITLB){
-            hit(l1_itlb_entry_t, L1_ITLB_LINES_BITS);
+            hit(l1_itlb_entry_t, L1_ITLB_LINES_BITS, L1_ITLB_LINES);
         } else if(tlb_type == L2_TLB){
-            hit(l2_tlb_entry_t, L2_TLB_LINES_BITS);
+            hit(l2_tlb_entry_t, L2_TLB_LINES_BITS, L2_TLB_LINES);
         } else{
             return 0;
         }
@@ -251,6 +251,34 @@ int tlb_search( const void * mem_space,
 }
 
 
+int tlb_search_timed( const void * mem_space,
+                      const virt_addr_t * vaddr,
+                      phy_addr_t * paddr,
+                      mem_access_t access,
+                      l1_itlb_entry_t * l1_itlb,
+                      l1_dtlb_entry_t * l1_dtlb,
+                      l2_tlb_entry_t * l2_tlb,
+                      int* hit_or_miss,
+                      uint32_t* cycles){
+
+        M_REQUIRE_NON_NULL(cycles);
+
+        //LEVEL THAT TRANSLATES, BEFORE THE SEARCH FILLS THE TLBS (A LOOKUP CHANGES NOTHING)
+        const int l1_hit = access == INSTRUCTION ? tlb_hit(vaddr, paddr, l1_itlb, L1_ITLB)
+                                                 : tlb_hit(vaddr, paddr, l1_dtlb, L1_DTLB);
+        const int l2_hit = !l1_hit && tlb_hit(vaddr, paddr, l2_tlb, L2_TLB);
+
+        int err = tlb_search(mem_space, vaddr, paddr, access, l1_itlb, l1_dtlb, l2_tlb, hit_or_miss);
+        if (err != ERR_NONE) return err;
+
+        *cycles = L1_TLB_HIT_LATENCY;
+        if (!l1_hit) *cycles += L2_TLB_HIT_LATENCY;
+        if (!l1_hit && !l2_hit) *cycles += TLB_WALK_READS * TLB_WALK_READ_LATENCY;
+
+        return ERR_NONE;
+}
+
+
 // Name of variable are explicit
 // @param      l1_itlb              
 // @param      l1_dtlb              
@@ -379,4 +407,317 @@ int invalidation(l1_itlb_entry_t * l1_itlb,
                         break;
                 }
 
-}
\ No newline at end of file
+}
+
+
+// ######################################################## RUNTIME-CONFIGURED TLBS ########################################################
+
+static inline int is_power_of_2(uint32_t x)
+{
+    return x != 0 && (x & (x - 1)) == 0;
+}
+
+static inline void tlb_policy_hit(void * tlb, const tlb_config_t * cfg, uint8_t way, uint16_t set)
+{
+    switch (cfg->policy) {
+#define POLICY_HIT(POLICY, ARG) case POLICY: POLICY##_hit(cfg, tlb, way, set); break;
+    CACHE_POLICIES(POLICY_HIT, _)
+#undef POLICY_HIT
+    }
+}
+
+static inline void tlb_policy_fill(void * tlb, const tlb_config_t * cfg, uint8_t way, uint16_t set)
+{
+    switch (cfg->policy) {
+#define POLICY_FILL(POLICY, ARG) case POLICY: POLICY##_fill(cfg, tlb, way, set); break;
+    CACHE_POLICIES(POLICY_FILL, _)
+#undef POLICY_FILL
+    }
+}
+
+// Way to fill in a set: the first invalid one, else the victim of the policy
+static uint8_t tlb_policy_victim(void * tlb, const tlb_config_t * cfg, uint16_t set)
+{
+    for (uint8_t way = 0; way < cfg->ways; way++) {
+        if (!tlb_way(cfg, tlb, set, way).v) return way;
+    }
+
+    uint8_t way = 0;
+    switch (cfg->policy) {
+    case LRU:    LRU_victim(cfg, tlb, set, way); break;
+    case PLRU:   PLRU_victim(cfg, tlb, set, way); break;
+    case SRRIP:  SRRIP_victim(cfg, tlb, set, way); break;
+    case BRRIP:  BRRIP_victim(cfg, tlb, set, way); break;
+    case FIFO:   FIFO_victim(cfg, tlb, set, way); break;
+    case RANDOM: RANDOM_victim(cfg, tlb, set, cfg->seed, way); break;
+    }
+    return way;
+}
+
+// Make a set current before it is filled, emptying it if the level was flushed since its last fill
+static inline void tlb_set_refresh(void * tlb, const tlb_config_t * cfg, uint16_t set)
+{
+    if (tlb_set_current(cfg, tlb, set)) return;
+    memset(tlb_set(cfg, tlb, set), 0, cfg->set_size);
+    tlb_set_epoch(cfg, tlb, set) = tlb_epoch(cfg, tlb);
+}
+
+#define tlb_set_of(CFG, VPN) ((uint16_t) ((VPN) & ((uint64_t) (CFG)->sets - 1)))
+#define tlb_tag_of(CFG, VPN) ((VPN) >> (CFG)->index_bits)
+
+// Way of an array that translates page_number, the number of a page of page_size, TLB_WAY_MISS if none
+static uint8_t tlb_level_find(const void * tlb, const tlb_config_t * cfg, uint64_t page_number, page_size_t page_size)
+{
+    const uint16_t set = tlb_set_of(cfg, page_number);
+    const uint64_t tag = tlb_tag_of(cfg, page_number);
+    if (!tlb_set_current(cfg, tlb, set)) return TLB_WAY_MISS;
+    for (uint8_t way = 0; way < cfg->ways; way++) {
+        const tlb_way_t * entry = &tlb_way(cfg, tlb, set, way);
+        if (entry->v && entry->tag == tag && entry->page_size == page_size) return way;
+    }
+    return TLB_WAY_MISS;
+}
+
+// Lookup of an array for the page of page_size that virtual_page_number is in: a hit is
+// counted and updates the replacement state
+static int tlb_level_lookup(void * tlb, const tlb_config_t * cfg, uint64_t virtual_page_number,
+                            page_size_t page_size, phy_addr_t * paddr)
+{
+    const uint64_t page_number = virtual_page_number >> page_size_shift(page_size);
+    const uint8_t way = tlb_level_find(tlb, cfg, page_number, page_size);
+    if (way == TLB_WAY_MISS) return 0;
+
+    const uint16_t set = tlb_set_of(cfg, page_number);
+    tlb_policy_hit(tlb, cfg, way, set);
+    tlb_stats(cfg, tlb)->hits[page_size]++;
+    paddr->phy_page_num = tlb_way(cfg, tlb, set, way).phy_page_num
+                          | (uint32_t) (virtual_page_number & ((1u << page_size_shift(page_size)) - 1));
+    return 1;
+}
+
+// Lookup of all the arrays of a level; *p_page_size is set to the size of the entry that hits
+static int tlb_levels_lookup(void * const tlbs[], const tlb_config_t * const cfgs[], uint64_t virtual_page_number,
+                             phy_addr_t * paddr, page_size_t * p_page_size)
+{
+    for (page_size_t size = PAGE_4K; size < NB_PAGE_SIZES; size++) {
+        if (tlbs[size] != NULL && tlb_level_lookup(tlbs[size], cfgs[size], virtual_page_number, size, paddr)) {
+            *p_page_size = size;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Size of the entries a level caches a page of page_size with: its own, or the largest
+// smaller size the level has an array for (the page is then splintered)
+static page_size_t tlb_levels_fit(void * const tlbs[], page_size_t page_size)
+{
+    while (page_size > PAGE_4K && tlbs[page_size] == NULL) page_size--;
+    return page_size;
+}
+
+// Fill an array with the page of page_size that virtual_page_number is in, which missed
+// (paddr is its translation); *p_evicted is set to 1 (and *p_evicted_number and
+// *p_evicted_size to its page number and page size) if a valid entry is replaced
+static void tlb_level_fill(void * tlb, const tlb_config_t * cfg, uint64_t virtual_page_number,
+                           page_size_t page_size, const phy_addr_t * paddr,
+                           int * p_evicted, uint64_t * p_evicted_number, page_size_t * p_evicted_size)
+{
+    const uint64_t page_number = virtual_page_number >> page_size_shift(page_size);
+    const uint16_t set = tlb_set_of(cfg, page_number);
+    tlb_set_refresh(tlb, cfg, set);
+    const uint8_t way = tlb_policy_victim(tlb, cfg, set);
+    tlb_way_t * entry = &tlb_way(cfg, tlb, set, way);
+
+    *p_evicted = entry->v;
+    if (entry->v) {
+        *p_evicted_number = (entry->tag << cfg->index_bits) | set;
+        *p_evicted_size = (page_size_t) entry->page_size;
+        tlb_stats(cfg, tlb)->evictions++;
+    }
+    entry->tag = tlb_tag_of(cfg, page_number);
+    entry->phy_page_num = paddr->phy_page_num & ~((1u << page_size_shift(page_size)) - 1);
+    entry->v = 1;
+    entry->page_size = (uint8_t) page_size;
+    tlb_policy_fill(tlb, cfg, way, set);
+    tlb_stats(cfg, tlb)->misses[page_size]++;
+    tlb_stats(cfg, tlb)->fills++;
+}
+
+// Invalidate the entries of page_size of an L1 array that translate a part of the page
+// page_number of evicted_size, evicted from L2 (page_size is never larger: see tlb_levels_fit())
+static void tlb_level_back_invalidate(void * tlb, const tlb_config_t * cfg, page_size_t page_size,
+                                      uint64_t page_number, page_size_t evicted_size)
+{
+    //CASE SAME SIZE: AT MOST ONE ENTRY
+    if (page_size == evicted_size) {
+        const uint8_t way = tlb_level_find(tlb, cfg, page_number, page_size);
+        if (way == TLB_WAY_MISS) return;
+
+        tlb_way(cfg, tlb, tlb_set_of(cfg, page_number), way).v = 0;
+        tlb_stats(cfg, tlb)->back_invalidations++;
+        return;
+    }
+
+    //CASE SPLINTERED IN L1: ANY ENTRY OF THE ARRAY MAY BE A PART OF THE PAGE
+    const unsigned int shift = page_size_shift(evicted_size) - page_size_shift(page_size);
+    for (uint16_t set = 0; set < cfg->sets; set++) {
+        if (!tlb_set_current(cfg, tlb, set)) continue;
+        for (uint8_t way = 0; way < cfg->ways; way++) {
+            tlb_way_t * entry = &tlb_way(cfg, tlb, set, way);
+            if (entry->v && entry->page_size == page_size
+                && (((entry->tag << cfg->index_bits) | set) >> shift) == page_number) {
+                entry->v = 0;
+                tlb_stats(cfg, tlb)->back_invalidations++;
+            }
+        }
+    }
+}
+
+// Back-invalidation of a page evicted from L2 in all the arrays of an L1 level
+static void tlb_levels_back_invalidate(void * const tlbs[], const tlb_config_t * const cfgs[],
+                                       uint64_t page_number, page_size_t evicted_size)
+{
+    for (page_size_t size = PAGE_4K; size <= evicted_size; size++) {
+        if (tlbs[size] != NULL) tlb_level_back_invalidate(tlbs[size], cfgs[size], size, page_number, evicted_size);
+    }
+}
+
+
+int tlb_config_init(tlb_config_t * cfg, tlb_t type, uint16_t entries, uint8_t ways, cache_replace_t policy){
+
+    M_REQUIRE_NON_NULL(cfg);
+    M_REQUIRE(type >= L1_ITLB && type <= L2_TLB, ERR_BAD_PARAMETER, "%d: unknown TLB type", type);
+    M_REQUIRE(policy >= LRU && policy <= RANDOM, ERR_POLICY, "%d: unknown replacement policy", policy);
+    M_REQUIRE(policy != PLRU || is_power_of_2(ways), ERR_POLICY,
+              "tree-PLRU needs a power-of-2 number of ways (%u)", ways);
+    M_REQUIRE(ways > 0 && ways <= TLB_MAX_WAYS && entries % ways == 0 && is_power_of_2(entries / ways),
+              ERR_SIZE, "%u entries in %u-way sets: bad geometry", entries, ways);
+
+    cfg->type = type;
+    cfg->entries = entries;
+    cfg->ways = ways;
+    cfg->sets = (uint16_t) (entries / ways);
+    cfg->index_bits = (uint8_t) __builtin_ctz(cfg->sets);
+    cfg->policy = policy;
+    cfg->seed = CACHE_DEFAULT_SEED;
+    cfg->age_bits = LRU_PACKED_AGE_BITS(policy, ways);
+    cfg->age_lanes = cfg->age_bits ? LRU_AGE_LANES(cfg->age_bits, ways) : 0;
+    cfg->set_size = sizeof(uint64_t) + ways * sizeof(tlb_way_t);
+    cfg->stats_offset = cfg->sets * cfg->set_size;
+    cfg->epoch_offset = cfg->stats_offset + sizeof(tlb_stats_t);
+
+    return ERR_NONE;
+}
+
+
+size_t tlb_level_size(const tlb_config_t * cfg){
+    return cfg == NULL ? 0 : cfg->epoch_offset + sizeof(uint64_t) + (size_t) cfg->sets * sizeof(uint32_t);
+}
+
+
+int tlb_level_flush(void * tlb, const tlb_config_t * cfg){
+
+    M_REQUIRE_NON_NULL(tlb);
+    M_REQUIRE_NON_NULL(cfg);
+
+    //A NEW EPOCH: THE SETS ARE EMPTIED WHEN NEXT FILLED (SEE tlb_set_refresh())
+    if (++tlb_epoch(cfg, tlb) == 0) {
+        //CASE THE EPOCH WRAPS AROUND: A SET LEFT SINCE THEN WOULD LOOK CURRENT, SO ALL ARE EMPTIED NOW
+        memset(tlb, 0, cfg->stats_offset);
+        memset(&tlb_set_epoch(cfg, tlb, 0), 0, (size_t) cfg->sets * sizeof(uint32_t));
+    }
+    return ERR_NONE;
+}
+
+
+int tlb_level_get_stats(const void * tlb, const tlb_config_t * cfg, tlb_stats_t * stats){
+
+    M_REQUIRE_NON_NULL(tlb);
+    M_REQUIRE_NON_NULL(cfg);
+    M_REQUIRE_NON_NULL(stats);
+
+    *stats = *tlb_stats(cfg, tlb);
+    return ERR_NONE;
+}
+
+
+int tlb_level_dump(FILE * output, const void * tlb, const tlb_config_t * cfg){
+
+    M_REQUIRE_NON_NULL(output);
+    M_REQUIRE_NON_NULL(tlb);
+    M_REQUIRE_NON_NULL(cfg);
+
+    for (uint16_t set = 0; set < cfg->sets; set++) {
+        const int current = tlb_set_current(cfg, tlb, set);
+        for (uint8_t way = 0; way < cfg->ways; way++) {
+            const tlb_way_t * entry = &tlb_way(cfg, tlb, set, way);
+            if (current && entry->v) fprintf(output, "1; %08" PRIX64 "; %05" PRIX32 ";\n", entry->tag, entry->phy_page_num);
+            else fputs("0; --------; -----;\n", output);
+        }
+    }
+    return ERR_NONE;
+}
+
+
+int tlb_hrchy_search( const void * mem_space,
+                      const tlb_hrchy_t * hrchy,
+                      const virt_addr_t * vaddr,
+                      phy_addr_t * paddr,
+                      mem_access_t access,
+                      int* hit_or_miss,
+                      uint32_t* cycles){
+
+        M_REQUIRE_NON_NULL(mem_space);
+        M_REQUIRE_NON_NULL(hrchy);
+        M_REQUIRE_NON_NULL(vaddr);
+        M_REQUIRE_NON_NULL(paddr);
+        M_REQUIRE_NON_NULL(hit_or_miss);
+        M_REQUIRE(access == INSTRUCTION || access == DATA, ERR_BAD_PARAMETER, "%d: bad access", access);
+
+        void * const * l1 = access == INSTRUCTION ? hrchy->l1_itlb : hrchy->l1_dtlb;
+        const tlb_config_t * const * l1_cfg = access == INSTRUCTION ? hrchy->l1_icfg : hrchy->l1_dcfg;
+        M_REQUIRE(l1[PAGE_4K] != NULL && l1_cfg[PAGE_4K] != NULL && hrchy->l2_tlb[PAGE_4K] != NULL
+                  && hrchy->l2_cfg[PAGE_4K] != NULL, ERR_BAD_PARAMETER, "%s", "no 4 kiB TLB array");
+        const uint64_t virtual_page_number = virt_addr_t_to_virtual_page_number(vaddr);
+        paddr->page_offset = vaddr->page_offset;
+        uint32_t latency = L1_TLB_HIT_LATENCY;
+
+        //CASE L1 HIT
+        page_size_t page_size = PAGE_4K;
+        *hit_or_miss = tlb_levels_lookup(l1, l1_cfg, virtual_page_number, paddr, &page_size);
+        if (*hit_or_miss == 0) {
+            latency += L2_TLB_HIT_LATENCY;
+            *hit_or_miss = tlb_levels_lookup(hrchy->l2_tlb, hrchy->l2_cfg, virtual_page_number, paddr, &page_size);
+
+            //CASE L2 MISS: THE PAGE WALK FILLS L2, WHICH INVALIDATES WHAT IT EVICTS IN THE L1 TLBS
+            if (*hit_or_miss == 0) {
+                uint32_t reads = TLB_WALK_READS;
+                int err = page_walk_cached(mem_space, hrchy->walk_cache, vaddr, paddr, &page_size, &reads);
+                if (err != ERR_NONE) return err;
+                latency += reads * TLB_WALK_READ_LATENCY;
+
+                page_size = tlb_levels_fit(hrchy->l2_tlb, page_size);
+                int evicted = 0;
+                uint64_t evicted_number = 0;
+                page_size_t evicted_size = PAGE_4K;
+                tlb_level_fill(hrchy->l2_tlb[page_size], hrchy->l2_cfg[page_size], virtual_page_number, page_size,
+                               paddr, &evicted, &evicted_number, &evicted_size);
+                if (evicted) {
+                    tlb_levels_back_invalidate(hrchy->l1_itlb, hrchy->l1_icfg, evicted_number, evicted_size);
+                    tlb_levels_back_invalidate(hrchy->l1_dtlb, hrchy->l1_dcfg, evicted_number, evicted_size);
+                }
+            }
+
+            //THE L1 TLB OF THE ACCESS IS FILLED, WITH ENTRIES NO LARGER THAN THOSE OF L2 (WHAT IT EVICTS STAYS IN L2)
+            page_size = tlb_levels_fit(l1, page_size);
+            int evicted = 0;
+            uint64_t evicted_number = 0;
+            page_size_t evicted_size = PAGE_4K;
+            tlb_level_fill(l1[page_size], l1_cfg[page_size], virtual_page_number, page_size, paddr,
+                           &evicted, &evicted_number, &evicted_size);
+        }
+
+        if (cycles != NULL) *cycles = latency;
+        return ERR_NONE;
+}
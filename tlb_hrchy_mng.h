@@ -11,6 +11,7 @@
 #include "tlb_hrchy.h"
 #include "mem_access.h"
 #include "addr.h"
+#include <stdio.h> // for FILE
 
 //=========================================================================
 /**
@@ -97,3 +98,114 @@ int tlb_search( const void * mem_space,
                 l1_dtlb_entry_t * l1_dtlb,
                 l2_tlb_entry_t * l2_tlb,
                 int* hit_or_miss);
+
+//=========================================================================
+/**
+ * @brief Ask TLB for the translation, as tlb_search() does, and give its latency
+ *        (see the latency model in tlb_hrchy.h).
+ *
+ * @param mem_space pointer to the memory space
+ * @param vaddr pointer to virtual address
+ * @param paddr (modified) pointer to physical address (returned from TLB)
+ * @param access to distinguish between fetching instructions and reading/writing data
+ * @param l1_itlb pointer to the beginning of L1 ITLB
+ * @param l1_dtlb pointer to the beginning of L1 DTLB
+ * @param l2_tlb pointer to the beginning of L2 TLB
+ * @param hit_or_miss (modified) hit (1) or miss (0)
+ * @param cycles (modified) latency of the translation
+ * @return error code
+ */
+
+int tlb_search_timed( const void * mem_space,
+                      const virt_addr_t * vaddr,
+                      phy_addr_t * paddr,
+                      mem_access_t access,
+                      l1_itlb_entry_t * l1_itlb,
+                      l1_dtlb_entry_t * l1_dtlb,
+                      l2_tlb_entry_t * l2_tlb,
+                      int* hit_or_miss,
+                      uint32_t* cycles);
+
+//=========================================================================
+/**
+ * @brief Initialize the configuration of a runtime-configured TLB level (see tlb_config_t).
+ *
+ * @param cfg (modified) the configuration to initialize
+ * @param type the level: L1_ITLB, L1_DTLB or L2_TLB
+ * @param entries the number of entries
+ * @param ways the number of ways, at most TLB_MAX_WAYS; entries / ways must be a power of 2
+ * @param policy the replacement policy (tree-PLRU needs a power-of-2 number of ways)
+ * @return error code (ERR_SIZE for a bad geometry, ERR_POLICY for a bad policy)
+ */
+int tlb_config_init(tlb_config_t * cfg, tlb_t type, uint16_t entries, uint8_t ways, cache_replace_t policy);
+
+//=========================================================================
+/**
+ * @brief Number of bytes to allocate for a TLB level. They must be zeroed (e.g. with
+ *        calloc()): an all-zero level is empty.
+ *
+ * @param cfg the configuration of the level
+ * @return the size in bytes, 0 if cfg is NULL
+ */
+size_t tlb_level_size(const tlb_config_t * cfg);
+
+//=========================================================================
+/**
+ * @brief Clean a TLB level: all its entries become invalid, its statistics are kept.
+ *        Like cache_flush(), it takes constant time: it starts a new flush epoch of the
+ *        level, and each set is emptied when it is next filled.
+ *
+ * @param tlb the level
+ * @param cfg the configuration of the level
+ * @return error code
+ */
+int tlb_level_flush(void * tlb, const tlb_config_t * cfg);
+
+//=========================================================================
+/**
+ * @brief Get the statistics of a TLB level.
+ *
+ * @param tlb the level
+ * @param cfg the configuration of the level
+ * @param stats (modified) the statistics
+ * @return error code
+ */
+int tlb_level_get_stats(const void * tlb, const tlb_config_t * cfg, tlb_stats_t * stats);
+
+//=========================================================================
+/**
+ * @brief Print the entries of a TLB level, set after set, one per line: "V; TAG; PHY_PAGE_NUM;"
+ *        as test-tlb_hrchy prints the fixed TLBs (for a huge page, TAG is in pages of its
+ *        size and PHY_PAGE_NUM is its first 4 kiB page).
+ *
+ * @param output the stream to print to
+ * @param tlb the level
+ * @param cfg the configuration of the level
+ * @return error code
+ */
+int tlb_level_dump(FILE * output, const void * tlb, const tlb_config_t * cfg);
+
+//=========================================================================
+/**
+ * @brief Ask a runtime-configured TLB hierarchy for a translation, as tlb_search() asks
+ *        the fixed one: the L1 TLB of the access, then the L2 TLB, then a page walk. The
+ *        L2 TLB includes the L1 ones: an entry it evicts is invalidated in both (all the
+ *        L1 entries of its page if the L1 TLBs splinter it). All the arrays of a level
+ *        (one per page size) are probed at once.
+ *
+ * @param mem_space pointer to the memory space
+ * @param hrchy the levels of the hierarchy
+ * @param vaddr pointer to virtual address
+ * @param paddr (modified) pointer to physical address
+ * @param access to distinguish between fetching instructions and reading/writing data
+ * @param hit_or_miss (modified) hit (1) or miss (0) of the L1 or L2 TLB
+ * @param cycles (modified, may be NULL) latency of the translation (see the latency model in tlb_hrchy.h)
+ * @return error code
+ */
+int tlb_hrchy_search( const void * mem_space,
+                      const tlb_hrchy_t * hrchy,
+                      const virt_addr_t * vaddr,
+                      phy_addr_t * paddr,
+                      mem_access_t access,
+                      int* hit_or_miss,
+                      uint32_t* cycles);
@@ -11,16 +11,131 @@
 #include <assert.h>
 #include <ctype.h>
 
+// Fibonacci hashing of the virtual page numbers
+#define TLB_INDEX_HASH 0x9E3779B97F4A7C15ull
+
+//Slot where the search of a virtual page number starts
+static inline uint16_t tlb_index_home(const tlb_index_t * index, uint64_t virt_page_num){
+    return (uint16_t) ((virt_page_num * TLB_INDEX_HASH) >> (64 - index->slot_bits));
+}
+
+//Entry translating virt_page_num, TLB_INDEX_NONE if none
+static inline uint16_t tlb_index_find(const tlb_index_t * index, const tlb_entry_t * tlb, uint64_t virt_page_num){
+
+    const uint16_t * slots = tlb_index_slots(index);
+    const uint16_t mask = (uint16_t) ((1u << index->slot_bits) - 1);
+
+    for(page_size_t size = PAGE_4K; size < NB_PAGE_SIZES; size++){
+        if(size != PAGE_4K && index->sized_entries[size] == 0) continue;
+
+        //The entry of a page of this size is hashed by its first 4 kiB page
+        const uint64_t tag = virt_page_num & ~(uint64_t) tlb_page_mask(size);
+        for(uint16_t slot = tlb_index_home(index, tag); slots[slot] != TLB_INDEX_NONE; slot = (slot + 1) & mask){
+            const tlb_entry_t * entry = &tlb[slots[slot]];
+            if(entry->tag == tag && entry->page_size == size && entry->v == 1){
+                return slots[slot];
+            }
+        }
+    }
+    return TLB_INDEX_NONE;
+}
+
+//Hash a valid entry (the table is never full: it has twice as many slots as entries)
+static inline void tlb_index_add(tlb_index_t * index, const tlb_entry_t * tlb, uint16_t entry){
+
+    uint16_t * slots = tlb_index_slots(index);
+    const uint16_t mask = (uint16_t) ((1u << index->slot_bits) - 1);
+
+    uint16_t slot = tlb_index_home(index, tlb[entry].tag);
+    while(slots[slot] != TLB_INDEX_NONE) slot = (slot + 1) & mask;
+    slots[slot] = entry;
+    index->sized_entries[tlb[entry].page_size]++;
+}
+
+//Unhash a valid entry, before it is overwritten: the following entries of its cluster
+//that may take its slot are shifted back, so that no search stops too early
+static void tlb_index_remove(tlb_index_t * index, const tlb_entry_t * tlb, uint16_t entry){
+
+    uint16_t * slots = tlb_index_slots(index);
+    const uint16_t mask = (uint16_t) ((1u << index->slot_bits) - 1);
+
+    uint16_t hole = tlb_index_home(index, tlb[entry].tag);
+    while(slots[hole] != entry) hole = (hole + 1) & mask;
+
+    for(uint16_t slot = (hole + 1) & mask; slots[slot] != TLB_INDEX_NONE; slot = (slot + 1) & mask){
+        const uint16_t home = tlb_index_home(index, tlb[slots[slot]].tag);
+        //CASE THE HOLE IS BETWEEN THE HOME OF THE ENTRY AND ITS SLOT: IT MOVES THERE
+        if(((slot - home) & mask) >= ((slot - hole) & mask)){
+            slots[hole] = slots[slot];
+            hole = slot;
+        }
+    }
+    slots[hole] = TLB_INDEX_NONE;
+    index->sized_entries[tlb[entry].page_size]--;
+}
+
+//Translation by an entry that hits: the 4 kiB page of virt_page_num in the page of the entry
+static inline void tlb_hit_translate(const tlb_entry_t * entry, uint64_t virt_page_num, uint16_t offset,
+                                     phy_addr_t * paddr, tlb_page_stats_t * stats){
+
+    paddr->phy_page_num = entry->phy_page_num | (uint32_t) (virt_page_num & tlb_page_mask(entry->page_size));
+    paddr->page_offset = offset;
+    if(stats != NULL){
+        stats->hits[entry->page_size]++;
+    }
+}
+
+//Make an entry the most recently used
+static inline void tlb_index_touch(tlb_index_t * index, uint16_t entry){
+    array_move_back(&index->order, &index->order.nodes[entry]);
+}
+
+
+size_t tlb_index_size(uint32_t lines){
+    return sizeof(tlb_index_t) + 2 * (size_t) lines * sizeof(uint16_t) + lines * sizeof(array_node_t);
+}
+
+
+int tlb_index_init(tlb_index_t * index, uint32_t lines){
+
+    M_REQUIRE_NON_NULL(index);
+    M_REQUIRE(lines > 0 && lines <= TLB_INDEX_MAX_LINES && (lines & (lines - 1)) == 0, ERR_SIZE,
+              "%s", "The number of entries must be a power of 2 up to TLB_INDEX_MAX_LINES");
+
+    index->lines = (uint16_t) lines;
+    index->slot_bits = (uint8_t) (__builtin_ctz(lines) + 1);
+    memset(index->sized_entries, 0, sizeof(index->sized_entries));
+
+    //No entry hashed (TLB_INDEX_NONE has all its bits set)
+    memset(tlb_index_slots(index), 0xFF, 2 * (size_t) lines * sizeof(uint16_t));
+
+    //The LRU order is the order of the entries (node i is pushed i-th, so it holds entry i)
+    int err = init_array_list(&index->order, tlb_index_nodes(index), lines);
+    M_REQUIRE(err == ERR_NONE, err, "%s", "cannot initialize the LRU order");
+    for(list_content_t i = 0; i < lines; i++){
+        (void) array_push_back(&index->order, &i);
+    }
+
+    return ERR_NONE;
+}
+
+
+int tlb_index_flush(tlb_entry_t * tlb, tlb_index_t * index){
+
+    M_REQUIRE_NON_NULL(tlb);
+    M_REQUIRE_NON_NULL(index);
+
+    memset(tlb, 0, index->lines * sizeof(tlb_entry_t));
+    return tlb_index_init(index, index->lines);
+}
+
+
 int tlb_flush(tlb_entry_t * tlb){
 
     M_REQUIRE_NON_NULL(tlb);
 
-    //Loop throught tlb entries and set to 0 all entries
-    for(size_t i = 0; i < TLB_LINES; i++){
-        tlb[i].v = 0;
-        tlb[i].tag = 0;
-        tlb[i].phy_page_num = 0;
-    }
+    //Set to 0 all entries at once (an all-zero entry is invalid)
+    memset(tlb, 0, TLB_LINES * sizeof(tlb_entry_t));
     
     return ERR_NONE;
 }
@@ -30,15 +145,27 @@ int tlb_entry_init( const virt_addr_t * vaddr,
                     const phy_addr_t * paddr,
                     tlb_entry_t * tlb_entry){
 
+        return tlb_entry_init_sized(vaddr, paddr, PAGE_4K, tlb_entry);
+
+}
+
+
+int tlb_entry_init_sized( const virt_addr_t * vaddr,
+                          const phy_addr_t * paddr,
+                          page_size_t page_size,
+                          tlb_entry_t * tlb_entry){
+
         M_REQUIRE_NON_NULL(paddr);
         M_REQUIRE_NON_NULL(tlb_entry);
         M_REQUIRE_NON_NULL(vaddr);
+        M_REQUIRE(page_size >= PAGE_4K && page_size < NB_PAGE_SIZES, ERR_BAD_PARAMETER, "%s", "Unknown page size");
 
 
-        //Copy function arguments to the tlb_entry + active the validation bit 
-        tlb_entry->tag = virt_addr_t_to_virtual_page_number(vaddr);
-        tlb_entry->phy_page_num = (paddr->phy_page_num);
+        //Copy function arguments to the tlb_entry (first 4 kiB pages of the page) + active the validation bit 
+        tlb_entry->tag = virt_addr_t_to_virtual_page_number(vaddr) & ~(uint64_t) tlb_page_mask(page_size);
+        tlb_entry->phy_page_num = paddr->phy_page_num & ~tlb_page_mask(page_size);
         tlb_entry->v = 1;
+        tlb_entry->page_size = page_size & 3;
 
         return ERR_NONE;
 
@@ -79,13 +206,25 @@ int tlb_hit(const virt_addr_t * vaddr,
         // Get the virt_page_num and offset 
         uint64_t virt_page_num = virt_addr_t_to_virtual_page_number(vaddr);
         uint16_t offset = vaddr->page_offset;
+
+        //With an index, the entry is found by hashing
+        tlb_index_t * index = replacement_policy->index;
+        if(index != NULL){
+            const uint16_t entry = tlb_index_find(index, tlb, virt_page_num);
+            if(entry == TLB_INDEX_NONE){
+                return 0;
+            }
+            tlb_hit_translate(&tlb[entry], virt_page_num, offset, paddr, replacement_policy->stats);
+            tlb_index_touch(index, entry);
+            return 1;
+        }
         
         //Iteration on all node (from end to start) and check if one of them correspont to
-        //the one we are searching (right tag + valid)
-        for_all_nodes_reverse(node, replacement_policy->ll) {
-            if(virt_page_num == tlb[node->value].tag && 1 == tlb[node->value].v) {
-                paddr->phy_page_num = tlb[node->value].phy_page_num;
-                paddr->page_offset = offset;
+        //the one we are searching (right tag for the size of its page + valid)
+        for_all_array_nodes_reverse(node, replacement_policy->ll) {
+            const tlb_entry_t * entry = &tlb[node->value];
+            if((virt_page_num & ~(uint64_t) tlb_page_mask(entry->page_size)) == entry->tag && 1 == entry->v) {
+                tlb_hit_translate(entry, virt_page_num, offset, paddr, replacement_policy->stats);
                 replacement_policy->move_back(replacement_policy->ll, node);
                 return 1;
             }
@@ -114,18 +253,33 @@ int tlb_search( const void * mem_space,
         
         //If it's a MISS we do the following block, else there is nothing to do 
         if(*hit_or_miss == 0){
-            int err = page_walk(mem_space, vaddr, paddr);
-            if(err == ERR_NONE){
-                //Create and init a new TLB entry
-                // (We check the return value of the malloc + )
-                tlb_entry_t * entry = malloc(sizeof(tlb_entry_t));
-                M_REQUIRE_NON_NULL(entry);
-                int initErr = tlb_entry_init(vaddr, paddr, entry);
+            page_size_t page_size = PAGE_4K;
+            int err = page_walk_cached(mem_space, replacement_policy->walk_cache, vaddr, paddr, &page_size, NULL);
+            if(err == ERR_NONE && replacement_policy->stats != NULL){
+                replacement_policy->stats->misses[page_size]++;
+            }
+            tlb_index_t * index = replacement_policy->index;
+            if(err == ERR_NONE && index != NULL){
+                //Replace the least recently used entry, hashed instead of the one it held
+                const uint16_t victim = index->order.front;
+                if(tlb[victim].v == 1){
+                    tlb_index_remove(index, tlb, victim);
+                }
+                int initErr = tlb_entry_init_sized(vaddr, paddr, page_size, &tlb[victim]);
+                M_REQUIRE(initErr == 0, ERR_BAD_PARAMETER, "%s", ERR_MESSAGE[ERR_BAD_PARAMETER]);
+                tlb_index_add(index, tlb, victim);
+                tlb_index_touch(index, victim);
+
+                return ERR_NONE;
+            } else if(err == ERR_NONE){
+                //Init the new TLB entry in place of the least recently used one
+                array_list_t * ll = replacement_policy->ll;
+                tlb_entry_t entry;
+                int initErr = tlb_entry_init_sized(vaddr, paddr, page_size, &entry);
                 M_REQUIRE(initErr == 0, ERR_BAD_PARAMETER, "%s", ERR_MESSAGE[ERR_BAD_PARAMETER]);
-                int insertErr = tlb_insert(replacement_policy->ll->front->value, entry, tlb);
+                int insertErr = tlb_insert(ll->nodes[ll->front].value, &entry, tlb);
                 M_REQUIRE(insertErr == 0, ERR_BAD_PARAMETER, "%s", ERR_MESSAGE[ERR_BAD_PARAMETER]);
-                replacement_policy->move_back(replacement_policy->ll, replacement_policy->ll->front);
-                free(entry);
+                replacement_policy->move_back(ll, &ll->nodes[ll->front]);
 
                 return ERR_NONE;
             } else {
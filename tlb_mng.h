@@ -11,14 +11,20 @@
 #include "tlb.h"
 #include "addr.h"
 #include "list.h"
+#include "page_walk.h"
 
 
 //replacement_policy struct definition
+//(ll is an array list, see array_list_t, so that its hits and misses never allocate;
+// with an index, the TLB is looked up and replaced through it and ll is not used)
 typedef struct
 {
-    list_t* ll;
-    node_t* (*push_back)(list_t* ll, const list_content_t* value);
-    void (*move_back)(list_t* this, node_t* node);
+    array_list_t* ll;
+    array_node_t* (*push_back)(array_list_t* ll, const list_content_t* value);
+    void (*move_back)(array_list_t* this, array_node_t* node);
+    tlb_index_t* index; // NULL for none (see tlb_index_init())
+    tlb_page_stats_t* stats; // NULL for none: hits counted by tlb_hit(), misses by tlb_search()
+    page_walk_cache_t* walk_cache; // NULL for none: the paging-structure caches of the page walks of tlb_search()
 
 } replacement_policy_t;
 
@@ -36,7 +42,41 @@ int tlb_flush(tlb_entry_t * tlb);
 
 //=========================================================================
 /**
- * @brief Check if a TLB entry exists in the TLB.
+ * @brief Number of bytes to allocate for the index of a TLB of the given number of entries.
+ *
+ * @param lines the number of entries of the TLB
+ * @return the size in bytes
+ */
+size_t tlb_index_size(uint32_t lines);
+
+//=========================================================================
+/**
+ * @brief Initialize the index of an empty TLB (see tlb_index_t): no entry is hashed and
+ *        the LRU order is the order of the entries, entry 0 being replaced first.
+ *
+ * @param index (modified) the index, of at least tlb_index_size(lines) bytes
+ * @param lines the number of entries of the TLB, a power of 2 up to TLB_INDEX_MAX_LINES
+ * @return error code (ERR_SIZE for a bad number of entries)
+ */
+int tlb_index_init(tlb_index_t * index, uint32_t lines);
+
+//=========================================================================
+/**
+ * @brief Clean a TLB that has an index, and its index.
+ *
+ * Unlike cache_flush(), it takes time linear in the number of entries: it clears them,
+ * empties the hash table and rebuilds the LRU order, as tlb_index_init() does. A flush
+ * epoch would instead add a check to every probe of the table.
+ *
+ * @param tlb pointer to the TLB, of index->lines entries
+ * @param index the index of the TLB
+ * @return error code
+ */
+int tlb_index_flush(tlb_entry_t * tlb, tlb_index_t * index);
+
+//=========================================================================
+/**
+ * @brief Check if a TLB entry exists in the TLB (an entry of a huge page translates all of it).
  *
  * On hit, return success (1) and update the physical page number passed as the pointer to the function.
  * On miss, return miss (0).
@@ -78,6 +118,21 @@ int tlb_entry_init( const virt_addr_t * vaddr,
                     const phy_addr_t * paddr,
                     tlb_entry_t * tlb_entry);
 
+//=========================================================================
+/**
+ * @brief Initialize a TLB entry for the page of the given size that vaddr is in
+ *        (tlb_entry_init() is this initialization for a 4 kiB page).
+ * @param vaddr pointer to virtual address, to extract tlb tag
+ * @param paddr pointer to physical address, to extract physical page number
+ * @param page_size the size of the page, as found by page_walk_sized()
+ * @param tlb_entry pointer to the entry to be initialized
+ * @return  error code
+ */
+int tlb_entry_init_sized( const virt_addr_t * vaddr,
+                          const phy_addr_t * paddr,
+                          page_size_t page_size,
+                          tlb_entry_t * tlb_entry);
+
 //=========================================================================
 /**
  * @brief Ask TLB for the translation.